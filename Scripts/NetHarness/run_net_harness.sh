@@ -0,0 +1,88 @@
+#!/usr/bin/env bash
+# Runs the network condition harness: one headless dedicated server and several headless bot clients on this machine,
+# for every latency profile, then summarizes the reports.
+#
+# Usage: run_net_harness.sh [-c clients] [-d seconds] [-m map] [-p profiles] [-r bytes per second] [-o output]
+#   UE4_EDITOR must point to the editor binary (UE4Editor on Linux, needs a Development build: packet emulation
+#   is compiled out of Shipping).
+#   Profiles are round trip times in ms: 50, 150 and 300 by default.
+#   -r throttles what the server sends to each client and makes this a regression test: the script exits non zero if
+#   the server goes over the rate, hit registration or connections break, or characters in view update less often than
+#   the ones out of view (e.g. run_net_harness.sh -p 150 -r 4000).
+
+set -euo pipefail
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+PROJECT="$(cd "$SCRIPT_DIR/../.." && pwd)/CyberWarfare.uproject"
+
+CLIENTS=4
+DURATION=60
+MAP=""
+PROFILES="50 150 300"
+OUTPUT="$(cd "$SCRIPT_DIR/../.." && pwd)/Saved/NetHarness/$(date +%Y%m%d-%H%M%S)"
+PORT=17777
+RATE=0
+
+while getopts "c:d:m:p:r:o:" opt; do
+	case "$opt" in
+		c) CLIENTS="$OPTARG" ;;
+		d) DURATION="$OPTARG" ;;
+		m) MAP="$OPTARG" ;;
+		p) PROFILES="$OPTARG" ;;
+		r) RATE="$OPTARG" ;;
+		o) OUTPUT="$OPTARG" ;;
+		*) sed -n '2,12p' "$0"; exit 1 ;;
+	esac
+done
+
+if [ -z "${UE4_EDITOR:-}" ]; then
+	echo "UE4_EDITOR is not set" >&2
+	exit 1
+fi
+
+# Round trip (ms) -> lag per direction (ms), jitter per direction (ms), loss (%)
+profile_settings() {
+	case "$1" in
+		50)  echo "25 5 0" ;;
+		150) echo "75 15 1" ;;
+		300) echo "150 30 2" ;;
+		*)   echo "$(( $1 / 2 )) $(( $1 / 10 )) 1" ;;
+	esac
+}
+
+COMMON_ARGS=(-nullrhi -unattended -nosound -nosplash -log -NetHarness "-NetHarnessDuration=$DURATION")
+
+for PROFILE in $PROFILES; do
+	read -r LAG JITTER LOSS <<< "$(profile_settings "$PROFILE")"
+	PROFILE_DIR="$OUTPUT/${PROFILE}ms"
+	mkdir -p "$PROFILE_DIR"
+	EMULATION=("-PktLag=$LAG" "-PktLagVariance=$JITTER" "-PktLoss=$LOSS")
+
+	echo "Profile ${PROFILE} ms: lag ${LAG} ms, jitter ${JITTER} ms, loss ${LOSS}% each way, rate ${RATE} B/s (0: not throttled)"
+
+	"$UE4_EDITOR" "$PROJECT" $MAP -server "-port=$PORT" "${COMMON_ARGS[@]}" "${EMULATION[@]}" "-NetHarnessRate=$RATE" \
+		"-NetHarnessOutput=$PROFILE_DIR" "-abslog=$PROFILE_DIR/server.log" > /dev/null 2>&1 &
+	SERVER_PID=$!
+
+	# Let the server load the map before the clients connect
+	sleep 15
+
+	CLIENT_PIDS=()
+	for CLIENT in $(seq 1 "$CLIENTS"); do
+		"$UE4_EDITOR" "$PROJECT" "127.0.0.1:$PORT" -game "${COMMON_ARGS[@]}" "${EMULATION[@]}" -NetHarnessBot "-NetHarnessSeed=$CLIENT" \
+			"-NetHarnessOutput=$PROFILE_DIR" "-abslog=$PROFILE_DIR/client-$CLIENT.log" > /dev/null 2>&1 &
+		CLIENT_PIDS+=($!)
+		sleep 2
+	done
+
+	for PID in "${CLIENT_PIDS[@]}"; do
+		wait "$PID" || echo "Client $PID exited with $?" >&2
+	done
+	wait "$SERVER_PID" || echo "Server exited with $?" >&2
+done
+
+if [ "$RATE" -gt 0 ]; then
+	python3 "$SCRIPT_DIR/summarize.py" --check "$OUTPUT"
+else
+	python3 "$SCRIPT_DIR/summarize.py" "$OUTPUT"
+fi
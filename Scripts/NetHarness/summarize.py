@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+"""Summarizes the reports of a net harness run, one row per latency profile (see run_net_harness.sh).
+
+With --check, exits with 1 if a profile breaks the regression thresholds: a throttled server (-r) above its rate,
+disconnects, full reliable buffers, hit registration below --min-accuracy, or characters in view updated less often
+than the ones out of view.
+"""
+
+import argparse
+import json
+import os
+import sys
+
+# Bandwidth is sampled once per second, allow for the packet that went over the limit
+RATE_LIMIT_TOLERANCE = 1.1
+
+
+def load_reports(profile_dir):
+    clients, server = [], None
+    for name in sorted(os.listdir(profile_dir)):
+        if not name.endswith(".json"):
+            continue
+        with open(os.path.join(profile_dir, name)) as report_file:
+            report = json.load(report_file)
+        if report.get("role") == "server":
+            server = report
+        elif report.get("role") == "client":
+            clients.append(report)
+    return clients, server
+
+
+def summarize_profile(clients, server):
+    client_hits = sum(client["client_hits"] for client in clients)
+    agreed_hits = sum(client["agreed_hits"] for client in clients)
+    connections = server["connections"] if server else []
+
+    return {
+        "clients_reported": len(clients),
+        "shots_confirmed": sum(client["shots_confirmed"] for client in clients),
+        "shots_lost": sum(client["shots_lost"] for client in clients),
+        "client_hits": client_hits,
+        "server_hits": sum(client["server_hits"] for client in clients),
+        "hit_registration_accuracy": agreed_hits / client_hits if client_hits else 1.0,
+        "corrections": sum(client["corrections"] for client in clients),
+        "fire_to_confirm_p95_ms": max((client["latency_ms"]["FireToConfirm"]["p95"] for client in clients), default=0.0),
+        "reliable_buffer_full": sum(connection["reliable_buffer_full"] for connection in connections),
+        "max_reliable_buffered": max((connection["max_reliable_buffered"] for connection in connections), default=0),
+        "disconnects": sum(1 for connection in connections if connection["disconnected"]),
+        "server_out_bytes_per_second_per_connection": max((connection["out_bytes_per_second"]["mean"] for connection in connections), default=0),
+        "rate_limit": server["rate_limit"] if server else 0,
+        "in_view_update_gap_p95_ms": max((client["update_gap_ms"]["InView"]["p95"] for client in clients), default=0.0),
+        "out_of_view_update_gap_p95_ms": max((client["update_gap_ms"]["OutOfView"]["p95"] for client in clients), default=0.0),
+    }
+
+
+def check_profile(row, min_accuracy):
+    failures = []
+    if row["clients_reported"] == 0:
+        failures.append("no client report")
+    if row["rate_limit"] > 0 and row["server_out_bytes_per_second_per_connection"] > row["rate_limit"] * RATE_LIMIT_TOLERANCE:
+        failures.append(f"server sent {row['server_out_bytes_per_second_per_connection']} B/s over a {row['rate_limit']} B/s limit")
+    if row["disconnects"] > 0:
+        failures.append(f"{row['disconnects']} disconnects")
+    if row["reliable_buffer_full"] > 0:
+        failures.append(f"reliable buffer full {row['reliable_buffer_full']} times")
+    if row["hit_registration_accuracy"] < min_accuracy:
+        failures.append(f"hit registration {row['hit_registration_accuracy']:.3f} below {min_accuracy}")
+    if row["in_view_update_gap_p95_ms"] > row["out_of_view_update_gap_p95_ms"] > 0:
+        failures.append(f"characters in view updated every {row['in_view_update_gap_p95_ms']} ms (p95), "
+                        f"out of view every {row['out_of_view_update_gap_p95_ms']} ms")
+    return failures
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("output_dir")
+    parser.add_argument("--check", action="store_true", help="fail if a profile breaks the regression thresholds")
+    parser.add_argument("--min-accuracy", type=float, default=0.9, help="lowest hit registration accuracy --check accepts")
+    args = parser.parse_args()
+
+    output_dir = args.output_dir
+    summary = {}
+    for profile in sorted(os.listdir(output_dir), key=lambda name: int(name[:-2]) if name[:-2].isdigit() else 0):
+        profile_dir = os.path.join(output_dir, profile)
+        if os.path.isdir(profile_dir):
+            summary[profile] = summarize_profile(*load_reports(profile_dir))
+
+    with open(os.path.join(output_dir, "summary.json"), "w") as summary_file:
+        json.dump(summary, summary_file, indent=2)
+
+    columns = ["hit_registration_accuracy", "shots_lost", "corrections", "fire_to_confirm_p95_ms",
+               "reliable_buffer_full", "disconnects", "server_out_bytes_per_second_per_connection",
+               "in_view_update_gap_p95_ms", "out_of_view_update_gap_p95_ms"]
+    print("profile  " + "  ".join(columns))
+    for profile, row in summary.items():
+        print(f"{profile:8} " + "  ".join(f"{row[column]:>{len(column)}.3f}" if isinstance(row[column], float)
+                                          else f"{row[column]:>{len(column)}}" for column in columns))
+
+    if not args.check:
+        return 0
+
+    failed = False
+    for profile, row in summary.items():
+        for failure in check_profile(row, args.min_accuracy):
+            print(f"FAIL {profile}: {failure}")
+            failed = True
+    if not summary:
+        print("FAIL: no profile reported")
+        failed = True
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,71 @@
+#!/usr/bin/env bash
+# Measures startup and map load times: runs a headless dedicated server and a headless (-nullrhi) standalone client
+# until their first playable frame, several times each, then prints the median of every milestone.
+#
+# Usage: run_startup_timing.sh [-r runs] [-m map] [-o output]
+#   UE4_EDITOR must point to the editor binary (UE4Editor on Linux) or to a packaged game binary.
+
+set -euo pipefail
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+PROJECT="$(cd "$SCRIPT_DIR/../.." && pwd)/CyberWarfare.uproject"
+
+RUNS=5
+MAP="/Game/Maps/P_TestLevel"
+OUTPUT="$(cd "$SCRIPT_DIR/../.." && pwd)/Saved/StartupTiming/$(date +%Y%m%d-%H%M%S)"
+
+while getopts "r:m:o:" opt; do
+	case "$opt" in
+		r) RUNS="$OPTARG" ;;
+		m) MAP="$OPTARG" ;;
+		o) OUTPUT="$OPTARG" ;;
+		*) sed -n '2,7p' "$0"; exit 1 ;;
+	esac
+done
+
+if [ -z "${UE4_EDITOR:-}" ]; then
+	echo "UE4_EDITOR is not set" >&2
+	exit 1
+fi
+
+mkdir -p "$OUTPUT"
+COMMON_ARGS=(-nullrhi -unattended -nosound -nosplash -log -StartupTiming -StartupTimingExit)
+
+for RUN in $(seq 1 "$RUNS"); do
+	echo "Run $RUN/$RUNS"
+	"$UE4_EDITOR" "$PROJECT" "$MAP" -server "${COMMON_ARGS[@]}" \
+		"-StartupTimingOutput=$OUTPUT/server-$RUN.json" "-abslog=$OUTPUT/server-$RUN.log" > /dev/null 2>&1 || echo "Server run $RUN exited with $?" >&2
+	"$UE4_EDITOR" "$PROJECT" "$MAP" -game "${COMMON_ARGS[@]}" \
+		"-StartupTimingOutput=$OUTPUT/client-$RUN.json" "-abslog=$OUTPUT/client-$RUN.log" > /dev/null 2>&1 || echo "Client run $RUN exited with $?" >&2
+done
+
+python3 - "$OUTPUT" <<'PYTHON'
+import glob, json, os, statistics, sys
+
+output = sys.argv[1]
+summary = {}
+for mode in ("server", "client"):
+    reports = []
+    for path in sorted(glob.glob(os.path.join(output, mode + "-*.json"))):
+        with open(path) as report_file:
+            reports.append(json.load(report_file))
+    if not reports:
+        continue
+
+    milestones = {}
+    for report in reports:
+        times = dict(report["process"])
+        if report["map_loads"]:
+            times.update({key: value for key, value in report["map_loads"][-1].items() if key != "map"})
+        for key, value in times.items():
+            if value is not None:
+                milestones.setdefault(key, []).append(value)
+
+    summary[mode] = {key: statistics.median(values) for key, values in milestones.items()}
+    print(f"{mode} ({len(reports)} runs, median seconds)")
+    for key, value in sorted(summary[mode].items(), key=lambda item: item[1] if item[0] != "load_to_playable" else float("inf")):
+        print(f"  {key:20} {value:8.3f}")
+
+with open(os.path.join(output, "summary.json"), "w") as summary_file:
+    json.dump(summary, summary_file, indent=2)
+PYTHON
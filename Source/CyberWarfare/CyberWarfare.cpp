@@ -2,5 +2,59 @@
 
 #include "CyberWarfare.h"
 #include "Modules/ModuleManager.h"
+#include "SNetUpdatePolicy.h"
+#include "SStartupTiming.h"
+#include "SDeterministicSim.h"
+#include "SAllocationCounter.h"
 
-IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, CyberWarfare, "CyberWarfare" );
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+DECLARE_LLM_MEMORY_STAT(TEXT("COOP Characters"), STAT_CharactersLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("COOP Weapons"), STAT_WeaponsLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("COOP Inventory"), STAT_InventoryLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("COOP Effects"), STAT_EffectsLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("COOP Projectiles"), STAT_ProjectilesLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("CyberWarfare"), STAT_CyberWarfareSummaryLLM, STATGROUP_LLM);
+#endif
+
+
+/** Game module, registers our memory tracking tags, starts the startup timing, the deterministic mode and the allocation counter */
+class FCyberWarfareModule : public FDefaultGameModuleImpl
+{
+public:
+
+	virtual void StartupModule() override
+	{
+		StartupTiming::Start();
+		DeterministicSim::Start();
+		AllocationCounter::Start();
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+		FLowLevelMemTracker& MemTracker = FLowLevelMemTracker::Get();
+		const FName SummaryStatName = GET_STATFNAME(STAT_CyberWarfareSummaryLLM);
+		MemTracker.RegisterProjectTag((int32)ECyberWarfareLLMTag::Characters, TEXT("COOP Characters"), GET_STATFNAME(STAT_CharactersLLM), SummaryStatName);
+		MemTracker.RegisterProjectTag((int32)ECyberWarfareLLMTag::Weapons, TEXT("COOP Weapons"), GET_STATFNAME(STAT_WeaponsLLM), SummaryStatName);
+		MemTracker.RegisterProjectTag((int32)ECyberWarfareLLMTag::Inventory, TEXT("COOP Inventory"), GET_STATFNAME(STAT_InventoryLLM), SummaryStatName);
+		MemTracker.RegisterProjectTag((int32)ECyberWarfareLLMTag::Effects, TEXT("COOP Effects"), GET_STATFNAME(STAT_EffectsLLM), SummaryStatName);
+		MemTracker.RegisterProjectTag((int32)ECyberWarfareLLMTag::Projectiles, TEXT("COOP Projectiles"), GET_STATFNAME(STAT_ProjectilesLLM), SummaryStatName);
+#endif
+	}
+};
+
+IMPLEMENT_PRIMARY_GAME_MODULE( FCyberWarfareModule, CyberWarfare, "CyberWarfare" );
+
+DEFINE_LOG_CATEGORY(LogCyberWarfare);
+
+int32 GCoopPushReplication = 1;
+FAutoConsoleVariableRef CVARPushReplication(
+	TEXT("COOP.PushReplication"),
+	GCoopPushReplication,
+	TEXT("Only compare replicated properties of weapons and health components after gameplay code marked them dirty"),
+	ECVF_Default);
+
+int32 GCoopAdaptiveNetUpdate = 1;
+FAutoConsoleVariableRef CVARAdaptiveNetUpdate(
+	TEXT("COOP.AdaptiveNetUpdate"),
+	GCoopAdaptiveNetUpdate,
+	TEXT("Drop idle weapons and stationary characters to their idle net update frequency"),
+	ECVF_Default);
@@ -3,9 +3,37 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "HAL/LowLevelMemTracker.h"
 
 #define SURFACE_FLESHDEFAULT		SurfaceType1
 #define SURFACE_FLESHVULNERABLE		SurfaceType2
 
 #define COLLISION_WEAPON			ECC_GameTraceChannel1
 
+DECLARE_LOG_CATEGORY_EXTERN(LogCyberWarfare, Log, All);
+
+DECLARE_STATS_GROUP(TEXT("CyberWarfare"), STATGROUP_CyberWarfare, STATCAT_Advanced);
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+
+/** Low level memory tracker tags of the module (run with -llm, then stat LLM / stat LLMFULL) */
+enum class ECyberWarfareLLMTag : LLM_TAG_TYPE
+{
+	Characters = (LLM_TAG_TYPE)ELLMTag::ProjectTagStart,
+	Weapons,
+	Inventory,
+	Effects,
+	Projectiles,
+};
+
+/** Attributes the allocations of the current scope to one of our tags */
+#define COOP_LLM_SCOPE(Tag) LLM_SCOPE((ELLMTag)ECyberWarfareLLMTag::Tag)
+
+#else
+
+#define COOP_LLM_SCOPE(Tag)
+
+#endif
+
+/** COOP.PushReplication: gameplay code marks replicated state dirty, clean objects are not compared */
+extern int32 GCoopPushReplication;
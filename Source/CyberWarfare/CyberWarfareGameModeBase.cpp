@@ -1,7 +1,143 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 #include "CyberWarfareGameModeBase.h"
+#include "SCharacter.h"
+#include "SPlayerController.h"
+#include "CyberWarfare.h"
+#include "Public/Components/SCorpseManagerComponent.h"
+#include "SHitchDetector.h"
+#include "SCombatLog.h"
+#include "SNetHarness.h"
+#include "SDeterministicSim.h"
+#include "SInputRecording.h"
+#include "Public/Components/SNetHarnessMonitorComponent.h"
+#include "Engine/World.h"
 
 
+ACyberWarfareGameModeBase::ACyberWarfareGameModeBase()
+{
+	PlayerControllerClass = ASPlayerController::StaticClass();
 
+	PawnPoolSize = 8;
 
+	CorpseManager = CreateDefaultSubobject<USCorpseManagerComponent>(TEXT("CorpseManager"));
+}
+
+
+// Spawn the pool up front, characters spawn their inventory in BeginPlay so that is paid here as well
+void ACyberWarfareGameModeBase::StartPlay()
+{
+	Super::StartPlay();
+
+	HitchDetector::Start(GetWorld());
+	CombatLog::Start(GetWorld());
+	InputRecording::Start(GetWorld());
+	DeterministicSim::BeginWorld(GetWorld());
+
+	if (NetHarness::IsEnabled())
+	{
+		USNetHarnessMonitorComponent* NetHarnessMonitor = NewObject<USNetHarnessMonitorComponent>(this, TEXT("NetHarnessMonitor"));
+		NetHarnessMonitor->RegisterComponent();
+	}
+
+	COOP_LLM_SCOPE(Characters);
+
+	UClass* PawnClass = DefaultPawnClass;
+	if (!PawnClass || !PawnClass->IsChildOf(ASCharacter::StaticClass()))
+	{
+		return;
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	while (PawnPool.Num() < PawnPoolSize)
+	{
+		HitchDetector::FScopedCounter HitchCounter(EGameplayCounter::Spawn);
+
+		ASCharacter* Character = GetWorld()->SpawnActor<ASCharacter>(PawnClass, FVector::ZeroVector, FRotator::ZeroRotator, SpawnParams);
+		if (!Character)
+		{
+			break;
+		}
+
+		Character->OnEnterPool();
+		PawnPool.Add(Character);
+	}
+}
+
+
+void ACyberWarfareGameModeBase::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	HitchDetector::Stop(GetWorld());
+	CombatLog::Stop(GetWorld());
+	InputRecording::Stop(GetWorld());
+	DeterministicSim::EndWorld(GetWorld());
+
+	Super::EndPlay(EndPlayReason);
+}
+
+
+void ACyberWarfareGameModeBase::Logout(AController* Exiting)
+{
+	InputRecording::Record(EInputEvent::Leave, Exiting);
+
+	Super::Logout(Exiting);
+}
+
+
+APawn* ACyberWarfareGameModeBase::SpawnDefaultPawnFor_Implementation(AController* NewPlayer, AActor* StartSpot)
+{
+	UClass* PawnClass = GetDefaultPawnClassForController(NewPlayer);
+
+	for (int32 Index = PawnPool.Num() - 1; Index >= 0; Index--)
+	{
+		ASCharacter* Character = PawnPool[Index];
+		if (!Character || Character->IsPendingKill())
+		{
+			PawnPool.RemoveAtSwap(Index);
+			continue;
+		}
+
+		if (Character->GetClass() == PawnClass)
+		{
+			PawnPool.RemoveAtSwap(Index);
+
+			// Same placement as a fresh spawn
+			const FRotator StartRotation(0.f, StartSpot ? StartSpot->GetActorRotation().Yaw : 0.f, 0.f);
+			const FVector StartLocation = StartSpot ? StartSpot->GetActorLocation() : FVector::ZeroVector;
+
+			Character->ResetForRespawn();
+			Character->SetActorLocationAndRotation(StartLocation, StartRotation, false, nullptr, ETeleportType::TeleportPhysics);
+
+			return Character;
+		}
+	}
+
+	return Super::SpawnDefaultPawnFor_Implementation(NewPlayer, StartSpot);
+}
+
+
+void ACyberWarfareGameModeBase::OnCharacterDied(ASCharacter* Character)
+{
+	CorpseManager->AddCorpse(Character);
+}
+
+
+void ACyberWarfareGameModeBase::RecyclePawn(ASCharacter* Character)
+{
+	if (!Character || !Character->IsDead())
+	{
+		return;
+	}
+
+	if (PawnPool.Num() < PawnPoolSize)
+	{
+		Character->OnEnterPool();
+		PawnPool.Add(Character);
+	}
+	else
+	{
+		Character->Destroy();
+	}
+}
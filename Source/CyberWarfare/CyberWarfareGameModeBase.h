@@ -6,15 +6,51 @@
 #include "GameFramework/GameModeBase.h"
 #include "CyberWarfareGameModeBase.generated.h"
 
+class ASCharacter;
+class USCorpseManagerComponent;
+
 /**
- * 
+ * Keeps a pool of characters so respawning only resets one in place instead of spawning a character and its inventory
  */
 UCLASS()
 class CYBERWARFARE_API ACyberWarfareGameModeBase : public AGameModeBase
 {
 	GENERATED_BODY()
-	
-	
-	
+
+public:
+
+	ACyberWarfareGameModeBase();
+
+	/** Pre-warms the pawn pool, starts the hitch detector, the combat log and the input recording */
+	virtual void StartPlay() override;
+
+	/** Stops the hitch detector, the combat log and the input recording */
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/** Records the departure of the player for input replays */
+	virtual void Logout(AController* Exiting) override;
+
+	/** Hands out a pooled character when one of the right class is available */
+	virtual APawn* SpawnDefaultPawnFor_Implementation(AController* NewPlayer, AActor* StartSpot) override;
+
+	/** Called by characters when they die, the corpse manager decides how long the corpse stays */
+	void OnCharacterDied(ASCharacter* Character);
+
+	/** Puts a dead character in the pool, or destroys it if the pool is full */
+	void RecyclePawn(ASCharacter* Character);
+
+protected:
+
+	/** Keeps the corpses of characters under budget before they come back to the pool */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Components")
+		USCorpseManagerComponent* CorpseManager;
+
+	/** Number of characters spawned at match start, and maximum number of characters kept for respawns */
+	UPROPERTY(EditDefaultsOnly, Category = "PawnPool")
+		int32 PawnPoolSize;
+
+	/** Characters waiting for a respawn */
+	UPROPERTY(Transient)
+		TArray<ASCharacter*> PawnPool;
 	
 };
@@ -0,0 +1,42 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "../../Public/Components/SCharacterMovementComponent.h"
+#include "SInputRecording.h"
+#include "GameFramework/Character.h"
+
+
+USCharacterMovementComponent::USCharacterMovementComponent()
+{
+	NumCorrections = 0;
+}
+
+
+void USCharacterMovementComponent::ClientAdjustPosition_Implementation(float TimeStamp, FVector NewLoc, FVector NewVel, UPrimitiveComponent* NewBase, FName NewBaseBoneName, bool bHasBase, bool bBaseRelativePosition, uint8 ServerMovementMode)
+{
+	NumCorrections++;
+
+	Super::ClientAdjustPosition_Implementation(TimeStamp, NewLoc, NewVel, NewBase, NewBaseBoneName, bHasBase, bBaseRelativePosition, ServerMovementMode);
+}
+
+
+int32 USCharacterMovementComponent::GetNumCorrections() const
+{
+	return NumCorrections;
+}
+
+
+void USCharacterMovementComponent::ReplayMove(float ClientTimeStamp, float DeltaTime, uint8 CompressedFlags, const FVector& NewAccel)
+{
+	MoveAutonomous(ClientTimeStamp, DeltaTime, CompressedFlags, NewAccel);
+}
+
+
+void USCharacterMovementComponent::MoveAutonomous(float ClientTimeStamp, float DeltaTime, uint8 CompressedFlags, const FVector& NewAccel)
+{
+	if (CharacterOwner && CharacterOwner->Role == ROLE_Authority && !CharacterOwner->IsLocallyControlled())
+	{
+		InputRecording::Record(EInputEvent::Move, CharacterOwner, ClientTimeStamp, DeltaTime, NewAccel, CharacterOwner->GetControlRotation(), CompressedFlags);
+	}
+
+	Super::MoveAutonomous(ClientTimeStamp, DeltaTime, CompressedFlags, NewAccel);
+}
@@ -0,0 +1,99 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "../../Public/Components/SCorpseManagerComponent.h"
+#include "SCharacter.h"
+#include "CyberWarfare.h"
+#include "CyberWarfareGameModeBase.h"
+#include "SHitchDetector.h"
+
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Corpses"), STAT_Corpses, STATGROUP_CyberWarfare);
+
+
+// Sets default values for this component's properties
+USCorpseManagerComponent::USCorpseManagerComponent()
+{
+	MaxCorpses = 8;
+	CorpseTime = 10.f;
+
+	// Expiry does not need to be exact, and there is nothing to do without corpses
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+	PrimaryComponentTick.TickInterval = 0.25f;
+}
+
+
+void USCorpseManagerComponent::AddCorpse(ASCharacter* Character)
+{
+	if (!Character)
+	{
+		return;
+	}
+
+	FCorpseEntry Entry;
+	Entry.Character = Character;
+	Entry.DeathTime = GetWorld()->TimeSeconds;
+	Corpses.Add(Entry);
+
+	while (Corpses.Num() > FMath::Max(MaxCorpses, 0))
+	{
+		EvictCorpse(0);
+	}
+
+	SetComponentTickEnabled(Corpses.Num() > 0);
+	SET_DWORD_STAT(STAT_Corpses, Corpses.Num());
+}
+
+
+int32 USCorpseManagerComponent::GetNumCorpses() const
+{
+	return Corpses.Num();
+}
+
+
+void USCorpseManagerComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	HitchDetector::FScopedActorTick HitchTick(GetOwner());
+
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	const float ExpiredDeathTime = GetWorld()->TimeSeconds - CorpseTime;
+
+	// Corpses are sorted by death time, stop at the first one that is still fresh
+	while (Corpses.Num() > 0)
+	{
+		const FCorpseEntry& Oldest = Corpses[0];
+		if (Oldest.Character.IsValid() && Oldest.DeathTime > ExpiredDeathTime)
+		{
+			break;
+		}
+
+		EvictCorpse(0);
+	}
+
+	SetComponentTickEnabled(Corpses.Num() > 0);
+	SET_DWORD_STAT(STAT_Corpses, Corpses.Num());
+}
+
+
+void USCorpseManagerComponent::EvictCorpse(int32 Index)
+{
+	ASCharacter* Character = Corpses[Index].Character.Get();
+	Corpses.RemoveAt(Index);
+
+	// Characters that respawned in the meantime are not corpses anymore
+	if (!Character || !Character->IsDead())
+	{
+		return;
+	}
+
+	ACyberWarfareGameModeBase* GameMode = Cast<ACyberWarfareGameModeBase>(GetOwner());
+	if (GameMode)
+	{
+		GameMode->RecyclePawn(Character);
+	}
+	else
+	{
+		Character->Destroy();
+	}
+}
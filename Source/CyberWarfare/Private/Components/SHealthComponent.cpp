@@ -3,6 +3,14 @@
 #include "../../Public/Components/SHealthComponent.h"
 #include "Net/UnrealNetwork.h"
 #include "CyberWarfare.h"
+#include "Engine/ActorChannel.h"
+#include "Engine/NetConnection.h"
+#include "SCombatLog.h"
+#include "SGameplayRules.h"
+
+
+/** Clean components are still compared this often, so property changes lost in dropped packets get resent */
+static const float ReplicationResendInterval = 1.f;
 
 
 // Sets default values for this component's properties
@@ -14,6 +22,7 @@ USHealthComponent::USHealthComponent()
 	TimeBeforeShieldRegen = 5.f;
 
 	TimeWithoutTakingDamage = 0.f;
+	ReplicationSerial = 0;
 
 	PrimaryComponentTick.bCanEverTick = true;
 	PrimaryComponentTick.bStartWithTickEnabled = true;
@@ -44,46 +53,136 @@ void USHealthComponent::BeginPlay()
 // Tick for our shield
 void USHealthComponent::TickShield(float DeltaTime)
 {
-	if (ShieldRegenRate > 0.f)
+	GameplayRules::FHealthState State = GetHealthState();
+	const bool bShieldChanged = GameplayRules::TickShield(State, GetHealthSettings(), DeltaTime);
+	SetHealthState(State);
+
+	if (bShieldChanged)
 	{
-		// Increment our time without taking any damage
-		TimeWithoutTakingDamage += DeltaTime;
+		MarkReplicationDirty();
+	}
+}
 
-		// If we haven't taken damage for long enough, start regenerating shield
-		if (TimeWithoutTakingDamage >= TimeBeforeShieldRegen)
-		{
-			// Update shield
-			Shield = FMath::Clamp(Shield + ShieldRegenRate, 0.f, DefaultShield);
 
-			// Set our time so we have to wait 0.25 second again before starting to regen shield
-			TimeWithoutTakingDamage = TimeBeforeShieldRegen - 0.25f;
+// Back to full health and shield
+void USHealthComponent::ResetHealth()
+{
+	GameplayRules::FHealthState State;
+	GameplayRules::ResetHealth(State, GetHealthSettings());
+	SetHealthState(State);
+
+	MarkReplicationDirty();
+}
+
+
+GameplayRules::FHealthSettings USHealthComponent::GetHealthSettings() const
+{
+	GameplayRules::FHealthSettings Settings;
+	Settings.DefaultHealth = DefaultHealth;
+	Settings.DefaultShield = DefaultShield;
+	Settings.TimeBeforeShieldRegen = TimeBeforeShieldRegen;
+	Settings.ShieldRegenRate = ShieldRegenRate;
+	return Settings;
+}
+
+
+GameplayRules::FHealthState USHealthComponent::GetHealthState() const
+{
+	GameplayRules::FHealthState State;
+	State.Health = Health;
+	State.Shield = Shield;
+	State.TimeWithoutTakingDamage = TimeWithoutTakingDamage;
+	return State;
+}
+
+
+void USHealthComponent::SetHealthState(const GameplayRules::FHealthState& State)
+{
+	Health = State.Health;
+	Shield = State.Shield;
+	TimeWithoutTakingDamage = State.TimeWithoutTakingDamage;
+}
+
+
+void USHealthComponent::MarkReplicationDirty()
+{
+	ReplicationSerial++;
+}
+
+
+bool USHealthComponent::ConsumeReplicationDirty(const UActorChannel* Channel, bool bNetInitial)
+{
+	const float Now = GetWorld()->TimeSeconds;
+	const TWeakObjectPtr<UNetConnection> Connection = Channel->Connection;
+
+	FReplicationSerialSent* Sent = ReplicationSerialsSent.Find(Connection);
+	if (!bNetInitial && Sent && Sent->Serial == ReplicationSerial && Now - Sent->Time < ReplicationResendInterval)
+	{
+		return false;
+	}
+
+	// A connection we have not seen yet, forget the ones that are gone so we only ever hold live connections
+	if (!Sent)
+	{
+		for (auto It = ReplicationSerialsSent.CreateIterator(); It; ++It)
+		{
+			if (!It.Key().IsValid() || It.Key()->State == USOCK_Closed)
+			{
+				It.RemoveCurrent();
+			}
 		}
 	}
+
+	FReplicationSerialSent& NewSent = ReplicationSerialsSent.FindOrAdd(Connection);
+	NewSent.Serial = ReplicationSerial;
+	NewSent.Time = Now;
+	return true;
+}
+
+
+uint32 USHealthComponent::GetStateHash(uint32 Crc) const
+{
+	Crc = FCrc::MemCrc32(&Health, sizeof(Health), Crc);
+	Crc = FCrc::MemCrc32(&Shield, sizeof(Shield), Crc);
+	return FCrc::MemCrc32(&TimeWithoutTakingDamage, sizeof(TimeWithoutTakingDamage), Crc);
+}
+
+
+int32 USHealthComponent::GetNumReplicatedProperties() const
+{
+	static int32 NumReplicatedProperties = INDEX_NONE;
+	if (NumReplicatedProperties == INDEX_NONE)
+	{
+		TArray<FLifetimeProperty> LifetimeProps;
+		GetLifetimeReplicatedProps(LifetimeProps);
+		NumReplicatedProperties = LifetimeProps.Num();
+	}
+
+	return NumReplicatedProperties;
 }
 
 
 // Handle take damage
 void USHealthComponent::HandleTakeAnyDamage(AActor * DamagedActor, float Damage, const UDamageType * DamageType, AController * InstigatedBy, AActor * DamageCauser)
 {
-	if (Damage <= 0.f)
+	GameplayRules::FHealthState State = GetHealthState();
+	const GameplayRules::EDamageResult Result = GameplayRules::ApplyDamage(State, GetHealthSettings(), Damage);
+	if (Result == GameplayRules::EDamageResult::None)
 	{
 		return;
 	}
 
-	// Reset our time without taking damage to 0
-	TimeWithoutTakingDamage = 0.f;
+	SetHealthState(State);
+	MarkReplicationDirty();
 
-	// Check if we have shield
-	if (Shield > 0.f)
+	// Only damage over health is a health change (a hit on the last points of shield is absorbed whole)
+	if (Result == GameplayRules::EDamageResult::Shield)
 	{
-		// Take damage over shield
-		Shield = FMath::Clamp(Shield - Damage, 0.f, DefaultShield);
+		CombatLog::Record(ECombatEvent::Damage, InstigatedBy, DamagedActor, DamagedActor->GetActorLocation(), FVector::ZeroVector, Damage, Health, 1);
 	}
-	// Else, take damage over health (note that this means if we have 10 shield and take 100 damage, we will not take damage over our health total)
 	else
 	{
-		// Take damage over health
-		Health = FMath::Clamp(Health - Damage, 0.f, DefaultHealth);
+		CombatLog::Record(ECombatEvent::Damage, InstigatedBy, DamagedActor, DamagedActor->GetActorLocation(), FVector::ZeroVector, Damage, Health, 0);
 		OnHealthChanged.Broadcast(this, Health, Damage, DamageType, InstigatedBy, DamageCauser);
 	}
 }
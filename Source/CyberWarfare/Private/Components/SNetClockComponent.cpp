@@ -0,0 +1,276 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "../../Public/Components/SNetClockComponent.h"
+#include "CyberWarfare.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/GameStateBase.h"
+#include "Misc/App.h"
+
+
+/** Samples this much slower than the fastest round trip are queued somewhere and not used */
+static const float RoundTripSlack = 0.002f;
+static const float RoundTripSlackRatio = 1.25f;
+
+/** Drift is only fitted over samples spanning this long, and never trusted beyond 1000 ppm */
+static const double MinDriftTimeSpan = 5.0;
+static const double MaxDrift = 0.001;
+
+/** Samples needed before the estimate is considered synchronized */
+static const int32 MinSamplesForSync = 3;
+
+
+static FAutoConsoleCommandWithWorldAndArgs NetClockCommand(
+	TEXT("COOP.NetClock"),
+	TEXT("Logs the server clock estimate of the local player"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		const USNetClockComponent* Clock = USNetClockComponent::FindLocal(World);
+		if (!Clock)
+		{
+			UE_LOG(LogCyberWarfare, Display, TEXT("No net clock on the local player"));
+			return;
+		}
+
+		UE_LOG(LogCyberWarfare, Display, TEXT("Server time %.3f (local %.3f), synchronized %d, min RTT %.1f ms, drift %.1f ppm"),
+			Clock->GetServerTime(), World->TimeSeconds, Clock->IsSynchronized() ? 1 : 0, Clock->GetMinRoundTripTime() * 1000.f, Clock->GetDrift() * 1e6);
+	}));
+
+
+// Sets default values for this component's properties
+USNetClockComponent::USNetClockComponent()
+{
+	NumBurstRequests = 5;
+	BurstInterval = 0.1f;
+	RequestInterval = 1.f;
+	MaxSamples = 16;
+
+	NextSampleIndex = 0;
+	ClockStartTime = 0.0;
+	NextRequestTime = 0.0;
+	NumRequestsSent = 0;
+
+	EstimateReferenceTime = 0.0;
+	EstimateOffset = 0.0;
+	EstimateDrift = 0.0;
+	bHasEstimate = false;
+	MinRoundTripTime = 0.f;
+
+	// Only the owning client ticks, to send pings
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+
+	SetIsReplicated(true);
+}
+
+
+// Called when the game starts
+void USNetClockComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	ClockStartTime = FPlatformTime::Seconds();
+
+	APlayerController* PlayerController = Cast<APlayerController>(GetOwner());
+	if (PlayerController && PlayerController->IsLocalController() && GetOwnerRole() < ROLE_Authority)
+	{
+		SetComponentTickEnabled(true);
+	}
+}
+
+
+double USNetClockComponent::GetClockTime() const
+{
+	return FPlatformTime::Seconds() - ClockStartTime;
+}
+
+
+void USNetClockComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	const double Now = GetClockTime();
+	if (Now >= NextRequestTime)
+	{
+		ServerRequestTime(Now);
+
+		NumRequestsSent++;
+		NextRequestTime = Now + (NumRequestsSent < NumBurstRequests ? BurstInterval : RequestInterval);
+	}
+}
+
+
+void USNetClockComponent::ServerRequestTime_Implementation(double ClientTime)
+{
+	// World time of this frame, plus the time spent in the frame so far
+	const double ElapsedInFrame = FMath::Max(FPlatformTime::Seconds() - FApp::GetCurrentTime(), 0.0);
+	ClientReceiveTime(ClientTime, GetWorld()->TimeSeconds + ElapsedInFrame);
+}
+
+
+bool USNetClockComponent::ServerRequestTime_Validate(double ClientTime)
+{
+	return true;
+}
+
+
+void USNetClockComponent::ClientReceiveTime_Implementation(double ClientTime, double ServerTime)
+{
+	const double Now = GetClockTime();
+	const double RoundTripTime = Now - ClientTime;
+	if (RoundTripTime < 0.0)
+	{
+		return;
+	}
+
+	// The server stamped the pong about half way through the round trip
+	const double LocalMidTime = (ClientTime + Now) * 0.5;
+	const double LocalWorldMidTime = GetWorld()->TimeSeconds - (Now - LocalMidTime);
+
+	FClockSample Sample;
+	Sample.LocalTime = LocalMidTime;
+	Sample.Offset = ServerTime - LocalWorldMidTime;
+	Sample.RoundTripTime = RoundTripTime;
+
+	if (Samples.Num() < MaxSamples)
+	{
+		Samples.Add(Sample);
+	}
+	else
+	{
+		Samples[NextSampleIndex] = Sample;
+	}
+	NextSampleIndex = (NextSampleIndex + 1) % FMath::Max(MaxSamples, 1);
+
+	UpdateEstimate();
+}
+
+
+void USNetClockComponent::UpdateEstimate()
+{
+	MinRoundTripTime = MAX_flt;
+	for (const FClockSample& Sample : Samples)
+	{
+		MinRoundTripTime = FMath::Min(MinRoundTripTime, Sample.RoundTripTime);
+	}
+
+	// Queuing delays are one-sided, only the fastest round trips tell the real offset
+	const float MaxRoundTripTime = MinRoundTripTime * RoundTripSlackRatio + RoundTripSlack;
+
+	int32 NumSelected = 0;
+	double SumTime = 0.0;
+	double SumOffset = 0.0;
+	double MinTime = MAX_dbl;
+	double MaxTime = -MAX_dbl;
+	for (const FClockSample& Sample : Samples)
+	{
+		if (Sample.RoundTripTime <= MaxRoundTripTime)
+		{
+			NumSelected++;
+			SumTime += Sample.LocalTime;
+			SumOffset += Sample.Offset;
+			MinTime = FMath::Min(MinTime, Sample.LocalTime);
+			MaxTime = FMath::Max(MaxTime, Sample.LocalTime);
+		}
+	}
+
+	if (NumSelected == 0)
+	{
+		return;
+	}
+
+	EstimateReferenceTime = SumTime / NumSelected;
+	EstimateOffset = SumOffset / NumSelected;
+	EstimateDrift = 0.0;
+
+	// Least squares slope of the offset over time
+	if (NumSelected >= MinSamplesForSync && MaxTime - MinTime >= MinDriftTimeSpan)
+	{
+		double Covariance = 0.0;
+		double Variance = 0.0;
+		for (const FClockSample& Sample : Samples)
+		{
+			if (Sample.RoundTripTime <= MaxRoundTripTime)
+			{
+				const double DeltaTime = Sample.LocalTime - EstimateReferenceTime;
+				Covariance += DeltaTime * (Sample.Offset - EstimateOffset);
+				Variance += DeltaTime * DeltaTime;
+			}
+		}
+
+		if (Variance > 0.0)
+		{
+			EstimateDrift = FMath::Clamp(Covariance / Variance, -MaxDrift, MaxDrift);
+		}
+	}
+
+	bHasEstimate = Samples.Num() >= MinSamplesForSync;
+}
+
+
+float USNetClockComponent::GetServerTime() const
+{
+	return LocalToServerTime(GetWorld()->TimeSeconds);
+}
+
+
+float USNetClockComponent::LocalToServerTime(float LocalWorldTime) const
+{
+	if (GetOwnerRole() == ROLE_Authority)
+	{
+		return LocalWorldTime;
+	}
+
+	// Before the first samples, fall back on the coarse time the game state replicates
+	if (Samples.Num() == 0)
+	{
+		const AGameStateBase* GameState = GetWorld()->GetGameState();
+		return GameState ? LocalWorldTime + (GameState->GetServerWorldTimeSeconds() - GetWorld()->TimeSeconds) : LocalWorldTime;
+	}
+
+	const double ClockTimeAtLocalTime = GetClockTime() - (GetWorld()->TimeSeconds - LocalWorldTime);
+	return LocalWorldTime + EstimateOffset + EstimateDrift * (ClockTimeAtLocalTime - EstimateReferenceTime);
+}
+
+
+bool USNetClockComponent::IsSynchronized() const
+{
+	return GetOwnerRole() == ROLE_Authority || bHasEstimate;
+}
+
+
+float USNetClockComponent::GetMinRoundTripTime() const
+{
+	return Samples.Num() > 0 ? MinRoundTripTime : 0.f;
+}
+
+
+double USNetClockComponent::GetDrift() const
+{
+	return EstimateDrift;
+}
+
+
+const USNetClockComponent* USNetClockComponent::FindLocal(const UWorld* World)
+{
+	const APlayerController* PlayerController = World ? World->GetFirstPlayerController() : nullptr;
+	return PlayerController ? PlayerController->FindComponentByClass<USNetClockComponent>() : nullptr;
+}
+
+
+float USNetClockComponent::GetServerWorldTime(const UWorld* World)
+{
+	return LocalToServerWorldTime(World, World->TimeSeconds);
+}
+
+
+float USNetClockComponent::LocalToServerWorldTime(const UWorld* World, float LocalWorldTime)
+{
+	if (World->GetNetMode() != NM_Client)
+	{
+		return LocalWorldTime;
+	}
+
+	const USNetClockComponent* Clock = FindLocal(World);
+	return Clock ? Clock->LocalToServerTime(LocalWorldTime) : LocalWorldTime;
+}
@@ -0,0 +1,262 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "../../Public/Components/SNetHarnessBotComponent.h"
+#include "../../Public/Components/SShotLatencyComponent.h"
+#include "../../Public/Components/SCharacterMovementComponent.h"
+#include "CyberWarfare.h"
+#include "SNetHarness.h"
+#include "SNetPriority.h"
+#include "SCharacter.h"
+#include "EngineUtils.h"
+#include "Engine/World.h"
+#include "Engine/NetConnection.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/PlayerState.h"
+
+
+// Sets default values for this component's properties
+USNetHarnessBotComponent::USNetHarnessBotComponent()
+{
+	FireCycle = 2.f;
+	FireDutyCycle = 0.5f;
+	AimError = 2.f;
+	StrafeFrequency = 0.5f;
+
+	StartTime = 0.f;
+	Duration = 0.f;
+	NextRestartTime = 0.f;
+	NextBandwidthSampleTime = 0.f;
+	AimPhase = 0.f;
+	bFiring = false;
+	bFinished = false;
+
+	LastNumCorrections = 0;
+	NumCorrections = 0;
+
+	InBytesPerSecondSum = 0;
+	OutBytesPerSecondSum = 0;
+	MaxInBytesPerSecond = 0;
+	MaxOutBytesPerSecond = 0;
+	NumBandwidthSamples = 0;
+
+	PrimaryComponentTick.bCanEverTick = true;
+}
+
+
+// Called when the game starts
+void USNetHarnessBotComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	Random.Initialize(NetHarness::GetSeed());
+	AimPhase = Random.FRandRange(0.f, 2.f * PI);
+
+	StartTime = GetWorld()->TimeSeconds;
+	Duration = NetHarness::GetDuration();
+	NextBandwidthSampleTime = StartTime + 1.f;
+}
+
+
+void USNetHarnessBotComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	APlayerController* PlayerController = Cast<APlayerController>(GetOwner());
+	if (!PlayerController || bFinished)
+	{
+		return;
+	}
+
+	const float Now = GetWorld()->TimeSeconds;
+	if (Now - StartTime >= Duration)
+	{
+		FinishScenario();
+		return;
+	}
+
+	if (Now >= NextBandwidthSampleTime)
+	{
+		SampleBandwidth();
+		NextBandwidthSampleTime += 1.f;
+	}
+
+	ASCharacter* Character = Cast<ASCharacter>(PlayerController->GetPawn());
+	if (!Character || Character->IsDead())
+	{
+		bFiring = false;
+		if (Now >= NextRestartTime)
+		{
+			PlayerController->ServerRestartPlayer();
+			NextRestartTime = Now + 2.f;
+		}
+		return;
+	}
+
+	USCharacterMovementComponent* Movement = Cast<USCharacterMovementComponent>(Character->GetCharacterMovement());
+	if (Movement)
+	{
+		if (CorrectedCharacter.Get() != Character)
+		{
+			CorrectedCharacter = Character;
+			LastNumCorrections = Movement->GetNumCorrections();
+		}
+		NumCorrections += Movement->GetNumCorrections() - LastNumCorrections;
+		LastNumCorrections = Movement->GetNumCorrections();
+	}
+
+	SampleUpdateGaps(Character);
+
+	// Aim at the target with a wobble, so hits and misses both happen and depend on the latency
+	ASCharacter* Target = FindTarget(Character);
+	if (Target)
+	{
+		FRotator Aim = (Target->GetActorLocation() - Character->GetPawnViewLocation()).Rotation();
+		Aim.Yaw += AimError * FMath::Sin(Now * 1.7f + AimPhase);
+		Aim.Pitch += 0.5f * AimError * FMath::Sin(Now * 2.3f + AimPhase);
+		PlayerController->SetControlRotation(Aim);
+	}
+
+	Character->AddMovementInput(Character->GetActorRightVector(), FMath::Sin(2.f * PI * StrafeFrequency * (Now - StartTime) + AimPhase));
+
+	const bool bWantsToFire = Target && FMath::Fmod(Now - StartTime, FireCycle) < FireCycle * FireDutyCycle;
+	if (bWantsToFire != bFiring)
+	{
+		bFiring = bWantsToFire;
+		if (bFiring)
+		{
+			Character->StartFire();
+		}
+		else
+		{
+			Character->StopFire();
+		}
+	}
+}
+
+
+ASCharacter* USNetHarnessBotComponent::FindTarget(const ASCharacter* Character) const
+{
+	ASCharacter* Target = nullptr;
+	float TargetDistSquared = MAX_flt;
+
+	for (TActorIterator<ASCharacter> It(GetWorld()); It; ++It)
+	{
+		ASCharacter* Other = *It;
+		if (Other == Character || Other->IsDead() || Other->bHidden)
+		{
+			continue;
+		}
+
+		const float DistSquared = FVector::DistSquared(Other->GetActorLocation(), Character->GetActorLocation());
+		if (DistSquared < TargetDistSquared)
+		{
+			Target = Other;
+			TargetDistSquared = DistSquared;
+		}
+	}
+
+	return Target;
+}
+
+
+void USNetHarnessBotComponent::SampleBandwidth()
+{
+	APlayerController* PlayerController = Cast<APlayerController>(GetOwner());
+	UNetConnection* Connection = PlayerController ? PlayerController->GetNetConnection() : nullptr;
+	if (!Connection)
+	{
+		return;
+	}
+
+	InBytesPerSecondSum += Connection->InBytesPerSecond;
+	OutBytesPerSecondSum += Connection->OutBytesPerSecond;
+	MaxInBytesPerSecond = FMath::Max(MaxInBytesPerSecond, Connection->InBytesPerSecond);
+	MaxOutBytesPerSecond = FMath::Max(MaxOutBytesPerSecond, Connection->OutBytesPerSecond);
+	NumBandwidthSamples++;
+}
+
+
+void USNetHarnessBotComponent::SampleUpdateGaps(const ASCharacter* Character)
+{
+	const FVector ViewLocation = Character->GetPawnViewLocation();
+	const FVector ViewDirection = Character->GetControlRotation().Vector();
+
+	for (TActorIterator<ASCharacter> It(GetWorld()); It; ++It)
+	{
+		ASCharacter* Other = *It;
+		if (Other == Character || Other->IsDead() || Other->bHidden)
+		{
+			continue;
+		}
+
+		// The first update only starts the clock
+		float& LastUpdateTime = LastUpdateTimes.FindOrAdd(Other);
+		if (Other->GetLastNetReceiveTime() > LastUpdateTime)
+		{
+			if (LastUpdateTime > 0.f)
+			{
+				FLatencyHistogram& Gaps = NetPriority::IsInViewCone(Other->GetActorLocation(), ViewLocation, ViewDirection) ? InViewUpdateGaps : OutOfViewUpdateGaps;
+				Gaps.Add((Other->GetLastNetReceiveTime() - LastUpdateTime) * 1000.f);
+			}
+			LastUpdateTime = Other->GetLastNetReceiveTime();
+		}
+	}
+}
+
+
+void USNetHarnessBotComponent::FinishScenario()
+{
+	bFinished = true;
+
+	APlayerController* PlayerController = Cast<APlayerController>(GetOwner());
+	ASCharacter* Character = Cast<ASCharacter>(PlayerController->GetPawn());
+	if (Character)
+	{
+		Character->StopFire();
+	}
+
+	FHitRegistrationStats HitRegistration;
+	FString Latency;
+	USShotLatencyComponent* ShotLatency = PlayerController->FindComponentByClass<USShotLatencyComponent>();
+	if (ShotLatency)
+	{
+		HitRegistration = ShotLatency->GetHitRegistration();
+
+		for (int32 Stage = 0; Stage < (int32)EShotLatencyStage::Num; Stage++)
+		{
+			const FLatencyHistogram& Histogram = ShotLatency->GetHistogram((EShotLatencyStage)Stage);
+			Latency += FString::Printf(TEXT("%s\n    \"%s\": { \"count\": %d, \"mean\": %.3f, \"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"max\": %.3f }"),
+				Stage > 0 ? TEXT(",") : TEXT(""), USShotLatencyComponent::GetStageName((EShotLatencyStage)Stage), Histogram.Count, Histogram.GetMean(),
+				Histogram.GetPercentile(0.5f), Histogram.GetPercentile(0.95f), Histogram.GetPercentile(0.99f), Histogram.Max);
+		}
+	}
+
+	const int32 NumSamples = FMath::Max(NumBandwidthSamples, 1);
+	const float Accuracy = HitRegistration.ClientHits > 0 ? (float)HitRegistration.AgreedHits / HitRegistration.ClientHits : 1.f;
+
+	FString Json = TEXT("{\n");
+	Json += FString::Printf(TEXT("  \"role\": \"client\",\n  \"seed\": %d,\n  \"duration\": %.1f,\n"), NetHarness::GetSeed(), Duration);
+	Json += FString::Printf(TEXT("  \"shots_confirmed\": %d,\n  \"shots_lost\": %d,\n  \"client_hits\": %d,\n  \"server_hits\": %d,\n  \"agreed_hits\": %d,\n  \"hit_registration_accuracy\": %.4f,\n"),
+		HitRegistration.ConfirmedShots, HitRegistration.LostShots, HitRegistration.ClientHits, HitRegistration.ServerHits, HitRegistration.AgreedHits, Accuracy);
+	Json += FString::Printf(TEXT("  \"corrections\": %d,\n"), NumCorrections);
+	Json += FString::Printf(TEXT("  \"in_bytes_per_second\": { \"mean\": %lld, \"max\": %d },\n  \"out_bytes_per_second\": { \"mean\": %lld, \"max\": %d },\n"),
+		InBytesPerSecondSum / NumSamples, MaxInBytesPerSecond, OutBytesPerSecondSum / NumSamples, MaxOutBytesPerSecond);
+	Json += FString::Printf(TEXT("  \"latency_ms\": {%s\n  },\n"), *Latency);
+
+	// Under a throttled connection the characters in view should keep the shorter gaps
+	const FLatencyHistogram* UpdateGaps[] = { &InViewUpdateGaps, &OutOfViewUpdateGaps };
+	const TCHAR* UpdateGapNames[] = { TEXT("InView"), TEXT("OutOfView") };
+	Json += TEXT("  \"update_gap_ms\": {");
+	for (int32 Index = 0; Index < ARRAY_COUNT(UpdateGaps); Index++)
+	{
+		const FLatencyHistogram& Histogram = *UpdateGaps[Index];
+		Json += FString::Printf(TEXT("%s\n    \"%s\": { \"count\": %d, \"mean\": %.3f, \"p50\": %.3f, \"p95\": %.3f, \"max\": %.3f }"),
+			Index > 0 ? TEXT(",") : TEXT(""), UpdateGapNames[Index], Histogram.Count, Histogram.GetMean(), Histogram.GetPercentile(0.5f),
+			Histogram.GetPercentile(0.95f), Histogram.Max);
+	}
+	Json += TEXT("\n  }\n}\n");
+
+	NetHarness::WriteReport(FString::Printf(TEXT("client-%d.json"), NetHarness::GetSeed()), Json);
+
+	FPlatformMisc::RequestExit(false);
+}
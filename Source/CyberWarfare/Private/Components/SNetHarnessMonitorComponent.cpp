@@ -0,0 +1,148 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "../../Public/Components/SNetHarnessMonitorComponent.h"
+#include "CyberWarfare.h"
+#include "SNetHarness.h"
+#include "Engine/World.h"
+#include "Engine/NetDriver.h"
+#include "Engine/NetConnection.h"
+#include "Engine/Channel.h"
+#include "GameFramework/PlayerController.h"
+
+
+// Sets default values for this component's properties
+USNetHarnessMonitorComponent::USNetHarnessMonitorComponent()
+{
+	ReportGraceTime = 10.f;
+
+	StartTime = 0.f;
+	NextBandwidthSampleTime = 0.f;
+	bFinished = false;
+
+	PrimaryComponentTick.bCanEverTick = true;
+}
+
+
+// Called when the game starts
+void USNetHarnessMonitorComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	StartTime = GetWorld()->TimeSeconds;
+	NextBandwidthSampleTime = StartTime + 1.f;
+}
+
+
+USNetHarnessMonitorComponent::FConnectionStats& USNetHarnessMonitorComponent::FindOrAddStats(UNetConnection* Connection)
+{
+	for (FConnectionStats& Stats : ConnectionStats)
+	{
+		if (Stats.Connection.Get() == Connection)
+		{
+			return Stats;
+		}
+	}
+
+	FConnectionStats& Stats = ConnectionStats[ConnectionStats.AddZeroed()];
+	Stats.Connection = Connection;
+	Stats.Name = Connection->PlayerController ? Connection->PlayerController->GetName() : Connection->LowLevelGetRemoteAddress(true);
+	return Stats;
+}
+
+
+void USNetHarnessMonitorComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	UNetDriver* NetDriver = GetWorld()->GetNetDriver();
+	if (!NetDriver || bFinished)
+	{
+		return;
+	}
+
+	const float Now = GetWorld()->TimeSeconds;
+	if (Now - StartTime >= NetHarness::GetDuration() + ReportGraceTime)
+	{
+		FinishScenario();
+		return;
+	}
+
+	const bool bSampleBandwidth = Now >= NextBandwidthSampleTime;
+	if (bSampleBandwidth)
+	{
+		NextBandwidthSampleTime += 1.f;
+	}
+
+	const int32 RateLimit = NetHarness::GetRateLimit();
+
+	for (UNetConnection* Connection : NetDriver->ClientConnections)
+	{
+		if (!Connection)
+		{
+			continue;
+		}
+
+		// Applied every frame, the rate the client asks for would override it otherwise
+		if (RateLimit > 0)
+		{
+			Connection->CurrentNetSpeed = RateLimit;
+		}
+
+		FConnectionStats& Stats = FindOrAddStats(Connection);
+
+		// Peaks are short, so the reliable buffers are checked every frame
+		int32 ReliableBuffered = 0;
+		for (UChannel* Channel : Connection->OpenChannels)
+		{
+			ReliableBuffered = Channel ? FMath::Max(ReliableBuffered, Channel->NumOutRec) : ReliableBuffered;
+		}
+
+		const bool bReliableBufferFull = ReliableBuffered >= RELIABLE_BUFFER - 1;
+		Stats.ReliableBufferFull += bReliableBufferFull && !Stats.bReliableBufferWasFull ? 1 : 0;
+		Stats.bReliableBufferWasFull = bReliableBufferFull;
+		Stats.MaxReliableBuffered = FMath::Max(Stats.MaxReliableBuffered, ReliableBuffered);
+
+		if (bSampleBandwidth)
+		{
+			Stats.InBytesPerSecondSum += Connection->InBytesPerSecond;
+			Stats.OutBytesPerSecondSum += Connection->OutBytesPerSecond;
+			Stats.MaxInBytesPerSecond = FMath::Max(Stats.MaxInBytesPerSecond, Connection->InBytesPerSecond);
+			Stats.MaxOutBytesPerSecond = FMath::Max(Stats.MaxOutBytesPerSecond, Connection->OutBytesPerSecond);
+			Stats.NumBandwidthSamples++;
+		}
+	}
+
+	// Connections that went away before the end of the scenario
+	for (FConnectionStats& Stats : ConnectionStats)
+	{
+		if (!Stats.bDisconnected && (!Stats.Connection.IsValid() || !NetDriver->ClientConnections.Contains(Stats.Connection.Get())))
+		{
+			Stats.bDisconnected = Now - StartTime < NetHarness::GetDuration();
+		}
+	}
+}
+
+
+void USNetHarnessMonitorComponent::FinishScenario()
+{
+	bFinished = true;
+
+	FString Json = FString::Printf(TEXT("{\n  \"role\": \"server\",\n  \"duration\": %.1f,\n  \"rate_limit\": %d,\n  \"connections\": ["),
+		NetHarness::GetDuration(), NetHarness::GetRateLimit());
+	for (int32 Index = 0; Index < ConnectionStats.Num(); Index++)
+	{
+		const FConnectionStats& Stats = ConnectionStats[Index];
+		const int32 NumSamples = FMath::Max(Stats.NumBandwidthSamples, 1);
+
+		Json += FString::Printf(TEXT("%s\n    { \"name\": \"%s\", \"in_bytes_per_second\": { \"mean\": %lld, \"max\": %d }, \"out_bytes_per_second\": { \"mean\": %lld, \"max\": %d }, ")
+			TEXT("\"max_reliable_buffered\": %d, \"reliable_buffer_full\": %d, \"disconnected\": %s }"),
+			Index > 0 ? TEXT(",") : TEXT(""), *Stats.Name.ReplaceCharWithEscapedChar(), Stats.InBytesPerSecondSum / NumSamples, Stats.MaxInBytesPerSecond,
+			Stats.OutBytesPerSecondSum / NumSamples, Stats.MaxOutBytesPerSecond, Stats.MaxReliableBuffered, Stats.ReliableBufferFull,
+			Stats.bDisconnected ? TEXT("true") : TEXT("false"));
+	}
+	Json += TEXT("\n  ]\n}\n");
+
+	NetHarness::WriteReport(TEXT("server.json"), Json);
+
+	FPlatformMisc::RequestExit(false);
+}
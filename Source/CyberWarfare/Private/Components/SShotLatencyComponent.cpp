@@ -0,0 +1,302 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "../../Public/Components/SShotLatencyComponent.h"
+#include "CyberWarfare.h"
+#include "SPlayerController.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+
+const float FLatencyHistogram::BucketLimits[FLatencyHistogram::NumBuckets - 1] = { 1.f, 2.f, 5.f, 10.f, 16.f, 25.f, 33.f, 50.f, 75.f, 100.f, 150.f, 200.f, 300.f, 500.f, 1000.f };
+
+
+static FString GetDefaultExportPath()
+{
+	return FPaths::ProjectSavedDir() / TEXT("Latency") / FString::Printf(TEXT("ShotLatency-%s.csv"), *FDateTime::Now().ToString());
+}
+
+
+static FAutoConsoleCommandWithWorldAndArgs ShotLatencyCommand(
+	TEXT("COOP.ShotLatency"),
+	TEXT("Logs the fire and reload latency histograms of the local player (COOP.ShotLatency reset to clear them)"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		APlayerController* PlayerController = World ? World->GetFirstPlayerController() : nullptr;
+		USShotLatencyComponent* Latency = PlayerController ? PlayerController->FindComponentByClass<USShotLatencyComponent>() : nullptr;
+		if (!Latency)
+		{
+			UE_LOG(LogCyberWarfare, Display, TEXT("No shot latency on the local player"));
+			return;
+		}
+
+		if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+		{
+			Latency->ResetHistograms();
+			return;
+		}
+
+		for (int32 Stage = 0; Stage < (int32)EShotLatencyStage::Num; Stage++)
+		{
+			const FLatencyHistogram& Histogram = Latency->GetHistogram((EShotLatencyStage)Stage);
+			UE_LOG(LogCyberWarfare, Display, TEXT("%-16s %6d samples, mean %7.2f ms, p50 %7.2f ms, p95 %7.2f ms, p99 %7.2f ms, max %7.2f ms"),
+				USShotLatencyComponent::GetStageName((EShotLatencyStage)Stage), Histogram.Count, Histogram.GetMean(),
+				Histogram.GetPercentile(0.5f), Histogram.GetPercentile(0.95f), Histogram.GetPercentile(0.99f), Histogram.Max);
+		}
+
+		const FHitRegistrationStats& HitRegistration = Latency->GetHitRegistration();
+		UE_LOG(LogCyberWarfare, Display, TEXT("Hit registration: %d shots confirmed, %d lost, %d hits seen, %d registered, %d on both"),
+			HitRegistration.ConfirmedShots, HitRegistration.LostShots, HitRegistration.ClientHits, HitRegistration.ServerHits, HitRegistration.AgreedHits);
+	}));
+
+
+static FAutoConsoleCommandWithWorldAndArgs ShotLatencyExportCommand(
+	TEXT("COOP.ShotLatencyExport"),
+	TEXT("Writes the fire and reload latency histograms of the local player as CSV (optional path, Saved/Latency by default)"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		APlayerController* PlayerController = World ? World->GetFirstPlayerController() : nullptr;
+		USShotLatencyComponent* Latency = PlayerController ? PlayerController->FindComponentByClass<USShotLatencyComponent>() : nullptr;
+		if (Latency)
+		{
+			Latency->ExportHistograms(Args.Num() > 0 ? Args[0] : GetDefaultExportPath());
+		}
+	}));
+
+
+FLatencyHistogram::FLatencyHistogram()
+{
+	Reset();
+}
+
+
+void FLatencyHistogram::Add(float Milliseconds)
+{
+	int32 Bucket = 0;
+	while (Bucket < NumBuckets - 1 && Milliseconds > BucketLimits[Bucket])
+	{
+		Bucket++;
+	}
+
+	Buckets[Bucket]++;
+	Min = Count > 0 ? FMath::Min(Min, Milliseconds) : Milliseconds;
+	Max = Count > 0 ? FMath::Max(Max, Milliseconds) : Milliseconds;
+	Sum += Milliseconds;
+	Count++;
+}
+
+
+void FLatencyHistogram::Reset()
+{
+	FMemory::Memzero(Buckets);
+	Count = 0;
+	Sum = 0.0;
+	Min = 0.f;
+	Max = 0.f;
+}
+
+
+float FLatencyHistogram::GetPercentile(float Percentile) const
+{
+	const int32 Rank = FMath::CeilToInt(FMath::Clamp(Percentile, 0.f, 1.f) * Count);
+
+	int32 Cumulated = 0;
+	for (int32 Bucket = 0; Bucket < NumBuckets - 1; Bucket++)
+	{
+		Cumulated += Buckets[Bucket];
+		if (Cumulated >= Rank)
+		{
+			return FMath::Min(BucketLimits[Bucket], Max);
+		}
+	}
+
+	return Max;
+}
+
+
+float FLatencyHistogram::GetMean() const
+{
+	return Count > 0 ? Sum / Count : 0.f;
+}
+
+
+// Sets default values for this component's properties
+USShotLatencyComponent::USShotLatencyComponent()
+{
+	NextPendingShot = 0;
+	PendingInputTime = 0.0;
+	PendingReloadTime = 0.0;
+	FMemory::Memzero(PendingShots);
+
+	PrimaryComponentTick.bCanEverTick = false;
+}
+
+
+void USShotLatencyComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// Headless clients and bots dump their numbers when they leave
+	APlayerController* PlayerController = Cast<APlayerController>(GetOwner());
+	if (PlayerController && PlayerController->IsLocalController() && FParse::Param(FCommandLine::Get(), TEXT("ShotLatencyExport")))
+	{
+		ExportHistograms(GetDefaultExportPath());
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+
+void USShotLatencyComponent::OnFireInput()
+{
+	PendingInputTime = FPlatformTime::Seconds();
+}
+
+
+void USShotLatencyComponent::OnShotFired(uint16 ShotId, bool bHitCharacter)
+{
+	const double Now = FPlatformTime::Seconds();
+
+	FPendingShot& Shot = PendingShots[NextPendingShot];
+	NextPendingShot = (NextPendingShot + 1) % MaxPendingShots;
+
+	// The server answers every shot it accepts long before we wrap around
+	if (Shot.bPending)
+	{
+		HitRegistration.LostShots++;
+	}
+
+	Shot.ShotId = ShotId;
+	Shot.FireTime = Now;
+	Shot.InputTime = PendingInputTime;
+	Shot.bPending = true;
+	Shot.bHitCharacter = bHitCharacter;
+
+	// Only the first shot of a trigger pull waited for the input, the next ones waited for the rate of fire
+	if (PendingInputTime > 0.0)
+	{
+		Histograms[(int32)EShotLatencyStage::InputToFire].Add((Now - PendingInputTime) * 1000.0);
+		PendingInputTime = 0.0;
+	}
+}
+
+
+void USShotLatencyComponent::OnShotConfirmed(uint16 ShotId, bool bHitCharacter, float FireToServer, float ServerToDamage)
+{
+	const double Now = FPlatformTime::Seconds();
+
+	for (FPendingShot& Shot : PendingShots)
+	{
+		if (Shot.bPending && Shot.ShotId == ShotId)
+		{
+			Shot.bPending = false;
+
+			HitRegistration.ConfirmedShots++;
+			HitRegistration.ClientHits += Shot.bHitCharacter ? 1 : 0;
+			HitRegistration.ServerHits += bHitCharacter ? 1 : 0;
+			HitRegistration.AgreedHits += Shot.bHitCharacter && bHitCharacter ? 1 : 0;
+
+			Histograms[(int32)EShotLatencyStage::FireToServer].Add(FireToServer * 1000.f);
+			Histograms[(int32)EShotLatencyStage::ServerToDamage].Add(ServerToDamage * 1000.f);
+			Histograms[(int32)EShotLatencyStage::FireToConfirm].Add((Now - Shot.FireTime) * 1000.0);
+			if (Shot.InputTime > 0.0)
+			{
+				Histograms[(int32)EShotLatencyStage::InputToConfirm].Add((Now - Shot.InputTime) * 1000.0);
+			}
+			return;
+		}
+	}
+}
+
+
+void USShotLatencyComponent::OnReloadInput()
+{
+	PendingReloadTime = FPlatformTime::Seconds();
+}
+
+
+void USShotLatencyComponent::OnReloadConfirmed()
+{
+	if (PendingReloadTime > 0.0)
+	{
+		Histograms[(int32)EShotLatencyStage::ReloadToConfirm].Add((FPlatformTime::Seconds() - PendingReloadTime) * 1000.0);
+		PendingReloadTime = 0.0;
+	}
+}
+
+
+const FLatencyHistogram& USShotLatencyComponent::GetHistogram(EShotLatencyStage Stage) const
+{
+	return Histograms[(int32)Stage];
+}
+
+
+const FHitRegistrationStats& USShotLatencyComponent::GetHitRegistration() const
+{
+	return HitRegistration;
+}
+
+
+void USShotLatencyComponent::ResetHistograms()
+{
+	for (FLatencyHistogram& Histogram : Histograms)
+	{
+		Histogram.Reset();
+	}
+
+	HitRegistration = FHitRegistrationStats();
+}
+
+
+bool USShotLatencyComponent::ExportHistograms(const FString& Path) const
+{
+	FString Csv = TEXT("Stage,Count,MeanMs,MinMs,MaxMs,P50Ms,P95Ms,P99Ms");
+	for (int32 Bucket = 0; Bucket < FLatencyHistogram::NumBuckets - 1; Bucket++)
+	{
+		Csv += FString::Printf(TEXT(",Le%gMs"), FLatencyHistogram::BucketLimits[Bucket]);
+	}
+	Csv += TEXT(",Above\n");
+
+	for (int32 Stage = 0; Stage < (int32)EShotLatencyStage::Num; Stage++)
+	{
+		const FLatencyHistogram& Histogram = Histograms[Stage];
+		Csv += FString::Printf(TEXT("%s,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f"), GetStageName((EShotLatencyStage)Stage), Histogram.Count, Histogram.GetMean(),
+			Histogram.Min, Histogram.Max, Histogram.GetPercentile(0.5f), Histogram.GetPercentile(0.95f), Histogram.GetPercentile(0.99f));
+		for (int32 Bucket = 0; Bucket < FLatencyHistogram::NumBuckets; Bucket++)
+		{
+			Csv += FString::Printf(TEXT(",%d"), Histogram.Buckets[Bucket]);
+		}
+		Csv += TEXT("\n");
+	}
+
+	if (!FFileHelper::SaveStringToFile(Csv, *Path))
+	{
+		UE_LOG(LogCyberWarfare, Warning, TEXT("Could not write shot latency to %s"), *Path);
+		return false;
+	}
+
+	UE_LOG(LogCyberWarfare, Log, TEXT("Shot latency written to %s"), *Path);
+	return true;
+}
+
+
+const TCHAR* USShotLatencyComponent::GetStageName(EShotLatencyStage Stage)
+{
+	switch (Stage)
+	{
+	case EShotLatencyStage::InputToFire:		return TEXT("InputToFire");
+	case EShotLatencyStage::FireToServer:		return TEXT("FireToServer");
+	case EShotLatencyStage::ServerToDamage:		return TEXT("ServerToDamage");
+	case EShotLatencyStage::FireToConfirm:		return TEXT("FireToConfirm");
+	case EShotLatencyStage::InputToConfirm:		return TEXT("InputToConfirm");
+	case EShotLatencyStage::ReloadToConfirm:	return TEXT("ReloadToConfirm");
+	default:									return TEXT("Unknown");
+	}
+}
+
+
+USShotLatencyComponent* USShotLatencyComponent::FindFor(const AActor* OwnedActor)
+{
+	const APlayerController* PlayerController = Cast<APlayerController>(ASPlayerController::FindOwningController(OwnedActor));
+	return PlayerController && PlayerController->IsLocalController() ? PlayerController->FindComponentByClass<USShotLatencyComponent>() : nullptr;
+}
@@ -0,0 +1,171 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SAllocationCounter.h"
+#include "CyberWarfare.h"
+#include "HAL/MemoryBase.h"
+#include "Misc/CommandLine.h"
+
+
+/**
+ * Forwards everything to the allocator it was installed in front of, so blocks allocated before it was installed are freed
+ * by the allocator they came from. Never removed: other threads may still be calling it through a GMalloc they read earlier.
+ */
+class FCountingMalloc : public FMalloc
+{
+public:
+
+	explicit FCountingMalloc(FMalloc* InInner)
+		: Inner(InInner)
+		, NumGameThreadAllocations(0)
+	{
+	}
+
+	virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+	{
+		CountAllocation();
+		return Inner->Malloc(Count, Alignment);
+	}
+
+	virtual void* TryMalloc(SIZE_T Count, uint32 Alignment) override
+	{
+		CountAllocation();
+		return Inner->TryMalloc(Count, Alignment);
+	}
+
+	virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+	{
+		if (Count > 0)
+		{
+			CountAllocation();
+		}
+		return Inner->Realloc(Original, Count, Alignment);
+	}
+
+	virtual void* TryRealloc(void* Original, SIZE_T Count, uint32 Alignment) override
+	{
+		if (Count > 0)
+		{
+			CountAllocation();
+		}
+		return Inner->TryRealloc(Original, Count, Alignment);
+	}
+
+	virtual void Free(void* Original) override
+	{
+		Inner->Free(Original);
+	}
+
+	virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override
+	{
+		return Inner->QuantizeSize(Count, Alignment);
+	}
+
+	virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override
+	{
+		return Inner->GetAllocationSize(Original, SizeOut);
+	}
+
+	virtual void Trim() override
+	{
+		Inner->Trim();
+	}
+
+	virtual void SetupTLSCachesOnCurrentThread() override
+	{
+		Inner->SetupTLSCachesOnCurrentThread();
+	}
+
+	virtual void ClearAndDisableTLSCachesOnCurrentThread() override
+	{
+		Inner->ClearAndDisableTLSCachesOnCurrentThread();
+	}
+
+	virtual void InitializeStatsMetadata() override
+	{
+		Inner->InitializeStatsMetadata();
+	}
+
+	virtual void UpdateStats() override
+	{
+		Inner->UpdateStats();
+	}
+
+	virtual void GetAllocatorStats(FGenericMemoryStats& OutStats) override
+	{
+		Inner->GetAllocatorStats(OutStats);
+	}
+
+	virtual void DumpAllocatorStats(FOutputDevice& Ar) override
+	{
+		Inner->DumpAllocatorStats(Ar);
+	}
+
+	virtual bool IsInternallyThreadSafe() const override
+	{
+		return Inner->IsInternallyThreadSafe();
+	}
+
+	virtual bool ValidateHeap() override
+	{
+		return Inner->ValidateHeap();
+	}
+
+	virtual bool Exec(UWorld* InWorld, const TCHAR* Cmd, FOutputDevice& Ar) override
+	{
+		return Inner->Exec(InWorld, Cmd, Ar);
+	}
+
+	virtual const TCHAR* GetDescriptiveName() override
+	{
+		return Inner->GetDescriptiveName();
+	}
+
+	uint64 GetNumGameThreadAllocations() const
+	{
+		return NumGameThreadAllocations;
+	}
+
+private:
+
+	/** Only the game thread writes the counter, and only the game thread reads it */
+	void CountAllocation()
+	{
+		if (IsInGameThread())
+		{
+			NumGameThreadAllocations++;
+		}
+	}
+
+	FMalloc* Inner;
+	uint64 NumGameThreadAllocations;
+};
+
+
+static FCountingMalloc* CountingMalloc = nullptr;
+
+
+void AllocationCounter::Start()
+{
+	if (CountingMalloc || !FParse::Param(FCommandLine::Get(), TEXT("CountAllocations")))
+	{
+		return;
+	}
+
+	// Leaked on purpose, see FCountingMalloc
+	CountingMalloc = new FCountingMalloc(GMalloc);
+	FPlatformAtomics::InterlockedExchangePtr((void**)&GMalloc, CountingMalloc);
+
+	UE_LOG(LogCyberWarfare, Log, TEXT("Counting game thread allocations"));
+}
+
+
+bool AllocationCounter::IsCounting()
+{
+	return CountingMalloc != nullptr;
+}
+
+
+uint64 AllocationCounter::GetGameThreadAllocations()
+{
+	return CountingMalloc ? CountingMalloc->GetNumGameThreadAllocations() : 0;
+}
@@ -12,10 +12,37 @@
 #include "Components/SkeletalMeshComponent.h"
 #include "GameFramework/CharacterMovementComponent.h"
 #include "Components/StaticMeshComponent.h"
+#include "Engine/AssetManager.h"
+#include "SHitboxKernel.h"
+#include "CyberWarfareGameModeBase.h"
+#include "TimerManager.h"
+#include "Engine/ActorChannel.h"
+#include "SNetPriority.h"
+#include "SPlayerController.h"
+#include "SHitchDetector.h"
+#include "SCombatLog.h"
+#include "Public/Components/SShotLatencyComponent.h"
+#include "Public/Components/SCharacterMovementComponent.h"
+#include "SStartupTiming.h"
+#include "SDeterministicSim.h"
+#include "SInputRecording.h"
+#include "SGameplayRules.h"
+
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Skipped replication compares"), STAT_SkippedReplicationCompares, STATGROUP_CyberWarfare);
+
+/** How long damaging a player raises our net priority for that player */
+static const float DamagedViewerMemory = 3.f;
+
+/** Number of recently damaged players we keep track of */
+static const int32 MaxDamagedViewers = 4;
 
 // Sets default values
-ASCharacter::ASCharacter()
+ASCharacter::ASCharacter(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer.SetDefaultSubobjectClass<USCharacterMovementComponent>(ACharacter::CharacterMovementComponentName))
 {
+	COOP_LLM_SCOPE(Characters);
+
 	// Init names for sockets
 	WeaponAttachSocketNameTPS = "WeaponSocket";
 	WeaponAttachSocketNameFPS = "WeaponSocketFPS";
@@ -49,17 +76,69 @@ ASCharacter::ASCharacter()
 	MeshCompFPS = CreateDefaultSubobject<USkeletalMeshComponent>(TEXT("MeshCompFPS"));
 	MeshCompFPS->SetupAttachment(CameraComp);
 
+	// Holstered weapons are only represented by this cheap mesh on our back
+	HolsterMeshComp = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("HolsterMeshComp"));
+	HolsterMeshComp->SetupAttachment(GetMesh(), WeaponBackSocketNameTPS);
+	HolsterMeshComp->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	HolsterMeshComp->PrimaryComponentTick.bCanEverTick = false;
+	HolsterMeshComp->SetVisibility(false);
+
 	// Enable the possibility to crouch
 	GetMovementComponent()->GetNavAgentPropertiesRef().bCanCrouch = true;
 
 	// Init health component
 	HealthComp = CreateDefaultSubobject<USHealthComponent>(TEXT("HealthComp"));
 
+	// Hitboxes following the mannequin skeleton, weapons test these instead of the physics asset
+	const struct { const TCHAR* Bone; const TCHAR* EndBone; float Radius; EPhysicalSurface Surface; } DefaultHitboxes[] =
+	{
+		{ TEXT("head"), nullptr, 13.f, SURFACE_FLESHVULNERABLE },
+		{ TEXT("spine_03"), TEXT("neck_01"), 18.f, SURFACE_FLESHDEFAULT },
+		{ TEXT("pelvis"), TEXT("spine_03"), 17.f, SURFACE_FLESHDEFAULT },
+		{ TEXT("upperarm_l"), TEXT("lowerarm_l"), 7.f, SURFACE_FLESHDEFAULT },
+		{ TEXT("lowerarm_l"), TEXT("hand_l"), 6.f, SURFACE_FLESHDEFAULT },
+		{ TEXT("upperarm_r"), TEXT("lowerarm_r"), 7.f, SURFACE_FLESHDEFAULT },
+		{ TEXT("lowerarm_r"), TEXT("hand_r"), 6.f, SURFACE_FLESHDEFAULT },
+		{ TEXT("thigh_l"), TEXT("calf_l"), 10.f, SURFACE_FLESHDEFAULT },
+		{ TEXT("calf_l"), TEXT("foot_l"), 8.f, SURFACE_FLESHDEFAULT },
+		{ TEXT("thigh_r"), TEXT("calf_r"), 10.f, SURFACE_FLESHDEFAULT },
+		{ TEXT("calf_r"), TEXT("foot_r"), 8.f, SURFACE_FLESHDEFAULT },
+	};
+	for (const auto& Default : DefaultHitboxes)
+	{
+		FCharacterHitbox Hitbox;
+		Hitbox.BoneName = Default.Bone;
+		Hitbox.EndBoneName = Default.EndBone ? FName(Default.EndBone) : NAME_None;
+		Hitbox.Radius = Default.Radius;
+		Hitbox.SurfaceType = Default.Surface;
+		Hitboxes.Add(Hitbox);
+	}
+
+	HitboxPointsFrame = 0;
+
 	// Set our bag
 	AmmoCount = 300;
 
 	InventorySize = 4;
+	CurrentInventoryIndex = 0;
+	PredictedSwitchSequence = 0;
+	AppliedRespawnCount = 0;
+	bInPawnPool = false;
+
+	CorpseSettleTime = 1.f;
+
+	// Stationary characters replicate at a low rate, movement and combat boost them
+	NetUpdatePolicy = FNetUpdatePolicy(15.f, 60.f, 0.5f);
+	NetUpdateFrequency = NetUpdatePolicy.GetFrequency(false);
+	MinNetUpdateFrequency = NetUpdatePolicy.IdleFrequency;
+	NetActiveEndTime = 0.f;
+	NetActiveControlRotation = FRotator::ZeroRotator;
+	LastNetReceiveTime = 0.f;
 
+	if (HasAnyFlags(RF_ClassDefaultObject) && GetClass() == ASCharacter::StaticClass())
+	{
+		StartupTiming::Mark(EStartupMilestone::CharacterDefaults);
+	}
 }
 
 
@@ -96,6 +175,9 @@ void ASCharacter::SetupPlayerInputComponent(UInputComponent* PlayerInputComponen
 	PlayerInputComponent->BindAction("PrimaryFire", IE_Pressed, this, &ASCharacter::StartFire);
 	PlayerInputComponent->BindAction("PrimaryFire", IE_Released, this, &ASCharacter::StopFire);
 
+	// Bind fire mode switch
+	PlayerInputComponent->BindAction("SwitchFireMode", IE_Pressed, this, &ASCharacter::SwitchFireMode);
+
 	// Bind reload
 	PlayerInputComponent->BindAction("Reload", IE_Pressed, this, &ASCharacter::Reload);
 
@@ -116,30 +198,159 @@ void ASCharacter::BeginPlay()
 {
 	Super::BeginPlay();
 
-	SpawnInventory(); 
+	StartupTiming::Mark(EStartupMilestone::FirstBeginPlay);
 
-	FActorSpawnParameters SpawnParams;
-	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
-
-	NewWeapon = Inventory[0];
-	CurrentInventoryIndex = 0;
-	
-	EquipNewWeapon();
+	// Clients get their inventory and equipped slot through replication
+	if (Role == ROLE_Authority)
+	{
+		SpawnInventory();
+	}
 
 	HealthComp->OnHealthChanged.AddDynamic(this, &ASCharacter::OnHealthChanged);
+
+	// Blueprints may have tuned the policy
+	NetUpdateFrequency = NetUpdatePolicy.GetFrequency(false);
+	MinNetUpdateFrequency = NetUpdatePolicy.IdleFrequency;
 }
 
 
 // Called every frame
 void ASCharacter::Tick(float DeltaTime)
 {
+	HitchDetector::FScopedActorTick HitchTick(this);
+
 	Super::Tick(DeltaTime);
 
 	if (Role == ROLE_Authority)
 	{
 		HealthComp->TickShield(DeltaTime);
-		SetLookRotation(GetControlRotation());
+		const FRotator ControlRotation = GetControlRotation();
+		SetLookRotation(ControlRotation);
+
+		// Moving or turning keeps us at the active rate, no need to force updates for it (slow turns add up against the last active rotation)
+		const float Now = GetWorld()->TimeSeconds;
+		const bool bTurning = !ControlRotation.Equals(NetActiveControlRotation, 0.5f);
+		if (bTurning)
+		{
+			NetActiveControlRotation = ControlRotation;
+		}
+		if (bTurning || !GetVelocity().IsNearlyZero())
+		{
+			NetActiveEndTime = Now + NetUpdatePolicy.BoostDuration;
+		}
+		NetUpdateFrequency = NetUpdatePolicy.GetFrequency(Now < NetActiveEndTime);
+	}
+}
+
+
+void ASCharacter::NotifyNetActivity()
+{
+	if (Role < ROLE_Authority)
+	{
+		return;
+	}
+
+	// Only the start of an activity needs to go out right away
+	const float Now = GetWorld()->TimeSeconds;
+	if (Now >= NetActiveEndTime)
+	{
+		ForceNetUpdate();
+	}
+
+	NetActiveEndTime = Now + NetUpdatePolicy.BoostDuration;
+	NetUpdateFrequency = NetUpdatePolicy.GetFrequency(true);
+}
+
+
+float ASCharacter::GetNetPriority(const FVector& ViewPos, const FVector& ViewDir, AActor* Viewer, AActor* ViewTarget, UActorChannel* InChannel, float Time, bool bLowBandwidth)
+{
+	// Our own connection keeps the engine priority, which already favors the view target
+	if (!NetPriority::IsEnabled() || ViewTarget == this || (Viewer && Viewer == Controller))
+	{
+		return Super::GetNetPriority(ViewPos, ViewDir, Viewer, ViewTarget, InChannel, Time, bLowBandwidth);
+	}
+
+	return Time * NetPriority * NetPriority::GetViewerScale(GetActorLocation(), ViewPos, ViewDir, IsShooting(), HasRecentlyDamaged(Viewer));
+}
+
+
+void ASCharacter::RecordDamageDealt(AController* Victim)
+{
+	const float Now = GetWorld()->TimeSeconds;
+
+	for (FDamagedViewer& DamagedViewer : RecentlyDamagedViewers)
+	{
+		if (DamagedViewer.Controller.Get() == Victim)
+		{
+			DamagedViewer.Time = Now;
+			return;
+		}
+	}
+
+	// Replace the oldest entry when full
+	if (RecentlyDamagedViewers.Num() >= MaxDamagedViewers)
+	{
+		int32 OldestIndex = 0;
+		for (int32 Index = 1; Index < RecentlyDamagedViewers.Num(); Index++)
+		{
+			if (RecentlyDamagedViewers[Index].Time < RecentlyDamagedViewers[OldestIndex].Time)
+			{
+				OldestIndex = Index;
+			}
+		}
+		RecentlyDamagedViewers.RemoveAtSwap(OldestIndex);
+	}
+
+	FDamagedViewer DamagedViewer;
+	DamagedViewer.Controller = Victim;
+	DamagedViewer.Time = Now;
+	RecentlyDamagedViewers.Add(DamagedViewer);
+}
+
+
+bool ASCharacter::HasRecentlyDamaged(const AActor* Viewer) const
+{
+	if (!Viewer)
+	{
+		return false;
 	}
+
+	const float Now = GetWorld()->TimeSeconds;
+	for (const FDamagedViewer& DamagedViewer : RecentlyDamagedViewers)
+	{
+		if (DamagedViewer.Controller.Get() == Viewer && Now - DamagedViewer.Time < DamagedViewerMemory)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+bool ASCharacter::IsShooting() const
+{
+	return bIsFiring || (CurrentWeapon && CurrentWeapon->HasFiredRecently());
+}
+
+
+float ASCharacter::TakeDamage(float DamageAmount, FDamageEvent const& DamageEvent, AController* EventInstigator, AActor* DamageCauser)
+{
+	HitchDetector::FScopedCounter HitchCounter(EGameplayCounter::Damage);
+
+	if (DamageAmount > 0.f)
+	{
+		NotifyNetActivity();
+
+		// Our attacker becomes a priority for us
+		ASCharacter* Attacker = EventInstigator ? Cast<ASCharacter>(EventInstigator->GetPawn()) : nullptr;
+		if (Attacker && Attacker != this && Controller)
+		{
+			Attacker->RecordDamageDealt(Controller);
+		}
+	}
+
+	return Super::TakeDamage(DamageAmount, DamageEvent, EventInstigator, DamageCauser);
 }
 
 
@@ -150,6 +361,8 @@ void ASCharacter::OnHealthChanged(USHealthComponent * HealthComponent, float Hea
 	{
 		// Die
 		bDied = true;
+		HitchDetector::Count(EGameplayCounter::Death);
+		CombatLog::Record(ECombatEvent::Death, InstigatedBy, this, GetActorLocation(), FVector::ZeroVector, HealthDelta);
 
 		StopFire();
 
@@ -158,14 +371,320 @@ void ASCharacter::OnHealthChanged(USHealthComponent * HealthComponent, float Hea
 
 		DetachFromControllerPendingDestroy();
 
-		CurrentWeapon->SetLifeSpan(10.f);
-		SetLifeSpan(10.f);
+		StartCorpse();
+
+		// The game mode recycles our corpse and inventory for a later respawn
+		ACyberWarfareGameModeBase* GameMode = GetWorld()->GetAuthGameMode<ACyberWarfareGameModeBase>();
+		if (GameMode)
+		{
+			GameMode->OnCharacterDied(this);
+		}
+		else
+		{
+			SetLifeSpan(10.f);
+		}
+	}
+}
+
+
+bool FCharacterStateFlags::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	Ar.SerializeBits(&Bits, NumFlags);
+	Bits &= (1 << NumFlags) - 1;
+
+	bOutSuccess = true;
+	return true;
+}
+
+
+void ASCharacter::PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker)
+{
+	StateFlags.SetFlag(FCharacterStateFlags::WantsToZoom, bWantsToZoom);
+	StateFlags.SetFlag(FCharacterStateFlags::Firing, bIsFiring);
+	StateFlags.SetFlag(FCharacterStateFlags::Reloading, bIsReloading);
+	StateFlags.SetFlag(FCharacterStateFlags::Running, bIsRunning);
+	StateFlags.SetFlag(FCharacterStateFlags::Died, bDied);
+
+	Super::PreReplication(ChangedPropertyTracker);
+}
+
+
+bool ASCharacter::ReplicateSubobjects(UActorChannel* Channel, FOutBunch* Bunch, FReplicationFlags* RepFlags)
+{
+	if (GCoopPushReplication <= 0)
+	{
+		return Super::ReplicateSubobjects(Channel, Bunch, RepFlags);
+	}
+
+	// Same as AActor::ReplicateSubobjects, except a clean health component is not even compared
+	bool bWroteSomething = false;
+
+	for (UActorComponent* ActorComp : ReplicatedComponents)
+	{
+		if (!ActorComp || !ActorComp->GetIsReplicated())
+		{
+			continue;
+		}
+
+		if (ActorComp == HealthComp && !HealthComp->ConsumeReplicationDirty(Channel, RepFlags->bNetInitial))
+		{
+			INC_DWORD_STAT_BY(STAT_SkippedReplicationCompares, HealthComp->GetNumReplicatedProperties());
+			continue;
+		}
+
+		bWroteSomething |= ActorComp->ReplicateSubobjects(Channel, Bunch, RepFlags);
+		bWroteSomething |= Channel->ReplicateSubobject(ActorComp, *Bunch, *RepFlags);
+	}
+
+	return bWroteSomething;
+}
+
+
+void ASCharacter::PostNetReceive()
+{
+	Super::PostNetReceive();
+
+	LastNetReceiveTime = GetWorld()->TimeSeconds;
+}
+
+
+float ASCharacter::GetLastNetReceiveTime() const
+{
+	return LastNetReceiveTime;
+}
+
+
+void ASCharacter::OnRep_StateFlags(FCharacterStateFlags PreviousStateFlags)
+{
+	// Zoom, fire and run come from our own input, a change of another bit must not reset them to what the server has
+	if (!IsLocallyControlled())
+	{
+		bWantsToZoom = StateFlags.HasFlag(FCharacterStateFlags::WantsToZoom);
+		bIsFiring = StateFlags.HasFlag(FCharacterStateFlags::Firing);
+		bIsRunning = StateFlags.HasFlag(FCharacterStateFlags::Running);
+	}
+	bIsReloading = StateFlags.HasFlag(FCharacterStateFlags::Reloading);
+	bDied = StateFlags.HasFlag(FCharacterStateFlags::Died);
+
+	const uint8 ChangedBits = StateFlags.Bits ^ PreviousStateFlags.Bits;
+	if (ChangedBits & FCharacterStateFlags::Died)
+	{
+		OnDiedChanged();
+	}
+}
+
+
+void ASCharacter::OnDiedChanged()
+{
+	if (bDied)
+	{
+		StartCorpse();
+	}
+	// We came back out of the pawn pool
+	else
+	{
+		ThawCorpse();
+	}
+}
+
+
+// A corpse only costs something while it settles
+void ASCharacter::StartCorpse()
+{
+	// Shots later in this frame must not hit our hitboxes anymore
+	FHitboxWorldCache::Invalidate(GetWorld());
+
+	for (ASWeapon* Weapon : Inventory)
+	{
+		if (Weapon)
+		{
+			Weapon->OnOwnerDied();
+		}
+	}
+
+	GetWorldTimerManager().SetTimer(TimerHandle_FreezeCorpse, this, &ASCharacter::FreezeCorpse, CorpseSettleTime, false);
+}
+
+
+void ASCharacter::FreezeCorpse()
+{
+	// Keep the last pose, nothing animates, simulates or collides anymore
+	USkeletalMeshComponent* MeshComp = GetMesh();
+	if (MeshComp->IsSimulatingPhysics())
+	{
+		MeshComp->SetSimulatePhysics(false);
+	}
+	MeshComp->bPauseAnims = true;
+	MeshComp->SetComponentTickEnabled(false);
+	MeshComp->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+
+	GetCharacterMovement()->SetComponentTickEnabled(false);
+	SetActorTickEnabled(false);
+
+	if (Role == ROLE_Authority)
+	{
+		SetNetDormancy(DORM_DormantAll);
 	}
 }
 
 
+bool ASCharacter::IsDead() const
+{
+	return bDied;
+}
+
+
+uint32 ASCharacter::GetStateHash(uint32 Crc) const
+{
+	const FVector Location = GetActorLocation();
+	const FRotator Rotation = GetActorRotation();
+	const FVector Velocity = GetVelocity();
+	const uint8 Flags = (bDied ? 1 : 0) | (bIsReloading ? 2 : 0) | (bIsRunning ? 4 : 0) | (bInPawnPool ? 8 : 0);
+
+	Crc = FCrc::MemCrc32(&Location, sizeof(Location), Crc);
+	Crc = FCrc::MemCrc32(&Rotation, sizeof(Rotation), Crc);
+	Crc = FCrc::MemCrc32(&Velocity, sizeof(Velocity), Crc);
+	Crc = FCrc::MemCrc32(&Flags, sizeof(Flags), Crc);
+	Crc = FCrc::MemCrc32(&CurrentInventoryIndex, sizeof(CurrentInventoryIndex), Crc);
+	Crc = HealthComp->GetStateHash(Crc);
+
+	for (const ASWeapon* Weapon : Inventory)
+	{
+		if (Weapon)
+		{
+			Crc = Weapon->GetStateHash(Crc);
+		}
+	}
+	return Crc;
+}
+
+
+// Park out of the game, the game mode keeps us for the next respawn
+void ASCharacter::OnEnterPool()
+{
+	bInPawnPool = true;
+
+	StopFire();
+
+	UCharacterMovementComponent* MovementComp = GetCharacterMovement();
+	MovementComp->StopMovementImmediately();
+	MovementComp->DisableMovement();
+	MovementComp->SetComponentTickEnabled(false);
+
+	SetActorHiddenInGame(true);
+	SetActorEnableCollision(false);
+	SetActorTickEnabled(false);
+
+	// Our inventory stays with us, holstered
+	if (CurrentWeapon)
+	{
+		CurrentWeapon->DetachFromActor(FDetachmentTransformRules::KeepWorldTransform);
+		CurrentWeapon->OnHolstered();
+		CurrentWeapon = nullptr;
+	}
+	HolsterMeshComp->SetVisibility(false);
+
+	// Clients get the hidden state with the last update before dormancy (frozen corpses are dormant already)
+	SetNetDormancy(DORM_DormantAll);
+	FlushNetDormancy();
+}
+
+
+// Everything a fresh spawn would have, without spawning anything
+void ASCharacter::ResetForRespawn()
+{
+	const ASCharacter* Defaults = GetClass()->GetDefaultObject<ASCharacter>();
+
+	SetNetDormancy(DORM_Awake);
+	bInPawnPool = false;
+
+	bDied = false;
+	bWantsToZoom = false;
+	bIsFiring = false;
+	bIsReloading = false;
+	ReloadingWeapon = nullptr;
+	StopRunning();
+
+	HealthComp->ResetHealth();
+
+	AmmoCount = Defaults->AmmoCount;
+	for (ASWeapon* Weapon : Inventory)
+	{
+		if (Weapon)
+		{
+			Weapon->ResetAmmo();
+		}
+	}
+
+	// Respawns start on the first slot, it gets equipped once we are possessed (clients re-equip on the respawn count)
+	WeaponSwitch.InventoryIndex = 0;
+	WeaponSwitch.RespawnCount++;
+	AppliedRespawnCount = WeaponSwitch.RespawnCount;
+	CurrentInventoryIndex = 0;
+
+	ThawCorpse();
+
+	GetCapsuleComponent()->SetCollisionEnabled(Defaults->GetCapsuleComponent()->GetCollisionEnabled());
+	GetCharacterMovement()->SetMovementMode(MOVE_Walking);
+
+	SetActorHiddenInGame(false);
+	SetActorEnableCollision(true);
+}
+
+
+// Undo FreezeCorpse, a ragdoll goes back into the capsule
+void ASCharacter::ThawCorpse()
+{
+	const ASCharacter* Defaults = GetClass()->GetDefaultObject<ASCharacter>();
+
+	GetWorldTimerManager().ClearTimer(TimerHandle_FreezeCorpse);
+	FHitboxWorldCache::Invalidate(GetWorld());
+
+	USkeletalMeshComponent* MeshComp = GetMesh();
+	if (MeshComp->IsSimulatingPhysics())
+	{
+		MeshComp->SetSimulatePhysics(false);
+	}
+	MeshComp->AttachToComponent(GetCapsuleComponent(), FAttachmentTransformRules::SnapToTargetNotIncludingScale);
+	MeshComp->SetRelativeLocationAndRotation(Defaults->GetMesh()->RelativeLocation, Defaults->GetMesh()->RelativeRotation);
+	MeshComp->bPauseAnims = false;
+	MeshComp->SetComponentTickEnabled(true);
+	MeshComp->SetCollisionEnabled(Defaults->GetMesh()->GetCollisionEnabled());
+
+	GetCharacterMovement()->SetComponentTickEnabled(true);
+	SetActorTickEnabled(true);
+}
+
+
+void ASCharacter::PossessedBy(AController* NewController)
+{
+	Super::PossessedBy(NewController);
+
+	// Now that we know whether we are locally controlled, attach to the right mesh
+	ApplyWeaponSwitch();
+}
+
+
+void ASCharacter::Destroyed()
+{
+	if (Role == ROLE_Authority)
+	{
+		for (ASWeapon* Weapon : Inventory)
+		{
+			if (Weapon)
+			{
+				Weapon->Destroy();
+			}
+		}
+	}
+
+	Super::Destroyed();
+}
+
+
 void ASCharacter::SpawnInventory()
 {
+	COOP_LLM_SCOPE(Inventory);
 	
 	if (Role < ROLE_Authority)
 
@@ -174,24 +693,97 @@ void ASCharacter::SpawnInventory()
 	}
 
 
-	else
+	else if (Inventory.Num() == 0)
+	{
+		// Slots are filled as their weapon class finishes streaming in
+		Inventory.SetNumZeroed(InventorySize);
+
+		LoadInventorySlots(StarterWeaponClass2Test, 0, 0);
+		LoadInventorySlots(StarterWeaponClass, 1, InventorySize - 1);
+	}
+}
+
+
+void ASCharacter::LoadInventorySlots(const TSoftClassPtr<ASWeapon>& WeaponClass, int32 FirstSlot, int32 LastSlot)
+{
+	COOP_LLM_SCOPE(Inventory);
+
+	if (WeaponClass.IsNull() || FirstSlot > LastSlot)
+	{
+		return;
+	}
+
+	// Streaming time depends on the disk, the deterministic mode spawns on the frame we ask
+	if (DeterministicSim::IsEnabled())
+	{
+		WeaponClass.LoadSynchronous();
+		SpawnInventorySlots(WeaponClass, FirstSlot, LastSlot);
+		return;
+	}
+
+	// The class of the slot we are about to equip jumps the queue
+	const bool bHoldsEquippedSlot = WeaponSwitch.InventoryIndex >= FirstSlot && WeaponSwitch.InventoryIndex <= LastSlot;
+	const TAsyncLoadPriority Priority = bHoldsEquippedSlot ? FStreamableManager::AsyncLoadHighPriority : FStreamableManager::DefaultAsyncLoadPriority;
+
+	TSharedPtr<FStreamableHandle> Handle = UAssetManager::GetStreamableManager().RequestAsyncLoad(WeaponClass.ToSoftObjectPath(),
+		FStreamableDelegate::CreateUObject(this, &ASCharacter::SpawnInventorySlots, WeaponClass, FirstSlot, LastSlot), Priority);
+
+	if (Handle.IsValid())
+	{
+		InventoryClassHandles.Add(Handle);
+	}
+}
+
+
+void ASCharacter::SpawnInventorySlots(TSoftClassPtr<ASWeapon> WeaponClass, int32 FirstSlot, int32 LastSlot)
+{
+	COOP_LLM_SCOPE(Inventory);
+
+	UClass* LoadedClass = WeaponClass.Get();
+	if (!LoadedClass || bDied)
 	{
-		// Spawn a default weapon
-		FActorSpawnParameters SpawnParams;
-		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		return;
+	}
 
-		Inventory.Add(GetWorld()->SpawnActor<ASWeapon>(StarterWeaponClass2Test, FVector::ZeroVector, FRotator::ZeroRotator, SpawnParams));
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	SpawnParams.Owner = this;
+	SpawnParams.Instigator = this;
 
-		for (int i=1; i<=InventorySize-1; i++)
+	for (int32 Slot = FirstSlot; Slot <= LastSlot && Inventory.IsValidIndex(Slot); Slot++)
+	{
+		if (!Inventory[Slot])
 		{
-			Inventory.Add(GetWorld()->SpawnActor<ASWeapon>(StarterWeaponClass, FVector::ZeroVector, FRotator::ZeroRotator, SpawnParams));
+			HitchDetector::FScopedCounter HitchCounter(EGameplayCounter::Spawn);
+
+			// Everything starts holstered, EquipNewWeapon takes out the one we want
+			Inventory[Slot] = GetWorld()->SpawnActor<ASWeapon>(LoadedClass, FVector::ZeroVector, FRotator::ZeroRotator, SpawnParams);
+			if (Inventory[Slot])
+			{
+				Inventory[Slot]->OnHolstered();
+			}
 		}
 	}
+
+	if (!Inventory.Contains(nullptr))
+	{
+		StartupTiming::Mark(EStartupMilestone::InventorySpawned);
+	}
+
+	ApplyWeaponSwitch();
 }
 
 
 void ASCharacter::Server_SpawnInventory_Implementation()
 {
+	// The inventory is only spawned once per character anyway, refuse repeated requests before looking at it
+	if (!ASPlayerController::ConsumeRpcToken(this, EServerRpc::SpawnInventory, 0.2f, 1.f))
+	{
+		return;
+	}
+
+	InputRecording::Record(EInputEvent::SpawnInventory, this);
+
 	SpawnInventory();
 }
 
@@ -202,38 +794,156 @@ bool ASCharacter::Server_SpawnInventory_Validate()
 
 void ASCharacter::NextWeapon()
 {
-	CurrentInventoryIndex = (CurrentInventoryIndex + 1) % (InventorySize);
-	NewWeapon = Inventory[CurrentInventoryIndex];
-	EquipNewWeapon();
+	if (Inventory.Num() > 0)
+	{
+		SwitchToWeapon((CurrentInventoryIndex + 1) % Inventory.Num());
+	}
 }
 
 void ASCharacter::PreviousWeapon()
 {
-	CurrentInventoryIndex = (CurrentInventoryIndex + InventorySize - 1) % (InventorySize);
-	NewWeapon = Inventory[CurrentInventoryIndex];
+	if (Inventory.Num() > 0)
+	{
+		SwitchToWeapon((CurrentInventoryIndex + Inventory.Num() - 1) % Inventory.Num());
+	}
+}
+
+void ASCharacter::SwitchToWeapon(int32 InventoryIndex)
+{
+	if (bDied || !Inventory.IsValidIndex(InventoryIndex) || !Inventory[InventoryIndex])
+	{
+		return;
+	}
+
+	// Swap locally right away, a held trigger carries over to the new weapon
+	const bool bWasFiring = bIsFiring;
+	StopFire();
+
+	CurrentInventoryIndex = InventoryIndex;
+	NewWeapon = Inventory[InventoryIndex];
 	EquipNewWeapon();
+
+	if (bWasFiring)
+	{
+		StartFire();
+	}
+
+	if (Role == ROLE_Authority)
+	{
+		WeaponSwitch.InventoryIndex = InventoryIndex;
+		NotifyNetActivity();
+	}
+	else
+	{
+		PredictedSwitchSequence++;
+		ServerSwitchWeapon(InventoryIndex, PredictedSwitchSequence);
+	}
 }
 
-void ASCharacter::EquipNewWeapon()
+void ASCharacter::ServerSwitchWeapon_Implementation(uint8 InventoryIndex, uint8 Sequence)
 {
-	//Detach Current Weapon
-	if (CurrentWeapon)
+	// Echo the sequence even if we refuse the switch so the client falls back on our slot
+	if (ASPlayerController::ConsumeRpcToken(this, EServerRpc::SwitchWeapon, 10.f, 4.f))
 	{
-		CurrentWeapon->SetOwner(this);
-		if (IsLocallyControlled())
+		InputRecording::Record(EInputEvent::SwitchWeapon, this, 0.f, Sequence, FVector::ZeroVector, FRotator::ZeroRotator, InventoryIndex);
+		SwitchToWeapon(InventoryIndex);
+	}
+	WeaponSwitch.Sequence = Sequence;
+}
+
+bool ASCharacter::ServerSwitchWeapon_Validate(uint8 InventoryIndex, uint8 Sequence)
+{
+	return InventoryIndex < InventorySize;
+}
+
+void ASCharacter::ApplyWeaponSwitch()
+{
+	if (bInPawnPool)
+	{
+		return;
+	}
+
+	const int32 InventoryIndex = WeaponSwitch.InventoryIndex;
+	if (Inventory.IsValidIndex(InventoryIndex) && Inventory[InventoryIndex])
+	{
+		CurrentInventoryIndex = InventoryIndex;
+		NewWeapon = Inventory[InventoryIndex];
+		EquipNewWeapon();
+	}
+}
+
+void ASCharacter::OnRep_WeaponSwitch()
+{
+	// We came back from the pawn pool, the server holstered everything then and equips from scratch, so do we
+	if (WeaponSwitch.RespawnCount != AppliedRespawnCount)
+	{
+		AppliedRespawnCount = WeaponSwitch.RespawnCount;
+
+		// Switches predicted before we died are moot
+		PredictedSwitchSequence = WeaponSwitch.Sequence;
+
+		if (CurrentWeapon)
 		{
 			CurrentWeapon->DetachFromActor(FDetachmentTransformRules::KeepWorldTransform);
+			CurrentWeapon->OnHolstered();
+			CurrentWeapon = nullptr;
 		}
+		HolsterMeshComp->SetVisibility(false);
+	}
 
-		else
+	// An older answer while newer predictions are in flight, the next one will settle it
+	if (IsLocallyControlled() && WeaponSwitch.Sequence != PredictedSwitchSequence)
+	{
+		return;
+	}
+
+	// Only does something if the server disagrees with what we have
+	ApplyWeaponSwitch();
+}
+
+void ASCharacter::OnRep_Inventory()
+{
+	if (IsLocallyControlled() && Inventory.Num() > 0 && !Inventory.Contains(nullptr))
+	{
+		StartupTiming::Mark(EStartupMilestone::InventorySpawned);
+	}
+
+	// Weapons can replicate after the switch state, equip once they are here
+	if (!IsLocallyControlled() || WeaponSwitch.Sequence == PredictedSwitchSequence)
+	{
+		ApplyWeaponSwitch();
+	}
+}
+
+void ASCharacter::EquipNewWeapon()
+{
+	if (NewWeapon == CurrentWeapon)
+	{
+		return;
+	}
+
+	// Holster Current Weapon, only a proxy mesh stays visible on our back
+	if (CurrentWeapon)
+	{
+		CurrentWeapon->DetachFromActor(FDetachmentTransformRules::KeepWorldTransform);
+		CurrentWeapon->OnHolstered();
+
+		UStaticMesh* HolsterMesh = CurrentWeapon->GetHolsterMesh();
+		if (HolsterMesh)
 		{
-			CurrentWeapon->DetachFromActor(FDetachmentTransformRules::KeepWorldTransform);
-		}
+			if (IsLocallyControlled())
+			{
+				HolsterMeshComp->AttachToComponent(MeshCompFPS, FAttachmentTransformRules::SnapToTargetNotIncludingScale, WeaponBackSocketNameFPS);
+			}
 
-		CurrentWeapon->SetActorHiddenInGame(true);
-		CurrentWeapon->SetActorEnableCollision(false);
-		CurrentWeapon->SetActorTickEnabled(true);
+			else
+			{
+				HolsterMeshComp->AttachToComponent(GetMesh(), FAttachmentTransformRules::SnapToTargetNotIncludingScale, WeaponBackSocketNameTPS);
+			}
 
+			HolsterMeshComp->SetStaticMesh(HolsterMesh);
+		}
+		HolsterMeshComp->SetVisibility(HolsterMesh != nullptr);
 	}
 
 	// Attach New Weapon
@@ -251,27 +961,19 @@ void ASCharacter::EquipNewWeapon()
 		}
 
 		CurrentWeapon = NewWeapon;
-		CurrentWeapon->SetActorHiddenInGame(false);
-		CurrentWeapon->SetActorEnableCollision(true);
-		CurrentWeapon->SetActorTickEnabled(false);
-
+		CurrentWeapon->OnEquipped();
 	}
 }
 
 int32 ASCharacter::RequestAmmos(int32 Request)
 {
-	if (Request > 0)
-	{
-		if (AmmoCount >= Request)
-		{
-			AmmoCount -= Request;
-			return Request;
-		}
-		int32 ReturnAmount = AmmoCount;
-		AmmoCount = 0;
-		return ReturnAmount;
-	}
-	return 0;
+	return GameplayRules::RequestAmmos(AmmoCount, Request);
+}
+
+
+int32 ASCharacter::ReloadClip(int32& ClipCurrentSize, int32 ClipMaxSize)
+{
+	return GameplayRules::ReloadClip(ClipCurrentSize, ClipMaxSize, AmmoCount);
 }
 
 
@@ -316,10 +1018,16 @@ void ASCharacter::Reload()
 	if (Role < ROLE_Authority)
 	{
 		ServerReload();
+
+		USShotLatencyComponent* ShotLatency = USShotLatencyComponent::FindFor(this);
+		if (ShotLatency)
+		{
+			ShotLatency->OnReloadInput();
+		}
 	}
 
 	// If we have a weapon attached and its clip isn't full, we can start our reload animation
-	if (CurrentWeapon && !CurrentWeapon->ClipIsFull())
+	if (CanReload())
 	{
 		if (bIsFiring)
 		{
@@ -331,9 +1039,39 @@ void ASCharacter::Reload()
 }
 
 
+bool ASCharacter::CanReload() const
+{
+	return CurrentWeapon && !CurrentWeapon->ClipIsFull();
+}
+
+
 void ASCharacter::ServerReload_Implementation()
 {
+	const float ReloadDuration = CurrentWeapon ? CurrentWeapon->GetReloadDuration() : 1.f;
+	if (!ASPlayerController::ConsumeRpcToken(this, EServerRpc::Reload, 1.f / FMath::Max(ReloadDuration, 0.1f), 2.f))
+	{
+		return;
+	}
+
+	InputRecording::Record(EInputEvent::Reload, this);
+
+	// Only confirm reloads that start, the latency measurements would otherwise count refused ones
+	const bool bAccepted = CanReload();
 	Reload();
+	if (bAccepted)
+	{
+		ClientConfirmReload();
+	}
+}
+
+
+void ASCharacter::ClientConfirmReload_Implementation()
+{
+	USShotLatencyComponent* ShotLatency = USShotLatencyComponent::FindFor(this);
+	if (ShotLatency)
+	{
+		ShotLatency->OnReloadConfirmed();
+	}
 }
 
 
@@ -361,6 +1099,13 @@ void ASCharacter::StartFire()
 	if (CurrentWeapon && !bIsReloading)
 	{
 		bIsFiring = true;
+
+		USShotLatencyComponent* ShotLatency = Role < ROLE_Authority ? USShotLatencyComponent::FindFor(this) : nullptr;
+		if (ShotLatency)
+		{
+			ShotLatency->OnFireInput();
+		}
+
 		CurrentWeapon->StartFire();
 	}
 }
@@ -376,6 +1121,15 @@ void ASCharacter::StopFire()
 }
 
 
+void ASCharacter::SwitchFireMode()
+{
+	if (CurrentWeapon)
+	{
+		CurrentWeapon->CycleFireMode();
+	}
+}
+
+
 void ASCharacter::StartRunning()
 {	
 	bIsRunning = true;
@@ -419,6 +1173,52 @@ ASWeapon* ASCharacter::GetCurrentWeapon()
 	return (CurrentWeapon);
 }
 
+
+const TArray<ASWeapon*>& ASCharacter::GetInventory() const
+{
+	return Inventory;
+}
+
+
+void ASCharacter::AppendWorldHitboxes(FHitboxCapsuleSoA& Capsules, int32 OwnerIndex) const
+{
+	const USkeletalMeshComponent* MeshComp = GetMesh();
+	if (bDied || !MeshComp || !MeshComp->SkeletalMesh)
+	{
+		return;
+	}
+
+	// Bones only move once per frame, every shot after the first one reuses the same end points
+	if (HitboxPointsFrame != GFrameCounter || HitboxPoints.Num() != Hitboxes.Num() * 2)
+	{
+		HitboxPoints.SetNumUninitialized(Hitboxes.Num() * 2, false);
+		for (int32 Index = 0; Index < Hitboxes.Num(); Index++)
+		{
+			const FCharacterHitbox& Hitbox = Hitboxes[Index];
+			HitboxPoints[Index * 2] = MeshComp->GetSocketLocation(Hitbox.BoneName);
+			HitboxPoints[Index * 2 + 1] = Hitbox.EndBoneName.IsNone() ? HitboxPoints[Index * 2] : MeshComp->GetSocketLocation(Hitbox.EndBoneName);
+		}
+		HitboxPointsFrame = GFrameCounter;
+	}
+
+	for (int32 Index = 0; Index < Hitboxes.Num(); Index++)
+	{
+		Capsules.Add(HitboxPoints[Index * 2], HitboxPoints[Index * 2 + 1], Hitboxes[Index].Radius, OwnerIndex, Hitboxes[Index].SurfaceType);
+	}
+}
+
+
+const FCharacterHitbox& ASCharacter::GetHitbox(int32 HitboxIndex) const
+{
+	return Hitboxes[HitboxIndex];
+}
+
+
+int32 ASCharacter::GetNumHitboxes() const
+{
+	return Hitboxes.Num();
+}
+
 void ASCharacter::SetLookRotation_Implementation(FRotator Rotation)
 {
 	if (!IsLocallyControlled())
@@ -467,9 +1267,7 @@ void ASCharacter::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifet
 {
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
 
-	DOREPLIFETIME(ASCharacter, CurrentWeapon);
-	DOREPLIFETIME(ASCharacter, bDied);
-	DOREPLIFETIME(ASCharacter, bWantsToZoom);
-	DOREPLIFETIME(ASCharacter, bIsFiring);
-	DOREPLIFETIME(ASCharacter, bIsReloading);
+	DOREPLIFETIME(ASCharacter, Inventory);
+	DOREPLIFETIME(ASCharacter, WeaponSwitch);
+	DOREPLIFETIME(ASCharacter, StateFlags);
 }
\ No newline at end of file
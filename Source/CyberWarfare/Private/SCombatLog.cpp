@@ -0,0 +1,164 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SCombatLog.h"
+#include "CyberWarfare.h"
+#include "Engine/World.h"
+#include "GameFramework/Controller.h"
+#include "GameFramework/PlayerState.h"
+#include "SRecordWriter.h"
+#include "SPlayerController.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/Paths.h"
+
+
+static int32 CombatLogEnabled = 1;
+FAutoConsoleVariableRef CVARCombatLog(
+	TEXT("COOP.CombatLog"),
+	CombatLogEnabled,
+	TEXT("Record server shots, hits, damage, deaths and reloads to Saved/CombatLogs (applies to the next match)"),
+	ECVF_Default);
+
+static int32 CombatLogCapacity = 65536;
+FAutoConsoleVariableRef CVARCombatLogCapacity(
+	TEXT("COOP.CombatLogCapacity"),
+	CombatLogCapacity,
+	TEXT("Number of records the combat log buffers before dropping new ones (applies to the next match)"),
+	ECVF_Default);
+
+/** Time the writer sleeps between two drains of the buffer */
+static const float CombatLogDrainInterval = 0.05f;
+
+/** 'CWCL' */
+static const uint32 CombatLogMagic = 0x4C435743;
+static const uint16 CombatLogVersion = 1;
+
+
+/** Start of every combat log file, followed by the records */
+struct FCombatLogHeader
+{
+	uint32 Magic;
+	uint16 Version;
+	uint16 RecordSize;
+	/** FDateTime ticks (UTC) of the start of the log */
+	int64 StartTicks;
+};
+
+
+typedef TRecordWriter<FCombatRecord> FCombatLogWriter;
+
+
+/** Game thread only */
+static struct FCombatLogState
+{
+	TWeakObjectPtr<UWorld> World;
+	FCombatLogWriter* Writer;
+	FRunnableThread* Thread;
+	FString Path;
+	int32 NumDropped;
+} CombatLogState;
+
+
+static int32 GetCombatId(const AActor* Actor)
+{
+	const AController* Controller = ASPlayerController::FindOwningController(Actor);
+	return Controller && Controller->PlayerState ? Controller->PlayerState->PlayerId : INDEX_NONE;
+}
+
+
+void CombatLog::Start(UWorld* World)
+{
+	if (!World || CombatLogEnabled <= 0 || CombatLogState.World.IsValid())
+	{
+		return;
+	}
+
+	const FString Path = FPaths::ProjectSavedDir() / TEXT("CombatLogs") / FString::Printf(TEXT("CombatLog-%s-%s.bin"),
+		*FPaths::GetBaseFilename(World->GetMapName()), *FDateTime::Now().ToString());
+
+	FArchive* File = IFileManager::Get().CreateFileWriter(*Path);
+	if (!File)
+	{
+		UE_LOG(LogCyberWarfare, Warning, TEXT("Could not open combat log %s"), *Path);
+		return;
+	}
+
+	FCombatLogHeader Header;
+	Header.Magic = CombatLogMagic;
+	Header.Version = CombatLogVersion;
+	Header.RecordSize = sizeof(FCombatRecord);
+	Header.StartTicks = FDateTime::UtcNow().GetTicks();
+	File->Serialize(&Header, sizeof(Header));
+
+	CombatLogState.World = World;
+	CombatLogState.Path = Path;
+	CombatLogState.NumDropped = 0;
+	CombatLogState.Writer = new FCombatLogWriter(File, FMath::Max(CombatLogCapacity, 1024), CombatLogDrainInterval);
+	CombatLogState.Thread = FRunnableThread::Create(CombatLogState.Writer, TEXT("CombatLogWriter"), 0, TPri_BelowNormal);
+}
+
+
+void CombatLog::Stop(UWorld* World)
+{
+	if (!World || CombatLogState.World.Get() != World)
+	{
+		return;
+	}
+
+	CombatLogState.World.Reset();
+
+	// Kill asks the writer to stop and waits for its last drain
+	CombatLogState.Thread->Kill(true);
+	delete CombatLogState.Thread;
+	CombatLogState.Thread = nullptr;
+
+	UE_LOG(LogCyberWarfare, Log, TEXT("Combat log %s: %d records, %d dropped"), *CombatLogState.Path, CombatLogState.Writer->NumWritten.GetValue(), CombatLogState.NumDropped);
+
+	delete CombatLogState.Writer;
+	CombatLogState.Writer = nullptr;
+}
+
+
+void CombatLog::Record(ECombatEvent Event, const AActor* Instigator, const AActor* Victim, const FVector& Location, const FVector& Direction, float Value, float Result, uint8 Detail)
+{
+	FCombatLogWriter* Writer = CombatLogState.Writer;
+	if (!Writer || !IsInGameThread())
+	{
+		return;
+	}
+
+	FCombatRecord Record;
+	Record.WorldTime = CombatLogState.World.IsValid() ? CombatLogState.World->TimeSeconds : 0.f;
+	Record.Event = (uint8)Event;
+	Record.Detail = Detail;
+	Record.Reserved = 0;
+	Record.InstigatorId = GetCombatId(Instigator);
+	Record.VictimId = GetCombatId(Victim);
+	Record.Location = Location;
+	Record.Direction = Direction;
+	Record.Value = Value;
+	Record.Result = Result;
+
+	// Never wait for the writer, a full buffer loses the record
+	if (!Writer->Queue.Enqueue(Record))
+	{
+		CombatLogState.NumDropped++;
+	}
+}
+
+
+static FAutoConsoleCommandWithWorldAndArgs CombatLogCommand(
+	TEXT("COOP.CombatLogStats"),
+	TEXT("Logs the number of combat records written and dropped by the current combat log"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (!CombatLogState.Writer)
+		{
+			UE_LOG(LogCyberWarfare, Display, TEXT("No combat log open"));
+			return;
+		}
+
+		UE_LOG(LogCyberWarfare, Display, TEXT("Combat log %s: %d records written, %d dropped"),
+			*CombatLogState.Path, CombatLogState.Writer->NumWritten.GetValue(), CombatLogState.NumDropped);
+	}));
@@ -0,0 +1,184 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SDeterministicSim.h"
+#include "CyberWarfare.h"
+#include "SCharacter.h"
+#include "Misc/App.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformMisc.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+
+
+/** Game thread only */
+static struct FDeterministicSimState
+{
+	TWeakObjectPtr<UWorld> World;
+	FDelegateHandle EndFrameHandle;
+	uint32 NumFrames;
+	int32 HashInterval;
+	float SimSeconds;
+	FString Hashes;
+} SimState;
+
+
+static FString GetHashOutputPath()
+{
+	FString Path;
+	if (!FParse::Value(FCommandLine::Get(), TEXT("CoopHashOutput="), Path))
+	{
+		Path = FPaths::ProjectSavedDir() / TEXT("Deterministic") / FString::Printf(TEXT("StateHashes-%d.txt"), DeterministicSim::GetSeed());
+	}
+	return Path;
+}
+
+
+static void WriteHashes()
+{
+	const FString Path = GetHashOutputPath();
+	if (FFileHelper::SaveStringToFile(SimState.Hashes, *Path))
+	{
+		UE_LOG(LogCyberWarfare, Display, TEXT("Deterministic state hashes written to %s"), *Path);
+	}
+	else
+	{
+		UE_LOG(LogCyberWarfare, Error, TEXT("Could not write deterministic state hashes %s"), *Path);
+	}
+}
+
+
+static void OnEndFrame()
+{
+	UWorld* World = SimState.World.Get();
+	if (!World)
+	{
+		return;
+	}
+
+	SimState.NumFrames++;
+
+	const bool bFinished = SimState.SimSeconds > 0.f && World->GetTimeSeconds() >= SimState.SimSeconds;
+	if (bFinished || SimState.NumFrames % SimState.HashInterval == 0)
+	{
+		SimState.Hashes += FString::Printf(TEXT("%u %.4f %08x\r\n"), SimState.NumFrames, World->GetTimeSeconds(), DeterministicSim::HashWorld(World));
+	}
+
+	if (bFinished)
+	{
+		UE_LOG(LogCyberWarfare, Display, TEXT("Simulated %.1f s in %u frames"), World->GetTimeSeconds(), SimState.NumFrames);
+
+		DeterministicSim::EndWorld(World);
+		FPlatformMisc::RequestExit(false);
+	}
+}
+
+
+bool DeterministicSim::IsEnabled()
+{
+	static const bool bEnabled = FParse::Param(FCommandLine::Get(), TEXT("CoopDeterministic"));
+	return bEnabled;
+}
+
+
+int32 DeterministicSim::GetSeed()
+{
+	int32 Seed = 0;
+	FParse::Value(FCommandLine::Get(), TEXT("CoopSeed="), Seed);
+	return Seed;
+}
+
+
+void DeterministicSim::Start()
+{
+	if (!IsEnabled())
+	{
+		return;
+	}
+
+	float StepRate = 60.f;
+	FParse::Value(FCommandLine::Get(), TEXT("CoopStepRate="), StepRate);
+
+	// The engine does not wait for real time between fixed steps
+	FApp::SetUseFixedTimeStep(true);
+	FApp::SetFixedDeltaTime(1.0 / FMath::Max(StepRate, 1.f));
+
+	FMath::RandInit(GetSeed());
+	FMath::SRandInit(GetSeed());
+
+	UE_LOG(LogCyberWarfare, Display, TEXT("Deterministic mode: fixed step of %.4f s, seed %d"), FApp::GetFixedDeltaTime(), GetSeed());
+}
+
+
+void DeterministicSim::BeginWorld(UWorld* World)
+{
+	if (!IsEnabled() || !World)
+	{
+		return;
+	}
+
+	if (World->GetNetMode() != NM_Standalone)
+	{
+		UE_LOG(LogCyberWarfare, Warning, TEXT("Deterministic mode only holds in standalone games, network timing will make runs diverge"));
+	}
+
+	// Loading consumes a varying amount of random numbers, start the match from the seed
+	FMath::RandInit(GetSeed());
+	FMath::SRandInit(GetSeed());
+
+	SimState.World = World;
+	SimState.NumFrames = 0;
+	SimState.HashInterval = 60;
+	FParse::Value(FCommandLine::Get(), TEXT("CoopHashInterval="), SimState.HashInterval);
+	SimState.HashInterval = FMath::Max(SimState.HashInterval, 1);
+	SimState.SimSeconds = 0.f;
+	FParse::Value(FCommandLine::Get(), TEXT("CoopSimSeconds="), SimState.SimSeconds);
+	SimState.Hashes = FString::Printf(TEXT("# %s, seed %d, step %.6f s: frame, world time, state hash\r\n"), *World->GetMapName(), GetSeed(), FApp::GetFixedDeltaTime());
+
+	SimState.EndFrameHandle = FCoreDelegates::OnEndFrame.AddStatic(&OnEndFrame);
+}
+
+
+void DeterministicSim::EndWorld(UWorld* World)
+{
+	if (!SimState.World.IsValid() || SimState.World.Get() != World)
+	{
+		return;
+	}
+
+	FCoreDelegates::OnEndFrame.Remove(SimState.EndFrameHandle);
+	SimState.World.Reset();
+
+	WriteHashes();
+}
+
+
+uint32 DeterministicSim::HashWorld(UWorld* World)
+{
+	// Actor iteration follows spawn order, which is already deterministic, the name order also holds across builds
+	TArray<ASCharacter*> Characters;
+	for (TActorIterator<ASCharacter> It(World); It; ++It)
+	{
+		Characters.Add(*It);
+	}
+	Characters.Sort([](const ASCharacter& A, const ASCharacter& B) { return A.GetFName().Compare(B.GetFName()) < 0; });
+
+	uint32 Hash = FCrc::MemCrc32(&World->TimeSeconds, sizeof(World->TimeSeconds));
+	for (const ASCharacter* Character : Characters)
+	{
+		Hash = Character->GetStateHash(Hash);
+	}
+	return Hash;
+}
+
+
+static FAutoConsoleCommandWithWorldAndArgs StateHashCommand(
+	TEXT("COOP.StateHash"),
+	TEXT("Logs the hash of the gameplay state compared by the deterministic mode"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		UE_LOG(LogCyberWarfare, Display, TEXT("World time %.4f s: state hash %08x"), World->GetTimeSeconds(), DeterministicSim::HashWorld(World));
+	}));
@@ -0,0 +1,130 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SGameplayRules.h"
+
+
+/** Same results as FMath::Clamp */
+static float ClampFloat(float Value, float Min, float Max)
+{
+	return Value < Min ? Min : (Value < Max ? Value : Max);
+}
+
+
+void GameplayRules::ResetHealth(FHealthState& State, const FHealthSettings& Settings)
+{
+	State.Health = Settings.DefaultHealth;
+	State.Shield = Settings.DefaultShield;
+	State.TimeWithoutTakingDamage = 0.f;
+}
+
+
+GameplayRules::EDamageResult GameplayRules::ApplyDamage(FHealthState& State, const FHealthSettings& Settings, float Damage)
+{
+	if (Damage <= 0.f)
+	{
+		return EDamageResult::None;
+	}
+
+	State.TimeWithoutTakingDamage = 0.f;
+
+	// With 10 shield left a hit of 100 is still absorbed by the shield, the health only takes hits once it is gone
+	if (State.Shield > 0.f)
+	{
+		State.Shield = ClampFloat(State.Shield - Damage, 0.f, Settings.DefaultShield);
+		return EDamageResult::Shield;
+	}
+
+	State.Health = ClampFloat(State.Health - Damage, 0.f, Settings.DefaultHealth);
+	return EDamageResult::Health;
+}
+
+
+bool GameplayRules::TickShield(FHealthState& State, const FHealthSettings& Settings, float DeltaTime)
+{
+	if (Settings.ShieldRegenRate <= 0.f)
+	{
+		return false;
+	}
+
+	State.TimeWithoutTakingDamage += DeltaTime;
+	if (State.TimeWithoutTakingDamage < Settings.TimeBeforeShieldRegen)
+	{
+		return false;
+	}
+
+	// One step per call, the next one is due ShieldRegenInterval later
+	const float OldShield = State.Shield;
+	State.Shield = ClampFloat(State.Shield + Settings.ShieldRegenRate, 0.f, Settings.DefaultShield);
+	State.TimeWithoutTakingDamage = Settings.TimeBeforeShieldRegen - ShieldRegenInterval;
+
+	return State.Shield != OldShield;
+}
+
+
+bool GameplayRules::IsDead(const FHealthState& State)
+{
+	return State.Health <= 0.f;
+}
+
+
+float GameplayRules::GetShotDamage(float BaseDamage, bool bVulnerableSurface)
+{
+	return bVulnerableSurface ? BaseDamage * VulnerableDamageMultiplier : BaseDamage;
+}
+
+
+float GameplayRules::GetRateOfFire(float WeaponRateOfFire, float FireModeRateOfFire)
+{
+	return FireModeRateOfFire > 0.f ? FireModeRateOfFire : WeaponRateOfFire;
+}
+
+
+float GameplayRules::GetTimeBetweenShots(float RoundsPerMinute)
+{
+	return 60.f / (RoundsPerMinute > 1.f ? RoundsPerMinute : 1.f);
+}
+
+
+bool GameplayRules::ClipIsFull(int32_t ClipCurrentSize, int32_t ClipMaxSize)
+{
+	return ClipCurrentSize >= ClipMaxSize;
+}
+
+
+bool GameplayRules::ClipIsEmpty(int32_t ClipCurrentSize)
+{
+	return ClipCurrentSize <= 0;
+}
+
+
+bool GameplayRules::ConsumeRound(int32_t& ClipCurrentSize)
+{
+	if (ClipIsEmpty(ClipCurrentSize))
+	{
+		return false;
+	}
+
+	ClipCurrentSize--;
+	return true;
+}
+
+
+int32_t GameplayRules::RequestAmmos(int32_t& AmmoCount, int32_t Request)
+{
+	if (Request <= 0)
+	{
+		return 0;
+	}
+
+	const int32_t Taken = AmmoCount >= Request ? Request : AmmoCount;
+	AmmoCount -= Taken;
+	return Taken;
+}
+
+
+int32_t GameplayRules::ReloadClip(int32_t& ClipCurrentSize, int32_t ClipMaxSize, int32_t& AmmoCount)
+{
+	const int32_t Loaded = RequestAmmos(AmmoCount, ClipMaxSize - ClipCurrentSize);
+	ClipCurrentSize += Loaded;
+	return Loaded;
+}
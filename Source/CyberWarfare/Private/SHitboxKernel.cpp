@@ -0,0 +1,457 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SHitboxKernel.h"
+#include "CyberWarfare.h"
+#include "EngineUtils.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "CollisionQueryParams.h"
+#include "SCharacter.h"
+
+
+void FHitboxCapsuleSoA::Reset()
+{
+	AX.Reset(); AY.Reset(); AZ.Reset();
+	BX.Reset(); BY.Reset(); BZ.Reset();
+	Radius.Reset();
+	OwnerIndex.Reset();
+	SurfaceType.Reset();
+	Num = 0;
+}
+
+
+void FHitboxCapsuleSoA::Add(const FVector& A, const FVector& B, float InRadius, int32 InOwnerIndex, uint8 InSurfaceType)
+{
+	// Drop the padding of a previous Pad() so real capsules stay packed at the front
+	const int32 NewNum = Num + 1;
+	for (TArray<float>* Array : { &AX, &AY, &AZ, &BX, &BY, &BZ, &Radius })
+	{
+		Array->SetNum(NewNum, false);
+	}
+	OwnerIndex.SetNum(NewNum, false);
+	SurfaceType.SetNum(NewNum, false);
+
+	AX[Num] = A.X; AY[Num] = A.Y; AZ[Num] = A.Z;
+	BX[Num] = B.X; BY[Num] = B.Y; BZ[Num] = B.Z;
+	Radius[Num] = InRadius;
+	OwnerIndex[Num] = InOwnerIndex;
+	SurfaceType[Num] = InSurfaceType;
+	Num = NewNum;
+}
+
+
+void FHitboxCapsuleSoA::Pad()
+{
+	// Padding lanes are masked out by the kernel, their values do not matter
+	const int32 PaddedNum = Align(Num, 4);
+	for (TArray<float>* Array : { &AX, &AY, &AZ, &BX, &BY, &BZ, &Radius })
+	{
+		Array->SetNumZeroed(PaddedNum, false);
+	}
+	OwnerIndex.SetNumZeroed(PaddedNum, false);
+	SurfaceType.SetNumZeroed(PaddedNum, false);
+}
+
+
+namespace HitboxKernel
+{
+	static const VectorRegister TinyNumber = MakeVectorRegister(SMALL_NUMBER, SMALL_NUMBER, SMALL_NUMBER, SMALL_NUMBER);
+	static const VectorRegister NoHit = MakeVectorRegister(BIG_NUMBER, BIG_NUMBER, BIG_NUMBER, BIG_NUMBER);
+
+	/** Entry distance of a ray into a sphere, or BIG_NUMBER */
+	static FORCEINLINE float RaySphere(const FVector& Origin, const FVector& Direction, const FVector& Center, float RadiusSquared)
+	{
+		const FVector OC = Origin - Center;
+		const float B = FVector::DotProduct(Direction, OC);
+		const float H = B * B - (OC.SizeSquared() - RadiusSquared);
+		if (H < 0.f)
+		{
+			return BIG_NUMBER;
+		}
+
+		const float T = -B - FMath::Sqrt(H);
+		return T >= 0.f ? T : BIG_NUMBER;
+	}
+
+	void IntersectRaysScalar(const FHitboxRay* Rays, int32 NumRays, const FHitboxCapsuleSoA& Capsules, FHitboxRayHit* OutHits)
+	{
+		for (int32 RayIndex = 0; RayIndex < NumRays; RayIndex++)
+		{
+			const FHitboxRay& Ray = Rays[RayIndex];
+			FHitboxRayHit& Hit = OutHits[RayIndex];
+			Hit.HitboxIndex = INDEX_NONE;
+			Hit.Distance = Ray.MaxDistance;
+
+			for (int32 Index = 0; Index < Capsules.Num; Index++)
+			{
+				if (Index >= Ray.IgnoredBegin && Index < Ray.IgnoredEnd)
+				{
+					continue;
+				}
+
+				const FVector A(Capsules.AX[Index], Capsules.AY[Index], Capsules.AZ[Index]);
+				const FVector B(Capsules.BX[Index], Capsules.BY[Index], Capsules.BZ[Index]);
+				const float RadiusSquared = FMath::Square(Capsules.Radius[Index]);
+
+				// First hit of a capsule is the closest of its two end spheres and its cylinder side
+				float T = FMath::Min(RaySphere(Ray.Origin, Ray.Direction, A, RadiusSquared), RaySphere(Ray.Origin, Ray.Direction, B, RadiusSquared));
+
+				const FVector BA = B - A;
+				const FVector OA = Ray.Origin - A;
+				const float BABA = FVector::DotProduct(BA, BA);
+				const float BARD = FVector::DotProduct(BA, Ray.Direction);
+				const float BAOA = FVector::DotProduct(BA, OA);
+				const float RDOA = FVector::DotProduct(Ray.Direction, OA);
+				const float OAOA = FVector::DotProduct(OA, OA);
+
+				const float K2 = BABA - BARD * BARD;
+				const float K1 = BABA * RDOA - BAOA * BARD;
+				const float K0 = BABA * OAOA - BAOA * BAOA - RadiusSquared * BABA;
+				const float H = K1 * K1 - K2 * K0;
+				if (H >= 0.f && K2 > KINDA_SMALL_NUMBER)
+				{
+					const float BodyT = (-K1 - FMath::Sqrt(H)) / K2;
+					const float Y = BAOA + BodyT * BARD;
+					if (BodyT >= 0.f && Y > 0.f && Y < BABA)
+					{
+						T = FMath::Min(T, BodyT);
+					}
+				}
+
+				if (T < Hit.Distance)
+				{
+					Hit.Distance = T;
+					Hit.HitboxIndex = Index;
+				}
+			}
+		}
+	}
+
+	/** Entry distance of a ray into 4 spheres (NoHit where missed) */
+	static FORCEINLINE VectorRegister RaySphere4(const VectorRegister& OX, const VectorRegister& OY, const VectorRegister& OZ,
+		const VectorRegister& DX, const VectorRegister& DY, const VectorRegister& DZ,
+		const VectorRegister& CX, const VectorRegister& CY, const VectorRegister& CZ, const VectorRegister& RadiusSquared)
+	{
+		const VectorRegister OCX = VectorSubtract(OX, CX);
+		const VectorRegister OCY = VectorSubtract(OY, CY);
+		const VectorRegister OCZ = VectorSubtract(OZ, CZ);
+
+		const VectorRegister B = VectorMultiplyAdd(DX, OCX, VectorMultiplyAdd(DY, OCY, VectorMultiply(DZ, OCZ)));
+		const VectorRegister OCOC = VectorMultiplyAdd(OCX, OCX, VectorMultiplyAdd(OCY, OCY, VectorMultiply(OCZ, OCZ)));
+		const VectorRegister H = VectorSubtract(VectorMultiply(B, B), VectorSubtract(OCOC, RadiusSquared));
+
+		// sqrt(H) as H * 1/sqrt(H), clamped so missed lanes do not produce NaNs
+		const VectorRegister SafeH = VectorMax(H, TinyNumber);
+		const VectorRegister SqrtH = VectorMultiply(SafeH, VectorReciprocalSqrtAccurate(SafeH));
+		const VectorRegister T = VectorSubtract(VectorNegate(B), SqrtH);
+
+		const VectorRegister Valid = VectorBitwiseAnd(VectorCompareGE(H, GlobalVectorConstants::FloatZero), VectorCompareGE(T, GlobalVectorConstants::FloatZero));
+		return VectorSelect(Valid, T, NoHit);
+	}
+
+	void IntersectRays(const FHitboxRay* Rays, int32 NumRays, const FHitboxCapsuleSoA& Capsules, FHitboxRayHit* OutHits)
+	{
+		checkSlow(Capsules.AX.Num() % 4 == 0 && Capsules.AX.Num() >= Capsules.Num);
+
+		const int32 NumGroups = (Capsules.Num + 3) / 4;
+		const VectorRegister NumCapsules = VectorSetFloat1((float)Capsules.Num);
+		const VectorRegister LaneOffsets = MakeVectorRegister(0.f, 1.f, 2.f, 3.f);
+		const VectorRegister KindaSmall = VectorSetFloat1(KINDA_SMALL_NUMBER);
+
+		for (int32 RayIndex = 0; RayIndex < NumRays; RayIndex++)
+		{
+			const FHitboxRay& Ray = Rays[RayIndex];
+
+			const VectorRegister OX = VectorSetFloat1(Ray.Origin.X);
+			const VectorRegister OY = VectorSetFloat1(Ray.Origin.Y);
+			const VectorRegister OZ = VectorSetFloat1(Ray.Origin.Z);
+			const VectorRegister DX = VectorSetFloat1(Ray.Direction.X);
+			const VectorRegister DY = VectorSetFloat1(Ray.Direction.Y);
+			const VectorRegister DZ = VectorSetFloat1(Ray.Direction.Z);
+
+			const VectorRegister IgnoredBegin = VectorSetFloat1((float)Ray.IgnoredBegin);
+			const VectorRegister IgnoredEnd = VectorSetFloat1((float)Ray.IgnoredEnd);
+
+			VectorRegister BestT = VectorSetFloat1(Ray.MaxDistance);
+			VectorRegister BestIndex = VectorSetFloat1(-1.f);
+
+			for (int32 Group = 0; Group < NumGroups; Group++)
+			{
+				const int32 Base = Group * 4;
+				const VectorRegister AX = VectorLoad(&Capsules.AX[Base]);
+				const VectorRegister AY = VectorLoad(&Capsules.AY[Base]);
+				const VectorRegister AZ = VectorLoad(&Capsules.AZ[Base]);
+				const VectorRegister BX = VectorLoad(&Capsules.BX[Base]);
+				const VectorRegister BY = VectorLoad(&Capsules.BY[Base]);
+				const VectorRegister BZ = VectorLoad(&Capsules.BZ[Base]);
+				const VectorRegister R = VectorLoad(&Capsules.Radius[Base]);
+				const VectorRegister RadiusSquared = VectorMultiply(R, R);
+
+				// End spheres
+				VectorRegister T = VectorMin(RaySphere4(OX, OY, OZ, DX, DY, DZ, AX, AY, AZ, RadiusSquared), RaySphere4(OX, OY, OZ, DX, DY, DZ, BX, BY, BZ, RadiusSquared));
+
+				// Cylinder side
+				const VectorRegister BAX = VectorSubtract(BX, AX);
+				const VectorRegister BAY = VectorSubtract(BY, AY);
+				const VectorRegister BAZ = VectorSubtract(BZ, AZ);
+				const VectorRegister OAX = VectorSubtract(OX, AX);
+				const VectorRegister OAY = VectorSubtract(OY, AY);
+				const VectorRegister OAZ = VectorSubtract(OZ, AZ);
+
+				const VectorRegister BABA = VectorMultiplyAdd(BAX, BAX, VectorMultiplyAdd(BAY, BAY, VectorMultiply(BAZ, BAZ)));
+				const VectorRegister BARD = VectorMultiplyAdd(BAX, DX, VectorMultiplyAdd(BAY, DY, VectorMultiply(BAZ, DZ)));
+				const VectorRegister BAOA = VectorMultiplyAdd(BAX, OAX, VectorMultiplyAdd(BAY, OAY, VectorMultiply(BAZ, OAZ)));
+				const VectorRegister RDOA = VectorMultiplyAdd(DX, OAX, VectorMultiplyAdd(DY, OAY, VectorMultiply(DZ, OAZ)));
+				const VectorRegister OAOA = VectorMultiplyAdd(OAX, OAX, VectorMultiplyAdd(OAY, OAY, VectorMultiply(OAZ, OAZ)));
+
+				const VectorRegister K2 = VectorSubtract(BABA, VectorMultiply(BARD, BARD));
+				const VectorRegister K1 = VectorSubtract(VectorMultiply(BABA, RDOA), VectorMultiply(BAOA, BARD));
+				const VectorRegister K0 = VectorSubtract(VectorSubtract(VectorMultiply(BABA, OAOA), VectorMultiply(BAOA, BAOA)), VectorMultiply(RadiusSquared, BABA));
+				const VectorRegister H = VectorSubtract(VectorMultiply(K1, K1), VectorMultiply(K2, K0));
+
+				const VectorRegister SafeH = VectorMax(H, TinyNumber);
+				const VectorRegister SafeK2 = VectorMax(K2, KindaSmall);
+				const VectorRegister BodyT = VectorMultiply(VectorSubtract(VectorNegate(K1), VectorMultiply(SafeH, VectorReciprocalSqrtAccurate(SafeH))), VectorReciprocalAccurate(SafeK2));
+				const VectorRegister Y = VectorMultiplyAdd(BodyT, BARD, BAOA);
+
+				VectorRegister BodyValid = VectorBitwiseAnd(VectorCompareGE(H, GlobalVectorConstants::FloatZero), VectorCompareGT(K2, KindaSmall));
+				BodyValid = VectorBitwiseAnd(BodyValid, VectorCompareGE(BodyT, GlobalVectorConstants::FloatZero));
+				BodyValid = VectorBitwiseAnd(BodyValid, VectorBitwiseAnd(VectorCompareGT(Y, GlobalVectorConstants::FloatZero), VectorCompareGT(BABA, Y)));
+				T = VectorMin(T, VectorSelect(BodyValid, BodyT, NoHit));
+
+				// Keep the closest hit per lane, ignoring padding lanes and the ignored range
+				const VectorRegister LaneIndex = VectorAdd(VectorSetFloat1((float)Base), LaneOffsets);
+				const VectorRegister NotIgnored = VectorBitwiseOr(VectorCompareGT(IgnoredBegin, LaneIndex), VectorCompareGE(LaneIndex, IgnoredEnd));
+				const VectorRegister Closer = VectorBitwiseAnd(VectorBitwiseAnd(VectorCompareGT(BestT, T), VectorCompareGT(NumCapsules, LaneIndex)), NotIgnored);
+				BestT = VectorSelect(Closer, T, BestT);
+				BestIndex = VectorSelect(Closer, LaneIndex, BestIndex);
+			}
+
+			// Reduce the 4 lanes
+			float LaneT[4];
+			float LaneIndices[4];
+			VectorStore(BestT, LaneT);
+			VectorStore(BestIndex, LaneIndices);
+
+			FHitboxRayHit& Hit = OutHits[RayIndex];
+			Hit.HitboxIndex = INDEX_NONE;
+			Hit.Distance = Ray.MaxDistance;
+			for (int32 Lane = 0; Lane < 4; Lane++)
+			{
+				if (LaneIndices[Lane] >= 0.f && LaneT[Lane] < Hit.Distance)
+				{
+					Hit.Distance = LaneT[Lane];
+					Hit.HitboxIndex = (int32)LaneIndices[Lane];
+				}
+			}
+		}
+	}
+}
+
+
+/** Caches of the live worlds, each dropped with its world */
+static TMap<const UWorld*, TUniquePtr<FHitboxWorldCache>>& GetHitboxWorldCaches()
+{
+	static TMap<const UWorld*, TUniquePtr<FHitboxWorldCache>> Caches;
+	static FDelegateHandle WorldCleanupHandle = FWorldDelegates::OnWorldCleanup.AddLambda([](UWorld* World, bool bSessionEnded, bool bCleanupResources)
+	{
+		Caches.Remove(World);
+	});
+	return Caches;
+}
+
+
+const FHitboxWorldCache& FHitboxWorldCache::Get(UWorld* World)
+{
+	check(IsInGameThread());
+
+	TUniquePtr<FHitboxWorldCache>& Cache = GetHitboxWorldCaches().FindOrAdd(World);
+	if (!Cache.IsValid())
+	{
+		Cache = MakeUnique<FHitboxWorldCache>();
+	}
+
+	// Bones only move once per frame, every shot after the first one reuses the same capsules
+	if (Cache->BuiltFrame != GFrameCounter)
+	{
+		Cache->Rebuild(World);
+	}
+	return *Cache;
+}
+
+
+void FHitboxWorldCache::Invalidate(const UWorld* World)
+{
+	TUniquePtr<FHitboxWorldCache>* Cache = GetHitboxWorldCaches().Find(World);
+	if (Cache && Cache->IsValid())
+	{
+		(*Cache)->BuiltFrame = MAX_uint64;
+	}
+}
+
+
+void FHitboxWorldCache::Rebuild(UWorld* World)
+{
+	Capsules.Reset();
+	Characters.Reset();
+	FirstCapsules.Reset();
+
+	for (TActorIterator<ASCharacter> It(World); It; ++It)
+	{
+		const int32 FirstCapsule = Capsules.Num;
+		It->AppendWorldHitboxes(Capsules, Characters.Num());
+		if (Capsules.Num > FirstCapsule)
+		{
+			Characters.Add(*It);
+			FirstCapsules.Add(FirstCapsule);
+		}
+	}
+	FirstCapsules.Add(Capsules.Num);
+	Capsules.Pad();
+
+	BuiltFrame = GFrameCounter;
+}
+
+
+const FHitboxCapsuleSoA& FHitboxWorldCache::GetCapsules() const
+{
+	return Capsules;
+}
+
+
+ASCharacter* FHitboxWorldCache::GetCharacter(int32 OwnerIndex) const
+{
+	return Characters.IsValidIndex(OwnerIndex) ? Characters[OwnerIndex].Get() : nullptr;
+}
+
+
+void FHitboxWorldCache::GetCapsuleRange(const ASCharacter* Character, int32& OutBegin, int32& OutEnd) const
+{
+	OutBegin = OutEnd = 0;
+
+	const int32 OwnerIndex = Characters.IndexOfByKey(Character);
+	if (OwnerIndex != INDEX_NONE)
+	{
+		OutBegin = FirstCapsules[OwnerIndex];
+		OutEnd = FirstCapsules[OwnerIndex + 1];
+	}
+}
+
+
+void FHitboxWorldCache::AddIgnoredCharacters(FCollisionQueryParams& QueryParams) const
+{
+	for (const TWeakObjectPtr<ASCharacter>& Character : Characters)
+	{
+		if (Character.IsValid())
+		{
+			QueryParams.AddIgnoredActor(Character.Get());
+		}
+	}
+}
+
+
+/**
+ * Microbenchmark: COOP.BenchHitboxes [NumRays] [NumCharacters]
+ * Compares complex PhysX weapon traces against the characters of the world with the scalar and vector hitbox kernels.
+ * Without enough characters in the world, synthetic ones are generated for the kernels.
+ */
+static void BenchHitboxes(const TArray<FString>& Args, UWorld* World)
+{
+	const int32 NumRays = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 10000;
+	const int32 NumSyntheticCharacters = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 32;
+
+	FRandomStream Random(1337);
+
+	// Hitboxes from the world characters, or synthetic ones laid out on a grid
+	FHitboxCapsuleSoA Capsules;
+	TArray<FVector> Targets;
+	if (World)
+	{
+		int32 OwnerIndex = 0;
+		for (TActorIterator<ASCharacter> It(World); It; ++It)
+		{
+			It->AppendWorldHitboxes(Capsules, OwnerIndex++);
+			Targets.Add(It->GetActorLocation());
+		}
+	}
+	const bool bSynthetic = Targets.Num() == 0;
+	if (bSynthetic)
+	{
+		for (int32 Character = 0; Character < NumSyntheticCharacters; Character++)
+		{
+			const FVector Root((Character % 8) * 300.f, (Character / 8) * 300.f, 0.f);
+			Targets.Add(Root);
+			for (int32 Box = 0; Box < 15; Box++)
+			{
+				const FVector A = Root + Random.VRand() * 40.f + FVector(0.f, 0.f, 90.f);
+				const FVector B = A + Random.VRand() * 30.f;
+				Capsules.Add(A, B, Random.FRandRange(6.f, 18.f), Character, 0);
+			}
+		}
+	}
+	Capsules.Pad();
+
+	TArray<FHitboxRay> Rays;
+	Rays.SetNumUninitialized(NumRays);
+	for (FHitboxRay& Ray : Rays)
+	{
+		const FVector Target = Targets[Random.RandHelper(Targets.Num())] + Random.VRand() * 50.f + FVector(0.f, 0.f, 90.f);
+		Ray.Origin = Target + Random.VRand() * 2000.f;
+		Ray.Direction = (Target - Ray.Origin).GetSafeNormal();
+		Ray.MaxDistance = 10000.f;
+		Ray.IgnoredBegin = 0;
+		Ray.IgnoredEnd = 0;
+	}
+
+	TArray<FHitboxRayHit> ScalarHits;
+	TArray<FHitboxRayHit> VectorHits;
+	ScalarHits.SetNumUninitialized(NumRays);
+	VectorHits.SetNumUninitialized(NumRays);
+
+	double StartTime = FPlatformTime::Seconds();
+	HitboxKernel::IntersectRaysScalar(Rays.GetData(), NumRays, Capsules, ScalarHits.GetData());
+	const double ScalarTime = FPlatformTime::Seconds() - StartTime;
+
+	StartTime = FPlatformTime::Seconds();
+	HitboxKernel::IntersectRays(Rays.GetData(), NumRays, Capsules, VectorHits.GetData());
+	const double VectorTime = FPlatformTime::Seconds() - StartTime;
+
+	int32 Mismatches = 0;
+	for (int32 RayIndex = 0; RayIndex < NumRays; RayIndex++)
+	{
+		// A wrong distance is a mismatch even on the right capsule, a different capsule only if it is not as close (overlapping capsules)
+		const float DistanceError = FMath::Abs(ScalarHits[RayIndex].Distance - VectorHits[RayIndex].Distance);
+		const bool bTie = DistanceError <= 0.01f;
+		if (DistanceError > 0.1f || (ScalarHits[RayIndex].HitboxIndex != VectorHits[RayIndex].HitboxIndex && !bTie))
+		{
+			Mismatches++;
+		}
+	}
+
+	UE_LOG(LogCyberWarfare, Display, TEXT("BenchHitboxes: %d rays vs %d hitboxes (%s)"), NumRays, Capsules.Num, bSynthetic ? TEXT("synthetic") : TEXT("world characters"));
+	UE_LOG(LogCyberWarfare, Display, TEXT("  scalar kernel: %.0f rays/s"), NumRays / FMath::Max(ScalarTime, 1e-9));
+	UE_LOG(LogCyberWarfare, Display, TEXT("  vector kernel: %.0f rays/s (%d mismatches)"), NumRays / FMath::Max(VectorTime, 1e-9), Mismatches);
+
+	// The same rays through the physics scene, as the weapons used to do it
+	if (World && !bSynthetic)
+	{
+		FCollisionQueryParams QueryParams;
+		QueryParams.bTraceComplex = true;
+		QueryParams.bReturnPhysicalMaterial = true;
+
+		StartTime = FPlatformTime::Seconds();
+		for (const FHitboxRay& Ray : Rays)
+		{
+			FHitResult Hit;
+			World->LineTraceSingleByChannel(Hit, Ray.Origin, Ray.Origin + Ray.Direction * Ray.MaxDistance, COLLISION_WEAPON, QueryParams);
+		}
+		const double PhysicsTime = FPlatformTime::Seconds() - StartTime;
+
+		UE_LOG(LogCyberWarfare, Display, TEXT("  physics traces: %.0f rays/s"), NumRays / FMath::Max(PhysicsTime, 1e-9));
+	}
+}
+
+FAutoConsoleCommandWithWorldAndArgs BenchHitboxesCommand(
+	TEXT("COOP.BenchHitboxes"),
+	TEXT("Benchmarks the hitbox ray kernels against complex physics traces. Usage: COOP.BenchHitboxes [NumRays] [NumCharacters]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchHitboxes));
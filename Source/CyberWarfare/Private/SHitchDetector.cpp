@@ -0,0 +1,413 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SHitchDetector.h"
+#include "CyberWarfare.h"
+#include "SCharacter.h"
+#include "SWeapon.h"
+#include "SPlayerController.h"
+#include "Engine/World.h"
+#include "Engine/Level.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/FileManager.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+
+static int32 HitchDetectorEnabled = 1;
+FAutoConsoleVariableRef CVARHitchDetector(
+	TEXT("COOP.HitchDetector"),
+	HitchDetectorEnabled,
+	TEXT("Capture a gameplay snapshot of every server frame over COOP.HitchBudgetMs"),
+	ECVF_Default);
+
+static float HitchBudgetMs = 50.f;
+FAutoConsoleVariableRef CVARHitchBudgetMs(
+	TEXT("COOP.HitchBudgetMs"),
+	HitchBudgetMs,
+	TEXT("Server frame time (ms) above which a frame is reported as a hitch"),
+	ECVF_Default);
+
+static int32 HitchLogMaxKB = 1024;
+FAutoConsoleVariableRef CVARHitchLogMaxKB(
+	TEXT("COOP.HitchLogMaxKB"),
+	HitchLogMaxKB,
+	TEXT("Size (KB) at which the hitch log is rolled over to its backup"),
+	ECVF_Default);
+
+/** Number of most expensive ticking actors kept per frame */
+static const int32 MaxTopActors = 8;
+
+/** Number of hitches that can be captured before the next frame within budget writes them */
+static const int32 MaxPendingSnapshots = 16;
+
+
+struct FHitchTopActor
+{
+	FName ActorName;
+	FName ClassName;
+	uint32 Cycles;
+};
+
+
+/** Everything we know about one frame, copied as is into a snapshot when the frame is over budget */
+struct FHitchFrame
+{
+	uint32 Counts[(int32)EGameplayCounter::Num];
+	uint32 Cycles[(int32)EGameplayCounter::Num];
+	uint32 Rpcs[(int32)EServerRpc::Num];
+	FHitchTopActor TopActors[MaxTopActors];
+	int32 NumTopActors;
+};
+
+
+struct FHitchSnapshot
+{
+	FHitchFrame Frame;
+	FDateTime Date;
+	uint64 FrameNumber;
+	float WorldTime;
+	float FrameMs;
+	float BudgetMs;
+	int32 NumActors;
+	int32 NumTickingActors;
+	int32 NumCharacters;
+	int32 NumWeapons;
+};
+
+
+/** Game thread only */
+static struct FHitchDetectorState
+{
+	TWeakObjectPtr<UWorld> World;
+	FDelegateHandle BeginFrameHandle;
+	FDelegateHandle EndFrameHandle;
+	uint64 FrameStartCycles;
+	bool bCounting;
+
+	FHitchFrame Frame;
+	FHitchSnapshot PendingSnapshots[MaxPendingSnapshots];
+	int32 NumPendingSnapshots;
+
+	int32 NumHitches;
+	int32 NumDroppedSnapshots;
+} HitchState;
+
+
+static const TCHAR* GetCounterName(EGameplayCounter Counter)
+{
+	switch (Counter)
+	{
+	case EGameplayCounter::Fire:		return TEXT("Fire");
+	case EGameplayCounter::WeaponTrace:	return TEXT("WeaponTrace");
+	case EGameplayCounter::Damage:		return TEXT("Damage");
+	case EGameplayCounter::Death:		return TEXT("Death");
+	case EGameplayCounter::Spawn:		return TEXT("Spawn");
+	default:							return TEXT("Unknown");
+	}
+}
+
+
+static FString GetHitchLogPath()
+{
+	return FPaths::ProjectSavedDir() / TEXT("Hitches") / TEXT("ServerHitches.log");
+}
+
+
+static FString FormatSnapshot(const FHitchSnapshot& Snapshot)
+{
+	const FHitchFrame& Frame = Snapshot.Frame;
+
+	FString Text = FString::Printf(TEXT("[%s] Frame %llu, world time %.2f s: %.2f ms (budget %.2f ms)\r\n"),
+		*Snapshot.Date.ToString(), Snapshot.FrameNumber, Snapshot.WorldTime, Snapshot.FrameMs, Snapshot.BudgetMs);
+
+	Text += TEXT("  Gameplay:");
+	for (int32 Counter = 0; Counter < (int32)EGameplayCounter::Num; Counter++)
+	{
+		Text += FString::Printf(TEXT(" %s %u (%.2f ms)"), GetCounterName((EGameplayCounter)Counter), Frame.Counts[Counter], FPlatformTime::ToMilliseconds(Frame.Cycles[Counter]));
+	}
+
+	Text += TEXT("\r\n  RPCs:");
+	for (int32 Rpc = 0; Rpc < (int32)EServerRpc::Num; Rpc++)
+	{
+		Text += FString::Printf(TEXT(" %s %u"), ASPlayerController::GetRpcName((EServerRpc)Rpc), Frame.Rpcs[Rpc]);
+	}
+
+	Text += FString::Printf(TEXT("\r\n  Actors: %d (%d ticking), %d characters, %d weapons\r\n"),
+		Snapshot.NumActors, Snapshot.NumTickingActors, Snapshot.NumCharacters, Snapshot.NumWeapons);
+
+	Text += TEXT("  Most expensive ticks:\r\n");
+	for (int32 Index = 0; Index < Frame.NumTopActors; Index++)
+	{
+		const FHitchTopActor& TopActor = Frame.TopActors[Index];
+		Text += FString::Printf(TEXT("    %s (%s) %.2f ms\r\n"), *TopActor.ActorName.ToString(), *TopActor.ClassName.ToString(), FPlatformTime::ToMilliseconds(TopActor.Cycles));
+	}
+
+	return Text;
+}
+
+
+// Formatting and file IO happen here, never in the frame that hitched
+static void WritePendingSnapshots()
+{
+	if (HitchState.NumPendingSnapshots == 0)
+	{
+		return;
+	}
+
+	FString Text;
+	for (int32 Index = 0; Index < HitchState.NumPendingSnapshots; Index++)
+	{
+		const FHitchSnapshot& Snapshot = HitchState.PendingSnapshots[Index];
+		UE_LOG(LogCyberWarfare, Warning, TEXT("Server hitch: frame %llu took %.2f ms"), Snapshot.FrameNumber, Snapshot.FrameMs);
+		Text += FormatSnapshot(Snapshot);
+	}
+
+	if (HitchState.NumDroppedSnapshots > 0)
+	{
+		Text += FString::Printf(TEXT("  (%d hitches not captured, too many in a row)\r\n"), HitchState.NumDroppedSnapshots);
+		HitchState.NumDroppedSnapshots = 0;
+	}
+
+	HitchState.NumPendingSnapshots = 0;
+
+	// Roll the log over once it is too big, we keep the current file and one backup
+	const FString Path = GetHitchLogPath();
+	if (IFileManager::Get().FileSize(*Path) > (int64)HitchLogMaxKB * 1024)
+	{
+		IFileManager::Get().Move(*FPaths::Combine(FPaths::GetPath(Path), TEXT("ServerHitches-backup.log")), *Path, true);
+	}
+
+	FFileHelper::SaveStringToFile(Text, *Path, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM, &IFileManager::Get(), FILEWRITE_Append);
+}
+
+
+static void CaptureSnapshot(UWorld* World, float FrameMs)
+{
+	HitchState.NumHitches++;
+
+	if (HitchState.NumPendingSnapshots >= MaxPendingSnapshots)
+	{
+		HitchState.NumDroppedSnapshots++;
+		return;
+	}
+
+	FHitchSnapshot& Snapshot = HitchState.PendingSnapshots[HitchState.NumPendingSnapshots++];
+	Snapshot.Frame = HitchState.Frame;
+	Snapshot.Date = FDateTime::Now();
+	Snapshot.FrameNumber = GFrameCounter;
+	Snapshot.WorldTime = World->TimeSeconds;
+	Snapshot.FrameMs = FrameMs;
+	Snapshot.BudgetMs = HitchBudgetMs;
+	Snapshot.NumActors = 0;
+	Snapshot.NumTickingActors = 0;
+	Snapshot.NumCharacters = 0;
+	Snapshot.NumWeapons = 0;
+
+	// Walk the level actor arrays directly, actor iterators gather their results in a new array
+	for (const ULevel* Level : World->GetLevels())
+	{
+		if (!Level)
+		{
+			continue;
+		}
+
+		for (const AActor* Actor : Level->Actors)
+		{
+			if (!Actor || Actor->IsPendingKill())
+			{
+				continue;
+			}
+
+			Snapshot.NumActors++;
+			Snapshot.NumTickingActors += Actor->IsActorTickEnabled() ? 1 : 0;
+			Snapshot.NumCharacters += Actor->IsA<ASCharacter>() ? 1 : 0;
+			Snapshot.NumWeapons += Actor->IsA<ASWeapon>() ? 1 : 0;
+		}
+	}
+}
+
+
+static void OnBeginFrame()
+{
+	HitchState.FrameStartCycles = FPlatformTime::Cycles64();
+	HitchState.bCounting = HitchDetectorEnabled > 0;
+}
+
+
+static void OnEndFrame()
+{
+	UWorld* World = HitchState.World.Get();
+	if (!World || !HitchState.bCounting)
+	{
+		return;
+	}
+
+	const float FrameMs = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - HitchState.FrameStartCycles);
+	if (FrameMs > HitchBudgetMs)
+	{
+		CaptureSnapshot(World, FrameMs);
+	}
+	else
+	{
+		WritePendingSnapshots();
+	}
+
+	FMemory::Memzero(HitchState.Frame);
+}
+
+
+void HitchDetector::Start(UWorld* World)
+{
+	// One world per process is enough, PIE clients do not run a game mode anyway
+	if (!World || HitchState.World.IsValid())
+	{
+		return;
+	}
+
+	HitchState.World = World;
+	HitchState.bCounting = false;
+	HitchState.NumPendingSnapshots = 0;
+	HitchState.NumDroppedSnapshots = 0;
+	FMemory::Memzero(HitchState.Frame);
+
+	HitchState.BeginFrameHandle = FCoreDelegates::OnBeginFrame.AddStatic(&OnBeginFrame);
+	HitchState.EndFrameHandle = FCoreDelegates::OnEndFrame.AddStatic(&OnEndFrame);
+}
+
+
+void HitchDetector::Stop(UWorld* World)
+{
+	if (!World || HitchState.World.Get() != World)
+	{
+		return;
+	}
+
+	FCoreDelegates::OnBeginFrame.Remove(HitchState.BeginFrameHandle);
+	FCoreDelegates::OnEndFrame.Remove(HitchState.EndFrameHandle);
+
+	WritePendingSnapshots();
+
+	HitchState.World.Reset();
+	HitchState.bCounting = false;
+}
+
+
+void HitchDetector::Count(EGameplayCounter Counter, uint32 Cycles)
+{
+	if (HitchState.bCounting && IsInGameThread())
+	{
+		HitchState.Frame.Counts[(int32)Counter]++;
+		HitchState.Frame.Cycles[(int32)Counter] += Cycles;
+	}
+}
+
+
+void HitchDetector::CountRpc(EServerRpc Rpc)
+{
+	if (HitchState.bCounting && IsInGameThread())
+	{
+		HitchState.Frame.Rpcs[(int32)Rpc]++;
+	}
+}
+
+
+// Keeps the most expensive actors of the frame sorted, most expensive first
+void HitchDetector::CountActorTick(const AActor* Actor, uint32 Cycles)
+{
+	if (!HitchState.bCounting || !Actor || !IsInGameThread())
+	{
+		return;
+	}
+
+	FHitchFrame& Frame = HitchState.Frame;
+	const FName ActorName = Actor->GetFName();
+
+	// An actor ticking several times in the frame (actor and components) adds up
+	int32 Index = 0;
+	while (Index < Frame.NumTopActors && Frame.TopActors[Index].ActorName != ActorName)
+	{
+		Index++;
+	}
+
+	if (Index < Frame.NumTopActors)
+	{
+		Cycles += Frame.TopActors[Index].Cycles;
+	}
+	else if (Frame.NumTopActors < MaxTopActors)
+	{
+		Index = Frame.NumTopActors++;
+	}
+	else if (Cycles > Frame.TopActors[MaxTopActors - 1].Cycles)
+	{
+		Index = MaxTopActors - 1;
+	}
+	else
+	{
+		return;
+	}
+
+	// Bubble the entry up to its place
+	while (Index > 0 && Frame.TopActors[Index - 1].Cycles < Cycles)
+	{
+		Frame.TopActors[Index] = Frame.TopActors[Index - 1];
+		Index--;
+	}
+
+	FHitchTopActor& TopActor = Frame.TopActors[Index];
+	TopActor.ActorName = ActorName;
+	TopActor.ClassName = Actor->GetClass()->GetFName();
+	TopActor.Cycles = Cycles;
+}
+
+
+HitchDetector::FScopedCounter::FScopedCounter(EGameplayCounter InCounter)
+	: Counter(InCounter)
+	, StartCycles(0)
+	, bActive(HitchState.bCounting)
+{
+	if (bActive)
+	{
+		StartCycles = FPlatformTime::Cycles();
+	}
+}
+
+
+HitchDetector::FScopedCounter::~FScopedCounter()
+{
+	if (bActive)
+	{
+		Count(Counter, FPlatformTime::Cycles() - StartCycles);
+	}
+}
+
+
+HitchDetector::FScopedActorTick::FScopedActorTick(const AActor* InActor)
+	: Actor(InActor)
+	, StartCycles(0)
+	, bActive(HitchState.bCounting)
+{
+	if (bActive)
+	{
+		StartCycles = FPlatformTime::Cycles();
+	}
+}
+
+
+HitchDetector::FScopedActorTick::~FScopedActorTick()
+{
+	if (bActive)
+	{
+		CountActorTick(Actor, FPlatformTime::Cycles() - StartCycles);
+	}
+}
+
+
+static FAutoConsoleCommandWithWorldAndArgs HitchesCommand(
+	TEXT("COOP.Hitches"),
+	TEXT("Logs the number of server hitches captured so far and where they are written"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		UE_LOG(LogCyberWarfare, Display, TEXT("%d hitches over %.2f ms (%s), written to %s"),
+			HitchState.NumHitches, HitchBudgetMs, HitchState.World.IsValid() ? TEXT("watching") : TEXT("not watching"), *GetHitchLogPath());
+	}));
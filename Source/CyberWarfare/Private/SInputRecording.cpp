@@ -0,0 +1,528 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SInputRecording.h"
+#include "CyberWarfare.h"
+#include "SRecordWriter.h"
+#include "SCharacter.h"
+#include "SWeapon.h"
+#include "SPlayerController.h"
+#include "Public/Components/SCharacterMovementComponent.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "GameFramework/GameModeBase.h"
+#include "GameFramework/PlayerState.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformMisc.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/CommandLine.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+
+static int32 InputRecordingEnabled = 1;
+FAutoConsoleVariableRef CVARInputRecording(
+	TEXT("COOP.InputRecording"),
+	InputRecordingEnabled,
+	TEXT("Record the moves and gameplay RPCs of every client to Saved/InputRecordings (applies to the next match)"),
+	ECVF_Default);
+
+static int32 InputRecordingCapacity = 65536;
+FAutoConsoleVariableRef CVARInputRecordingCapacity(
+	TEXT("COOP.InputRecordingCapacity"),
+	InputRecordingCapacity,
+	TEXT("Number of input records buffered before dropping new ones (applies to the next match)"),
+	ECVF_Default);
+
+static int32 InputRecordingMaxMB = 256;
+FAutoConsoleVariableRef CVARInputRecordingMaxMB(
+	TEXT("COOP.InputRecordingMaxMB"),
+	InputRecordingMaxMB,
+	TEXT("Size in MB at which the input recording moves on to a new file, 0 for a single file (applies to the next match)"),
+	ECVF_Default);
+
+static int32 InputRecordingMaxTotalMB = 2048;
+FAutoConsoleVariableRef CVARInputRecordingMaxTotalMB(
+	TEXT("COOP.InputRecordingMaxTotalMB"),
+	InputRecordingMaxTotalMB,
+	TEXT("Disk space in MB all input recordings may take, the oldest files are deleted to stay under it, 0 for no limit (applies to the next match)"),
+	ECVF_Default);
+
+/** Time the writer sleeps between two drains of the buffer */
+static const float InputRecordingDrainInterval = 0.05f;
+
+/** 'CWIR' */
+static const uint32 InputRecordingMagic = 0x52495743;
+static const uint16 InputRecordingVersion = 1;
+
+/** Time the replay keeps running after its last input, for the consequences of that input */
+static const float ReplayTailTime = 2.f;
+
+
+/** Start of every input recording file, followed by the records */
+struct FInputRecordingHeader
+{
+	uint32 Magic;
+	uint16 Version;
+	uint16 RecordSize;
+	/** FDateTime ticks (UTC) of the start of the recording */
+	int64 StartTicks;
+	/** Server world time of the start of the recording */
+	float StartWorldTime;
+	/** Map the recording was made on, null terminated */
+	ANSICHAR MapName[60];
+};
+
+static_assert(sizeof(FInputRecordingHeader) == 80, "Input recording readers expect an 80 byte header");
+
+
+typedef TRecordWriter<FInputRecord> FInputRecordingWriter;
+
+
+/** Game thread only */
+static struct FInputRecordingState
+{
+	TWeakObjectPtr<UWorld> World;
+
+	FInputRecordingWriter* Writer;
+	FRunnableThread* Thread;
+	FString Path;
+	int32 NumDropped;
+
+	TArray<FInputRecord> ReplayRecords;
+	int32 ReplayCursor;
+	/** Replay world time of the start of the recording, and world time of the start of the recording */
+	float ReplayStartTime;
+	float RecordingStartTime;
+	float ReplayEndTime;
+	TMap<int32, TWeakObjectPtr<ASPlayerController>> ReplayPlayers;
+	FDelegateHandle BeginFrameHandle;
+	bool bReplayProfiling;
+} RecordingState;
+
+
+static int32 GetRecordingPlayerId(const AActor* Actor)
+{
+	const AController* Controller = ASPlayerController::FindOwningController(Actor);
+	return Controller && Controller->PlayerState ? Controller->PlayerState->PlayerId : INDEX_NONE;
+}
+
+
+/** Plays inputs as if their player had sent them, on server owned player controllers */
+struct FInputReplay
+{
+	static ASPlayerController* GetPlayer(UWorld* World, int32 PlayerId)
+	{
+		ASPlayerController* Player = RecordingState.ReplayPlayers.FindRef(PlayerId).Get();
+		if (Player)
+		{
+			return Player;
+		}
+
+		AGameModeBase* GameMode = World->GetAuthGameMode();
+		UClass* PlayerClass = GameMode && GameMode->PlayerControllerClass ? *GameMode->PlayerControllerClass : ASPlayerController::StaticClass();
+
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		Player = World->SpawnActor<ASPlayerController>(PlayerClass, FVector::ZeroVector, FRotator::ZeroRotator, SpawnParams);
+		if (Player)
+		{
+			RecordingState.ReplayPlayers.Add(PlayerId, Player);
+		}
+		return Player;
+	}
+
+	static ASCharacter* GetCharacter(UWorld* World, ASPlayerController* Player, bool bRestart)
+	{
+		ASCharacter* Character = Cast<ASCharacter>(Player->GetPawn());
+		AGameModeBase* GameMode = World->GetAuthGameMode();
+		if (Character || !bRestart || !GameMode)
+		{
+			return Character;
+		}
+
+		GameMode->RestartPlayer(Player);
+
+		// Our player controllers count as local, their movement would also run from the pending input every tick
+		Character = Cast<ASCharacter>(Player->GetPawn());
+		if (Character)
+		{
+			Character->GetCharacterMovement()->SetComponentTickEnabled(false);
+		}
+		return Character;
+	}
+
+	static ASWeapon* GetWeapon(ASCharacter* Character, int32 Slot)
+	{
+		const TArray<ASWeapon*>& Inventory = Character->GetInventory();
+		return Inventory.IsValidIndex(Slot) ? Inventory[Slot] : nullptr;
+	}
+
+	static void Dispatch(UWorld* World, const FInputRecord& Record)
+	{
+		ASPlayerController* Player = GetPlayer(World, Record.PlayerId);
+		if (!Player)
+		{
+			return;
+		}
+
+		if ((EInputEvent)Record.Event == EInputEvent::Leave)
+		{
+			if (AGameModeBase* GameMode = World->GetAuthGameMode())
+			{
+				GameMode->Logout(Player);
+			}
+			Player->Destroy();
+			RecordingState.ReplayPlayers.Remove(Record.PlayerId);
+			return;
+		}
+
+		// Clients only send moves once they have a pawn, their respawn request came in between
+		ASCharacter* Character = GetCharacter(World, Player, (EInputEvent)Record.Event == EInputEvent::Move);
+		if (!Character)
+		{
+			return;
+		}
+
+		switch ((EInputEvent)Record.Event)
+		{
+		case EInputEvent::Move:
+		{
+			USCharacterMovementComponent* Movement = Cast<USCharacterMovementComponent>(Character->GetCharacterMovement());
+			if (Movement)
+			{
+				Player->SetControlRotation(Record.Rotation);
+				Movement->ReplayMove(Record.Time, Record.Value, Record.Detail, Record.Vector);
+			}
+			break;
+		}
+		case EInputEvent::Fire:
+			if (ASWeapon* Weapon = GetWeapon(Character, Record.Detail))
+			{
+				FWeaponShot Shot;
+				Shot.ShotTime = Record.Time - RecordingState.RecordingStartTime + RecordingState.ReplayStartTime;
+				Shot.AimRotation = Record.Rotation;
+				Weapon->ServerFire_Implementation(Shot);
+			}
+			break;
+		case EInputEvent::Reload:
+			Character->ServerReload_Implementation();
+			break;
+		case EInputEvent::WeaponReload:
+			if (ASWeapon* Weapon = GetWeapon(Character, Record.Detail))
+			{
+				Weapon->ServerReload_Implementation();
+			}
+			break;
+		case EInputEvent::SwitchWeapon:
+			Character->ServerSwitchWeapon_Implementation(Record.Detail, (uint8)Record.Value);
+			break;
+		case EInputEvent::SpawnInventory:
+			Character->Server_SpawnInventory_Implementation();
+			break;
+		case EInputEvent::SetFireMode:
+			if (ASWeapon* Weapon = GetWeapon(Character, Record.Detail))
+			{
+				Weapon->ServerSetFireMode_Implementation((uint8)Record.Value);
+			}
+			break;
+		default:
+			break;
+		}
+	}
+};
+
+
+static void OnReplayBeginFrame()
+{
+	UWorld* World = RecordingState.World.Get();
+	if (!World)
+	{
+		return;
+	}
+
+	// Inputs are dispatched before the world ticks, like packets received at the start of the frame. Compare against the
+	// time this frame is about to reach, or every input lands one frame after the one it was recorded in.
+	const float RecordingTime = World->TimeSeconds + World->DeltaTimeSeconds - RecordingState.ReplayStartTime + RecordingState.RecordingStartTime;
+	while (RecordingState.ReplayCursor < RecordingState.ReplayRecords.Num() && RecordingState.ReplayRecords[RecordingState.ReplayCursor].WorldTime <= RecordingTime)
+	{
+		FInputReplay::Dispatch(World, RecordingState.ReplayRecords[RecordingState.ReplayCursor++]);
+	}
+
+	if (RecordingState.ReplayCursor == RecordingState.ReplayRecords.Num() && RecordingTime >= RecordingState.ReplayEndTime)
+	{
+		UE_LOG(LogCyberWarfare, Display, TEXT("Replayed %d inputs of %d players over %.1f s"),
+			RecordingState.ReplayRecords.Num(), RecordingState.ReplayPlayers.Num(), World->TimeSeconds - RecordingState.ReplayStartTime);
+
+		InputRecording::Stop(World);
+		FPlatformMisc::RequestExit(false);
+	}
+}
+
+
+static void StartReplay(UWorld* World, const FString& ReplayPath)
+{
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *ReplayPath))
+	{
+		UE_LOG(LogCyberWarfare, Error, TEXT("Could not read input recording %s"), *ReplayPath);
+		return;
+	}
+
+	FInputRecordingHeader Header;
+	if (Bytes.Num() < sizeof(Header))
+	{
+		UE_LOG(LogCyberWarfare, Error, TEXT("%s is not an input recording"), *ReplayPath);
+		return;
+	}
+
+	FMemory::Memcpy(&Header, Bytes.GetData(), sizeof(Header));
+	if (Header.Magic != InputRecordingMagic || Header.Version != InputRecordingVersion || Header.RecordSize != sizeof(FInputRecord))
+	{
+		UE_LOG(LogCyberWarfare, Error, TEXT("%s is not an input recording of this version"), *ReplayPath);
+		return;
+	}
+
+	Header.MapName[ARRAY_COUNT(Header.MapName) - 1] = 0;
+	const FString RecordedMap = ANSI_TO_TCHAR(Header.MapName);
+	if (RecordedMap != FPaths::GetBaseFilename(World->GetMapName()))
+	{
+		UE_LOG(LogCyberWarfare, Warning, TEXT("%s was recorded on %s, replaying on %s"), *ReplayPath, *RecordedMap, *World->GetMapName());
+	}
+
+	// A recording cut short by a crash ends with a partial record
+	const int32 NumRecords = (Bytes.Num() - sizeof(Header)) / sizeof(FInputRecord);
+	RecordingState.ReplayRecords.SetNumUninitialized(NumRecords);
+	FMemory::Memcpy(RecordingState.ReplayRecords.GetData(), Bytes.GetData() + sizeof(Header), NumRecords * sizeof(FInputRecord));
+
+	RecordingState.World = World;
+	RecordingState.Path = ReplayPath;
+	RecordingState.ReplayCursor = 0;
+	RecordingState.ReplayStartTime = World->TimeSeconds;
+	RecordingState.RecordingStartTime = Header.StartWorldTime;
+	RecordingState.ReplayEndTime = (NumRecords > 0 ? RecordingState.ReplayRecords.Last().WorldTime : Header.StartWorldTime) + ReplayTailTime;
+	RecordingState.ReplayPlayers.Reset();
+	RecordingState.BeginFrameHandle = FCoreDelegates::OnBeginFrame.AddStatic(&OnReplayBeginFrame);
+
+	RecordingState.bReplayProfiling = FParse::Param(FCommandLine::Get(), TEXT("InputReplayProfile"));
+	if (RecordingState.bReplayProfiling)
+	{
+		GEngine->Exec(World, TEXT("stat startfile"));
+	}
+
+	UE_LOG(LogCyberWarfare, Display, TEXT("Replaying %d inputs from %s"), NumRecords, *ReplayPath);
+}
+
+
+/** Deletes the oldest recordings until they take at most MaxTotalSize along with a new file of ReservedSize (0: no limit) */
+static void PruneRecordings(const FString& Directory, int64 MaxTotalSize, int64 ReservedSize)
+{
+	if (MaxTotalSize <= 0)
+	{
+		return;
+	}
+
+	struct FRecordingFile
+	{
+		FString Path;
+		FDateTime TimeStamp;
+		int64 Size;
+	};
+
+	IFileManager& FileManager = IFileManager::Get();
+	TArray<FString> Names;
+	FileManager.FindFiles(Names, *(Directory / TEXT("InputRecording-*.bin")), true, false);
+
+	TArray<FRecordingFile> Files;
+	int64 TotalSize = ReservedSize;
+	for (const FString& Name : Names)
+	{
+		FRecordingFile& File = Files[Files.AddDefaulted()];
+		File.Path = Directory / Name;
+		File.TimeStamp = FileManager.GetTimeStamp(*File.Path);
+		File.Size = FMath::Max<int64>(FileManager.FileSize(*File.Path), 0);
+		TotalSize += File.Size;
+	}
+
+	Files.Sort([](const FRecordingFile& A, const FRecordingFile& B) { return A.TimeStamp < B.TimeStamp; });
+
+	for (const FRecordingFile& File : Files)
+	{
+		if (TotalSize <= MaxTotalSize)
+		{
+			break;
+		}
+
+		if (FileManager.Delete(*File.Path))
+		{
+			UE_LOG(LogCyberWarfare, Log, TEXT("Deleted old input recording %s"), *File.Path);
+			TotalSize -= File.Size;
+		}
+	}
+}
+
+
+/** Creates a recording file and writes its header, every file of a recording can be replayed on its own */
+static FArchive* OpenRecordingFile(const FString& Path, const FString& MapName, float StartWorldTime)
+{
+	FArchive* File = IFileManager::Get().CreateFileWriter(*Path);
+	if (!File)
+	{
+		UE_LOG(LogCyberWarfare, Warning, TEXT("Could not open input recording %s"), *Path);
+		return nullptr;
+	}
+
+	FInputRecordingHeader Header;
+	FMemory::Memzero(Header);
+	Header.Magic = InputRecordingMagic;
+	Header.Version = InputRecordingVersion;
+	Header.RecordSize = sizeof(FInputRecord);
+	Header.StartTicks = FDateTime::UtcNow().GetTicks();
+	Header.StartWorldTime = StartWorldTime;
+	FCStringAnsi::Strncpy(Header.MapName, TCHAR_TO_ANSI(*MapName), ARRAY_COUNT(Header.MapName));
+	File->Serialize(&Header, sizeof(Header));
+
+	return File;
+}
+
+
+void InputRecording::Start(UWorld* World)
+{
+	if (!World || RecordingState.World.IsValid())
+	{
+		return;
+	}
+
+	FString ReplayPath;
+	if (FParse::Value(FCommandLine::Get(), TEXT("InputReplay="), ReplayPath))
+	{
+		StartReplay(World, ReplayPath);
+		return;
+	}
+
+	// Only remote players send inputs
+	const ENetMode NetMode = World->GetNetMode();
+	if (InputRecordingEnabled <= 0 || NetMode == NM_Standalone || NetMode == NM_Client)
+	{
+		return;
+	}
+
+	const FString MapName = FPaths::GetBaseFilename(World->GetMapName());
+	const FString Directory = FPaths::ProjectSavedDir() / TEXT("InputRecordings");
+	const FString BasePath = Directory / FString::Printf(TEXT("InputRecording-%s-%s"), *MapName, *FDateTime::Now().ToString());
+	const int64 MaxFileSize = (int64)FMath::Max(InputRecordingMaxMB, 0) * 1024 * 1024;
+	const int64 MaxTotalSize = (int64)FMath::Max(InputRecordingMaxTotalMB, 0) * 1024 * 1024;
+
+	PruneRecordings(Directory, MaxTotalSize, MaxFileSize);
+
+	FArchive* File = OpenRecordingFile(BasePath + TEXT(".bin"), MapName, World->TimeSeconds);
+	if (!File)
+	{
+		return;
+	}
+
+	RecordingState.World = World;
+	RecordingState.Path = BasePath + TEXT(".bin");
+	RecordingState.NumDropped = 0;
+	RecordingState.Writer = new FInputRecordingWriter(File, FMath::Max(InputRecordingCapacity, 1024), InputRecordingDrainInterval);
+
+	// About 1 GB of moves an hour: the writer thread moves on to the next file and makes room for it, the game thread never
+	// waits for either. Each file starts at the server time of its first record.
+	if (MaxFileSize > 0)
+	{
+		RecordingState.Writer->SetRotation(MaxFileSize, [Directory, BasePath, MapName, MaxFileSize, MaxTotalSize](int32 FileIndex, const FInputRecord& FirstRecord)
+		{
+			PruneRecordings(Directory, MaxTotalSize, MaxFileSize);
+			return OpenRecordingFile(FString::Printf(TEXT("%s-%d.bin"), *BasePath, FileIndex), MapName, FirstRecord.WorldTime);
+		});
+	}
+
+	RecordingState.Thread = FRunnableThread::Create(RecordingState.Writer, TEXT("InputRecordingWriter"), 0, TPri_BelowNormal);
+}
+
+
+void InputRecording::Stop(UWorld* World)
+{
+	if (!World || RecordingState.World.Get() != World)
+	{
+		return;
+	}
+
+	RecordingState.World.Reset();
+
+	if (RecordingState.BeginFrameHandle.IsValid())
+	{
+		FCoreDelegates::OnBeginFrame.Remove(RecordingState.BeginFrameHandle);
+		RecordingState.BeginFrameHandle.Reset();
+		RecordingState.ReplayRecords.Empty();
+		RecordingState.ReplayPlayers.Reset();
+
+		if (RecordingState.bReplayProfiling)
+		{
+			GEngine->Exec(World, TEXT("stat stopfile"));
+		}
+		return;
+	}
+
+	// Kill asks the writer to stop and waits for its last drain
+	RecordingState.Thread->Kill(true);
+	delete RecordingState.Thread;
+	RecordingState.Thread = nullptr;
+
+	UE_LOG(LogCyberWarfare, Log, TEXT("Input recording %s: %d records in %d files, %d dropped"), *RecordingState.Path, RecordingState.Writer->NumWritten.GetValue(),
+		RecordingState.Writer->NumFiles.GetValue(), RecordingState.NumDropped + RecordingState.Writer->NumLost.GetValue());
+
+	delete RecordingState.Writer;
+	RecordingState.Writer = nullptr;
+}
+
+
+void InputRecording::Record(EInputEvent Event, const AActor* OwnedActor, float Time, float Value, const FVector& Vector, const FRotator& Rotation, uint8 Detail)
+{
+	FInputRecordingWriter* Writer = RecordingState.Writer;
+	if (!Writer || !IsInGameThread())
+	{
+		return;
+	}
+
+	FInputRecord Record;
+	Record.WorldTime = RecordingState.World.IsValid() ? RecordingState.World->TimeSeconds : 0.f;
+	Record.Event = (uint8)Event;
+	Record.Detail = Detail;
+	Record.Reserved = 0;
+	Record.PlayerId = GetRecordingPlayerId(OwnedActor);
+	Record.Time = Time;
+	Record.Value = Value;
+	Record.Vector = Vector;
+	Record.Rotation = Rotation;
+
+	// Never wait for the writer, a full buffer loses the record
+	if (!Writer->Queue.Enqueue(Record))
+	{
+		RecordingState.NumDropped++;
+	}
+}
+
+
+static FAutoConsoleCommandWithWorldAndArgs InputRecordingCommand(
+	TEXT("COOP.InputRecordingStats"),
+	TEXT("Logs the number of input records written and dropped by the current recording, or the progress of the replay"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (RecordingState.BeginFrameHandle.IsValid())
+		{
+			UE_LOG(LogCyberWarfare, Display, TEXT("Replaying %s: %d of %d inputs, %d players"),
+				*RecordingState.Path, RecordingState.ReplayCursor, RecordingState.ReplayRecords.Num(), RecordingState.ReplayPlayers.Num());
+			return;
+		}
+
+		if (!RecordingState.Writer)
+		{
+			UE_LOG(LogCyberWarfare, Display, TEXT("No input recording open"));
+			return;
+		}
+
+		UE_LOG(LogCyberWarfare, Display, TEXT("Input recording %s: %d records written in %d files, %d dropped"), *RecordingState.Path,
+			RecordingState.Writer->NumWritten.GetValue(), RecordingState.Writer->NumFiles.GetValue(), RecordingState.NumDropped + RecordingState.Writer->NumLost.GetValue());
+	}));
@@ -0,0 +1,144 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CoreMinimal.h"
+#include "CyberWarfare.h"
+#include "SCharacter.h"
+#include "SWeapon.h"
+#include "EngineUtils.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerState.h"
+#include "Particles/ParticleSystemComponent.h"
+#include "Components/AudioComponent.h"
+#include "Serialization/ArchiveCountMem.h"
+
+
+/** Memory categories of the report, same split as our LLM tags */
+enum class EMemReportCategory : uint8
+{
+	Character,
+	Weapon,
+	Inventory,
+	Effects,
+	Projectiles,
+	Num
+};
+
+static const TCHAR* MemReportCategoryNames[] = { TEXT("Character"), TEXT("Weapon"), TEXT("Inventory"), TEXT("Effects"), TEXT("Projectiles") };
+
+
+/** Resident memory of one object: its properties and allocations, plus the resources it owns exclusively */
+static SIZE_T GetObjectMemory(UObject* Object)
+{
+	FArchiveCountMem CountMem(Object);
+	return CountMem.GetMax() + Object->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+}
+
+
+/** Adds an actor and its components, cosmetic components are counted as effects */
+static void AddActorMemory(AActor* Actor, EMemReportCategory Category, SIZE_T* Sizes)
+{
+	if (!Actor)
+	{
+		return;
+	}
+
+	Sizes[(int32)Category] += GetObjectMemory(Actor);
+
+	TInlineComponentArray<UActorComponent*> Components;
+	Actor->GetComponents(Components);
+	for (UActorComponent* Component : Components)
+	{
+		const bool bEffect = Component->IsA<UParticleSystemComponent>() || Component->IsA<UAudioComponent>();
+		Sizes[(int32)(bEffect ? EMemReportCategory::Effects : Category)] += GetObjectMemory(Component);
+	}
+}
+
+
+static FString FormatMemReportRow(const FString& Name, const SIZE_T* Sizes)
+{
+	SIZE_T Total = 0;
+	FString Row = FString::Printf(TEXT("%-24s"), *Name.Left(24));
+	for (int32 Category = 0; Category < (int32)EMemReportCategory::Num; Category++)
+	{
+		Row += FString::Printf(TEXT(" %12.1f"), Sizes[Category] / 1024.f);
+		Total += Sizes[Category];
+	}
+	Row += FString::Printf(TEXT(" %12.1f"), Total / 1024.f);
+	return Row;
+}
+
+
+static FAutoConsoleCommandWithWorldAndArgs MemReportCommand(
+	TEXT("COOP.MemReport"),
+	TEXT("Logs the resident memory of every player's character, weapons, inventory, effects and projectiles (KB)"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		FString Header = FString::Printf(TEXT("%-24s"), TEXT("Player"));
+		for (const TCHAR* CategoryName : MemReportCategoryNames)
+		{
+			Header += FString::Printf(TEXT(" %12s"), CategoryName);
+		}
+		Header += FString::Printf(TEXT(" %12s"), TEXT("Total"));
+		UE_LOG(LogCyberWarfare, Display, TEXT("%s"), *Header);
+
+		SIZE_T Totals[(int32)EMemReportCategory::Num] = {};
+		SIZE_T Unowned[(int32)EMemReportCategory::Num] = {};
+		int32 NumCharacters = 0;
+
+		for (TActorIterator<ASCharacter> It(World); It; ++It)
+		{
+			ASCharacter* Character = *It;
+			SIZE_T Sizes[(int32)EMemReportCategory::Num] = {};
+
+			AddActorMemory(Character, EMemReportCategory::Character, Sizes);
+
+			ASWeapon* CurrentWeapon = Character->GetCurrentWeapon();
+			for (ASWeapon* Weapon : Character->GetInventory())
+			{
+				AddActorMemory(Weapon, Weapon == CurrentWeapon ? EMemReportCategory::Weapon : EMemReportCategory::Inventory, Sizes);
+			}
+
+			// Pooled characters and corpses have no player
+			const APlayerState* PlayerState = Character->PlayerState;
+			const FString Name = PlayerState ? PlayerState->GetPlayerName() : (Character->IsDead() ? TEXT("(corpse)") : TEXT("(pool)"));
+			UE_LOG(LogCyberWarfare, Display, TEXT("%s"), *FormatMemReportRow(Name, Sizes));
+
+			for (int32 Category = 0; Category < (int32)EMemReportCategory::Num; Category++)
+			{
+				Totals[Category] += Sizes[Category];
+			}
+			NumCharacters++;
+		}
+
+		// Projectiles are attributed to their instigator's row in the totals only, effects spawned in the world have no owner
+		for (TActorIterator<AActor> It(World); It; ++It)
+		{
+			AActor* Actor = *It;
+			if (Actor->IsA<ASCharacter>() || Actor->IsA<ASWeapon>())
+			{
+				continue;
+			}
+
+			if (Cast<ASCharacter>(Actor->Instigator))
+			{
+				AddActorMemory(Actor, EMemReportCategory::Projectiles, Totals);
+			}
+			else
+			{
+				TInlineComponentArray<UParticleSystemComponent*> Emitters;
+				Actor->GetComponents(Emitters);
+				for (UParticleSystemComponent* Emitter : Emitters)
+				{
+					Unowned[(int32)EMemReportCategory::Effects] += GetObjectMemory(Emitter);
+				}
+			}
+		}
+
+		UE_LOG(LogCyberWarfare, Display, TEXT("%s"), *FormatMemReportRow(TEXT("(world effects)"), Unowned));
+
+		for (int32 Category = 0; Category < (int32)EMemReportCategory::Num; Category++)
+		{
+			Totals[Category] += Unowned[Category];
+		}
+		UE_LOG(LogCyberWarfare, Display, TEXT("%s"), *FormatMemReportRow(FString::Printf(TEXT("Total (%d characters)"), NumCharacters), Totals));
+	}));
@@ -0,0 +1,65 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SNetHarness.h"
+#include "CyberWarfare.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+
+bool NetHarness::IsEnabled()
+{
+	static const bool bEnabled = FParse::Param(FCommandLine::Get(), TEXT("NetHarness"));
+	return bEnabled;
+}
+
+
+bool NetHarness::IsBot()
+{
+	static const bool bBot = FParse::Param(FCommandLine::Get(), TEXT("NetHarnessBot"));
+	return bBot;
+}
+
+
+float NetHarness::GetDuration()
+{
+	float Duration = 60.f;
+	FParse::Value(FCommandLine::Get(), TEXT("NetHarnessDuration="), Duration);
+	return Duration;
+}
+
+
+int32 NetHarness::GetSeed()
+{
+	int32 Seed = 0;
+	FParse::Value(FCommandLine::Get(), TEXT("NetHarnessSeed="), Seed);
+	return Seed;
+}
+
+
+int32 NetHarness::GetRateLimit()
+{
+	int32 RateLimit = 0;
+	FParse::Value(FCommandLine::Get(), TEXT("NetHarnessRate="), RateLimit);
+	return FMath::Max(RateLimit, 0);
+}
+
+
+void NetHarness::WriteReport(const FString& FileName, const FString& Json)
+{
+	FString OutputDir;
+	if (!FParse::Value(FCommandLine::Get(), TEXT("NetHarnessOutput="), OutputDir))
+	{
+		OutputDir = FPaths::ProjectSavedDir() / TEXT("NetHarness");
+	}
+
+	const FString Path = OutputDir / FileName;
+	if (FFileHelper::SaveStringToFile(Json, *Path))
+	{
+		UE_LOG(LogCyberWarfare, Display, TEXT("Net harness report written to %s"), *Path);
+	}
+	else
+	{
+		UE_LOG(LogCyberWarfare, Error, TEXT("Could not write net harness report %s"), *Path);
+	}
+}
@@ -0,0 +1,94 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SNetPriority.h"
+#include "HAL/IConsoleManager.h"
+
+
+static int32 NetPrioritization = 1;
+FAutoConsoleVariableRef CVARNetPrioritization(
+	TEXT("COOP.NetPrioritization"),
+	NetPrioritization,
+	TEXT("Prioritize characters and weapons per viewer by distance, view angle, firing and damage dealt to the viewer"),
+	ECVF_Default);
+
+static float NetPriorityMaxDistance = 10000.f;
+FAutoConsoleVariableRef CVARNetPriorityMaxDistance(
+	TEXT("COOP.NetPriorityMaxDistance"),
+	NetPriorityMaxDistance,
+	TEXT("Distance at which the distance factor of the net priority reaches its minimum"),
+	ECVF_Default);
+
+static float NetPriorityBehindScale = 0.3f;
+FAutoConsoleVariableRef CVARNetPriorityBehindScale(
+	TEXT("COOP.NetPriorityBehindScale"),
+	NetPriorityBehindScale,
+	TEXT("Net priority factor of an actor right behind the viewer"),
+	ECVF_Default);
+
+static float NetPriorityFiringScale = 2.f;
+FAutoConsoleVariableRef CVARNetPriorityFiringScale(
+	TEXT("COOP.NetPriorityFiringScale"),
+	NetPriorityFiringScale,
+	TEXT("Net priority factor of an actor that is shooting"),
+	ECVF_Default);
+
+static float NetPriorityThreatScale = 4.f;
+FAutoConsoleVariableRef CVARNetPriorityThreatScale(
+	TEXT("COOP.NetPriorityThreatScale"),
+	NetPriorityThreatScale,
+	TEXT("Net priority factor of an actor that recently damaged the viewer"),
+	ECVF_Default);
+
+/** Cosine of the half angle of the cone in which actors get the full view factor */
+static const float ViewConeCos = 0.7f;
+
+/** Distance factor of actors at COOP.NetPriorityMaxDistance or further */
+static const float MinDistanceScale = 0.2f;
+
+
+bool NetPriority::IsEnabled()
+{
+	return NetPrioritization > 0;
+}
+
+
+float NetPriority::GetViewerScale(const FVector& ActorLocation, const FVector& ViewPos, const FVector& ViewDir, bool bFiring, bool bDamagedViewer)
+{
+	const FVector ToActor = ActorLocation - ViewPos;
+	const float Distance = ToActor.Size();
+
+	const float DistanceAlpha = FMath::Clamp(Distance / FMath::Max(NetPriorityMaxDistance, 1.f), 0.f, 1.f);
+	const float DistanceScale = FMath::Lerp(1.f, MinDistanceScale, DistanceAlpha);
+
+	// Full factor inside the view cone, down to the behind factor right behind the viewer
+	float ViewScale = 1.f;
+	if (Distance > KINDA_SMALL_NUMBER)
+	{
+		const float ViewCos = FVector::DotProduct(ToActor / Distance, ViewDir);
+		if (ViewCos < ViewConeCos)
+		{
+			ViewScale = FMath::Lerp(NetPriorityBehindScale, 1.f, (ViewCos + 1.f) / (ViewConeCos + 1.f));
+		}
+	}
+
+	float Scale = DistanceScale * ViewScale;
+
+	if (bFiring)
+	{
+		Scale *= NetPriorityFiringScale;
+	}
+
+	// Whoever is hurting the viewer matters even when out of sight
+	if (bDamagedViewer)
+	{
+		Scale = FMath::Max(Scale, DistanceScale) * NetPriorityThreatScale;
+	}
+
+	return Scale;
+}
+
+
+bool NetPriority::IsInViewCone(const FVector& ActorLocation, const FVector& ViewPos, const FVector& ViewDir)
+{
+	return FVector::DotProduct((ActorLocation - ViewPos).GetSafeNormal(), ViewDir) >= ViewConeCos;
+}
@@ -0,0 +1,176 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SPlayerController.h"
+#include "Public/Components/SNetClockComponent.h"
+#include "Public/Components/SShotLatencyComponent.h"
+#include "Public/Components/SNetHarnessBotComponent.h"
+#include "SNetHarness.h"
+#include "CyberWarfare.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "SHitchDetector.h"
+#include "SStartupTiming.h"
+
+
+static int32 RpcRateLimits = 1;
+FAutoConsoleVariableRef CVARRpcRateLimits(
+	TEXT("COOP.RpcRateLimits"),
+	RpcRateLimits,
+	TEXT("Drop gameplay RPCs a connection sends faster than gameplay allows"),
+	ECVF_Default);
+
+static float RpcRateTolerance = 1.5f;
+FAutoConsoleVariableRef CVARRpcRateTolerance(
+	TEXT("COOP.RpcRateTolerance"),
+	RpcRateTolerance,
+	TEXT("Multiplier applied to every RPC rate limit, slack for network jitter"),
+	ECVF_Default);
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Dropped RPCs"), STAT_DroppedRpcs, STATGROUP_CyberWarfare);
+
+
+static FAutoConsoleCommandWithWorldAndArgs RpcDropsCommand(
+	TEXT("COOP.RpcDrops"),
+	TEXT("Logs the number of rate limited RPCs dropped for every player"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		for (TActorIterator<ASPlayerController> It(World); It; ++It)
+		{
+			FString Drops;
+			for (int32 Rpc = 0; Rpc < (int32)EServerRpc::Num; Rpc++)
+			{
+				Drops += FString::Printf(TEXT(" %s=%d"), ASPlayerController::GetRpcName((EServerRpc)Rpc), It->GetNumDroppedRpcs((EServerRpc)Rpc));
+			}
+			UE_LOG(LogCyberWarfare, Display, TEXT("%s:%s"), *It->GetName(), *Drops);
+		}
+	}));
+
+
+bool FRpcTokenBucket::Consume(float Time, float TokensPerSecond, float Burst)
+{
+	// A bucket starts full
+	if (LastRefillTime < 0.f)
+	{
+		Tokens = Burst;
+	}
+	else
+	{
+		Tokens = FMath::Min(Tokens + (Time - LastRefillTime) * TokensPerSecond, Burst);
+	}
+	LastRefillTime = Time;
+
+	if (Tokens < 1.f)
+	{
+		return false;
+	}
+
+	Tokens -= 1.f;
+	return true;
+}
+
+
+ASPlayerController::ASPlayerController()
+{
+	NetClockComp = CreateDefaultSubobject<USNetClockComponent>(TEXT("NetClockComp"));
+	ShotLatencyComp = CreateDefaultSubobject<USShotLatencyComponent>(TEXT("ShotLatencyComp"));
+
+	FMemory::Memzero(DroppedRpcs);
+}
+
+
+void ASPlayerController::BeginPlay()
+{
+	Super::BeginPlay();
+
+	StartupTiming::Mark(EStartupMilestone::FirstBeginPlay);
+
+	if (IsLocalController() && NetHarness::IsBot())
+	{
+		USNetHarnessBotComponent* NetHarnessBot = NewObject<USNetHarnessBotComponent>(this, TEXT("NetHarnessBot"));
+		NetHarnessBot->RegisterComponent();
+	}
+}
+
+
+USNetClockComponent* ASPlayerController::GetNetClock() const
+{
+	return NetClockComp;
+}
+
+
+USShotLatencyComponent* ASPlayerController::GetShotLatency() const
+{
+	return ShotLatencyComp;
+}
+
+
+bool ASPlayerController::ConsumeRpcToken(EServerRpc Rpc, float CallsPerSecond, float Burst)
+{
+	HitchDetector::CountRpc(Rpc);
+
+	if (RpcRateLimits <= 0)
+	{
+		return true;
+	}
+
+	const float Tolerance = FMath::Max(RpcRateTolerance, 1.f);
+	if (RpcBuckets[(int32)Rpc].Consume(GetWorld()->TimeSeconds, CallsPerSecond * Tolerance, FMath::Max(Burst * Tolerance, 1.f)))
+	{
+		return true;
+	}
+
+	DroppedRpcs[(int32)Rpc]++;
+	INC_DWORD_STAT(STAT_DroppedRpcs);
+	UE_LOG(LogCyberWarfare, Verbose, TEXT("%s: dropped %s"), *GetName(), GetRpcName(Rpc));
+	return false;
+}
+
+
+AController* ASPlayerController::FindOwningController(const AActor* OwnedActor)
+{
+	// Weapons are owned by characters, characters by their controller
+	for (AActor* Actor = const_cast<AActor*>(OwnedActor); Actor; Actor = Actor->GetOwner())
+	{
+		AController* Controller = Cast<AController>(Actor);
+		if (Controller)
+		{
+			return Controller;
+		}
+	}
+
+	return nullptr;
+}
+
+
+ASPlayerController* ASPlayerController::FindOwningPlayer(const AActor* OwnedActor)
+{
+	return Cast<ASPlayerController>(FindOwningController(OwnedActor));
+}
+
+
+bool ASPlayerController::ConsumeRpcToken(AActor* OwnedActor, EServerRpc Rpc, float CallsPerSecond, float Burst)
+{
+	ASPlayerController* PlayerController = FindOwningPlayer(OwnedActor);
+	return PlayerController ? PlayerController->ConsumeRpcToken(Rpc, CallsPerSecond, Burst) : true;
+}
+
+
+int32 ASPlayerController::GetNumDroppedRpcs(EServerRpc Rpc) const
+{
+	return DroppedRpcs[(int32)Rpc];
+}
+
+
+const TCHAR* ASPlayerController::GetRpcName(EServerRpc Rpc)
+{
+	switch (Rpc)
+	{
+	case EServerRpc::Fire:				return TEXT("Fire");
+	case EServerRpc::Reload:			return TEXT("Reload");
+	case EServerRpc::WeaponReload:		return TEXT("WeaponReload");
+	case EServerRpc::SwitchWeapon:		return TEXT("SwitchWeapon");
+	case EServerRpc::SpawnInventory:	return TEXT("SpawnInventory");
+	case EServerRpc::SetFireMode:		return TEXT("SetFireMode");
+	default:							return TEXT("Unknown");
+	}
+}
@@ -1,24 +1,44 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 #include "SProjectileWeapon.h"
+#include "CyberWarfare.h"
+#include "SCharacter.h"
+#include "SHitchDetector.h"
+#include "SGameplayRules.h"
 
 
-void ASProjectileWeapon::Fire()
+bool ASProjectileWeapon::Fire(const FWeaponShot& Shot)
 {
+	COOP_LLM_SCOPE(Projectiles);
+	HitchDetector::FScopedCounter HitchCounter(EGameplayCounter::Fire);
 
 	AActor* MyOwner = GetOwner();
-	if (MyOwner && ProjectileClass)
+	if (MyOwner && ProjectileClass && GameplayRules::ConsumeRound(ClipCurrentSize))
 	{
-		FVector EyeLocation;
-		FRotator EyeRotation;
-		MyOwner->GetActorEyesViewPoint(EyeLocation, EyeRotation);
+		NotifyNetActivity();
 
 		FVector MuzzleLocation = MeshComp->GetSocketLocation(MuzzleSocketName);
 		FRotator MuzzleRotation = MeshComp->GetSocketRotation(MuzzleSocketName);
 
 		FActorSpawnParameters SpawnParams;
 		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		SpawnParams.Instigator = Cast<APawn>(MyOwner);
 
-		GetWorld()->SpawnActor<AActor>(ProjectileClass, MuzzleLocation, EyeRotation, SpawnParams);
+		HitchDetector::Count(EGameplayCounter::Spawn);
+		GetWorld()->SpawnActor<AActor>(ProjectileClass, MuzzleLocation, Shot.AimRotation, SpawnParams);
+
+		LastFireTime = Shot.ShotTime;
+
+		if (ClipIsEmpty())
+		{
+			ASCharacter* MyCharacter = Cast<ASCharacter>(MyOwner);
+			if (MyCharacter)
+			{
+				MyCharacter->Reload();
+			}
+		}
+		return true;
 	}
+
+	return false;
 }
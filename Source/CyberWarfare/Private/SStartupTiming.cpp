@@ -0,0 +1,221 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SStartupTiming.h"
+#include "CyberWarfare.h"
+#include "CoreGlobals.h"
+#include "Misc/App.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UObject/UObjectGlobals.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformMisc.h"
+#include "Engine/World.h"
+
+
+static const int32 FirstMapMilestone = (int32)EStartupMilestone::MapLoadStarted;
+
+
+struct FMapLoadTiming
+{
+	FString MapName;
+	double Times[(int32)EStartupMilestone::Num];
+};
+
+
+/** Game thread only */
+static struct FStartupTimingState
+{
+	double ProcessTimes[FirstMapMilestone];
+	TArray<FMapLoadTiming> MapLoads;
+	bool bReported;
+} TimingState;
+
+
+static const TCHAR* GetMilestoneName(EStartupMilestone Milestone)
+{
+	switch (Milestone)
+	{
+	case EStartupMilestone::ModuleStartup:		return TEXT("ModuleStartup");
+	case EStartupMilestone::CharacterDefaults:	return TEXT("CharacterDefaults");
+	case EStartupMilestone::WeaponDefaults:		return TEXT("WeaponDefaults");
+	case EStartupMilestone::EngineInitialized:	return TEXT("EngineInitialized");
+	case EStartupMilestone::MapLoadStarted:		return TEXT("MapLoadStarted");
+	case EStartupMilestone::MapLoaded:			return TEXT("MapLoaded");
+	case EStartupMilestone::FirstBeginPlay:		return TEXT("FirstBeginPlay");
+	case EStartupMilestone::InventorySpawned:	return TEXT("InventorySpawned");
+	case EStartupMilestone::FirstPlayableFrame:	return TEXT("FirstPlayableFrame");
+	default:									return TEXT("Unknown");
+	}
+}
+
+
+/** Seconds since the process started, never 0 so that 0 can mean not reached */
+static double GetProcessTime()
+{
+	return FMath::Max(FPlatformTime::Seconds() - GStartTime, 1.e-6);
+}
+
+
+static FString FormatTime(double Time)
+{
+	return Time > 0.0 ? FString::Printf(TEXT("%.4f"), Time) : TEXT("null");
+}
+
+
+static FString GetReportPath()
+{
+	FString Path;
+	if (!FParse::Value(FCommandLine::Get(), TEXT("StartupTimingOutput="), Path))
+	{
+		Path = FPaths::ProjectSavedDir() / TEXT("StartupTiming") / (IsRunningDedicatedServer() ? TEXT("Startup-Server.json") : TEXT("Startup-Client.json"));
+	}
+	return Path;
+}
+
+
+static void WriteReport()
+{
+	FString Json = FString::Printf(TEXT("{\n  \"mode\": \"%s\",\n  \"null_rhi\": %s,\n  \"process\": {"),
+		IsRunningDedicatedServer() ? TEXT("server") : TEXT("client"), FApp::CanEverRender() ? TEXT("false") : TEXT("true"));
+
+	for (int32 Milestone = 0; Milestone < FirstMapMilestone; Milestone++)
+	{
+		Json += FString::Printf(TEXT("%s\n    \"%s\": %s"), Milestone > 0 ? TEXT(",") : TEXT(""),
+			GetMilestoneName((EStartupMilestone)Milestone), *FormatTime(TimingState.ProcessTimes[Milestone]));
+	}
+
+	Json += TEXT("\n  },\n  \"map_loads\": [");
+	for (int32 Index = 0; Index < TimingState.MapLoads.Num(); Index++)
+	{
+		const FMapLoadTiming& MapLoad = TimingState.MapLoads[Index];
+		Json += FString::Printf(TEXT("%s\n    { \"map\": \"%s\""), Index > 0 ? TEXT(",") : TEXT(""), *MapLoad.MapName.ReplaceCharWithEscapedChar());
+
+		for (int32 Milestone = FirstMapMilestone; Milestone < (int32)EStartupMilestone::Num; Milestone++)
+		{
+			Json += FString::Printf(TEXT(", \"%s\": %s"), GetMilestoneName((EStartupMilestone)Milestone), *FormatTime(MapLoad.Times[Milestone]));
+		}
+
+		const double LoadStarted = MapLoad.Times[(int32)EStartupMilestone::MapLoadStarted];
+		const double Playable = MapLoad.Times[(int32)EStartupMilestone::FirstPlayableFrame];
+		Json += FString::Printf(TEXT(", \"load_to_playable\": %s }"), *FormatTime(Playable > 0.0 ? Playable - LoadStarted : 0.0));
+	}
+	Json += TEXT("\n  ]\n}\n");
+
+	const FString Path = GetReportPath();
+	if (FFileHelper::SaveStringToFile(Json, *Path))
+	{
+		UE_LOG(LogCyberWarfare, Display, TEXT("Startup timing written to %s"), *Path);
+	}
+	else
+	{
+		UE_LOG(LogCyberWarfare, Error, TEXT("Could not write startup timing %s"), *Path);
+	}
+}
+
+
+static void OnPreLoadMap(const FString& MapName)
+{
+	FMapLoadTiming& MapLoad = TimingState.MapLoads[TimingState.MapLoads.AddZeroed()];
+	MapLoad.MapName = MapName;
+	MapLoad.Times[(int32)EStartupMilestone::MapLoadStarted] = GetProcessTime();
+}
+
+
+static void OnPostLoadMap(UWorld* World)
+{
+	StartupTiming::Mark(EStartupMilestone::MapLoaded);
+}
+
+
+static void OnEngineInitialized()
+{
+	StartupTiming::Mark(EStartupMilestone::EngineInitialized);
+}
+
+
+/** The frame that spawned the inventory is over, the next one is playable */
+static void OnEndFrame()
+{
+	if (TimingState.MapLoads.Num() == 0)
+	{
+		return;
+	}
+
+	const FMapLoadTiming& MapLoad = TimingState.MapLoads.Last();
+	if (MapLoad.Times[(int32)EStartupMilestone::InventorySpawned] <= 0.0 || MapLoad.Times[(int32)EStartupMilestone::FirstPlayableFrame] > 0.0)
+	{
+		return;
+	}
+
+	StartupTiming::Mark(EStartupMilestone::FirstPlayableFrame);
+
+	UE_LOG(LogCyberWarfare, Log, TEXT("%s playable %.3f s after its load started, %.3f s after the process started"), *MapLoad.MapName,
+		MapLoad.Times[(int32)EStartupMilestone::FirstPlayableFrame] - MapLoad.Times[(int32)EStartupMilestone::MapLoadStarted],
+		MapLoad.Times[(int32)EStartupMilestone::FirstPlayableFrame]);
+
+	if (FParse::Param(FCommandLine::Get(), TEXT("StartupTiming")))
+	{
+		WriteReport();
+
+		if (!TimingState.bReported && FParse::Param(FCommandLine::Get(), TEXT("StartupTimingExit")))
+		{
+			FPlatformMisc::RequestExit(false);
+		}
+		TimingState.bReported = true;
+	}
+}
+
+
+void StartupTiming::Start()
+{
+	Mark(EStartupMilestone::ModuleStartup);
+
+	FCoreUObjectDelegates::PreLoadMap.AddStatic(&OnPreLoadMap);
+	FCoreUObjectDelegates::PostLoadMapWithWorld.AddStatic(&OnPostLoadMap);
+	FCoreDelegates::OnFEngineLoopInitComplete.AddStatic(&OnEngineInitialized);
+	FCoreDelegates::OnEndFrame.AddStatic(&OnEndFrame);
+}
+
+
+void StartupTiming::Mark(EStartupMilestone Milestone)
+{
+	double* Time = nullptr;
+	if ((int32)Milestone < FirstMapMilestone)
+	{
+		Time = &TimingState.ProcessTimes[(int32)Milestone];
+	}
+	else if (TimingState.MapLoads.Num() > 0)
+	{
+		// Play in editor does not load maps, nothing to attribute to
+		Time = &TimingState.MapLoads.Last().Times[(int32)Milestone];
+	}
+
+	if (Time && *Time <= 0.0)
+	{
+		*Time = GetProcessTime();
+	}
+}
+
+
+static FAutoConsoleCommandWithWorldAndArgs StartupTimingCommand(
+	TEXT("COOP.StartupTiming"),
+	TEXT("Logs the startup milestones of the process and of every map load"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		for (int32 Milestone = 0; Milestone < FirstMapMilestone; Milestone++)
+		{
+			UE_LOG(LogCyberWarfare, Display, TEXT("%s: %s s"), GetMilestoneName((EStartupMilestone)Milestone), *FormatTime(TimingState.ProcessTimes[Milestone]));
+		}
+
+		for (const FMapLoadTiming& MapLoad : TimingState.MapLoads)
+		{
+			FString Times;
+			for (int32 Milestone = FirstMapMilestone; Milestone < (int32)EStartupMilestone::Num; Milestone++)
+			{
+				Times += FString::Printf(TEXT(" %s=%s"), GetMilestoneName((EStartupMilestone)Milestone), *FormatTime(MapLoad.Times[Milestone]));
+			}
+			UE_LOG(LogCyberWarfare, Display, TEXT("%s:%s"), *MapLoad.MapName, *Times);
+		}
+	}));
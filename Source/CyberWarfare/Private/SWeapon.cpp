@@ -11,6 +11,21 @@
 #include "TimerManager.h"
 #include "Net/UnrealNetwork.h"
 #include "SCharacter.h"
+#include "GameFramework/PlayerController.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Engine/AssetManager.h"
+#include "Sound/SoundBase.h"
+#include "SHitboxKernel.h"
+#include "SWeaponOcclusionBVH.h"
+#include "SNetPriority.h"
+#include "SPlayerController.h"
+#include "Public/Components/SNetClockComponent.h"
+#include "Public/Components/SShotLatencyComponent.h"
+#include "SHitchDetector.h"
+#include "SCombatLog.h"
+#include "SStartupTiming.h"
+#include "SInputRecording.h"
+#include "SGameplayRules.h"
 
 
 static int32 DebugWeaponDrawing = 0;
@@ -20,10 +35,72 @@ FAutoConsoleVariableRef CVARDebugWeaponDrawing(
 	TEXT("Drawn debug lines for weapons"), 
 	ECVF_Cheat);
 
+static int32 EffectSignificance = 1;
+FAutoConsoleVariableRef CVAREffectSignificance(
+	TEXT("COOP.EffectSignificance"),
+	EffectSignificance,
+	TEXT("Drop or downgrade weapon cosmetics that are far, off-screen or not rendered"),
+	ECVF_Default);
+
+static float EffectMaxDistance = 8000.f;
+FAutoConsoleVariableRef CVAREffectMaxDistance(
+	TEXT("COOP.EffectMaxDistance"),
+	EffectMaxDistance,
+	TEXT("Distance at which weapon cosmetics reach zero significance"),
+	ECVF_Default);
+
+static float EffectFullThreshold = 0.5f;
+FAutoConsoleVariableRef CVAREffectFullThreshold(
+	TEXT("COOP.EffectFullThreshold"),
+	EffectFullThreshold,
+	TEXT("Significance above which weapon cosmetics play at full fidelity"),
+	ECVF_Default);
+
+static float EffectCullThreshold = 0.1f;
+FAutoConsoleVariableRef CVAREffectCullThreshold(
+	TEXT("COOP.EffectCullThreshold"),
+	EffectCullThreshold,
+	TEXT("Significance below which weapon cosmetics are dropped"),
+	ECVF_Default);
+
+static int32 HitboxTraces = 1;
+FAutoConsoleVariableRef CVARHitboxTraces(
+	TEXT("COOP.HitboxTraces"),
+	HitboxTraces,
+	TEXT("Test characters against their hitboxes instead of complex physics traces against their physics asset"),
+	ECVF_Default);
+
+static int32 StaticOcclusionBVH = 1;
+FAutoConsoleVariableRef CVARStaticOcclusionBVH(
+	TEXT("COOP.StaticOcclusionBVH"),
+	StaticOcclusionBVH,
+	TEXT("Trace shots against the baked static geometry of the map before querying the physics scene"),
+	ECVF_Default);
+
+DECLARE_CYCLE_STAT(TEXT("Weapon trace"), STAT_WeaponTrace, STATGROUP_CyberWarfare);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Weapon dormancy flushes"), STAT_WeaponDormancyFlushes, STATGROUP_CyberWarfare);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Weapon effects full"), STAT_WeaponEffectsFull, STATGROUP_CyberWarfare);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Weapon effects reduced"), STAT_WeaponEffectsReduced, STATGROUP_CyberWarfare);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Weapon effects culled"), STAT_WeaponEffectsCulled, STATGROUP_CyberWarfare);
+
+/** Shots older than this are dropped instead of caught up after a very long frame */
+static const float MaxFireCatchUpTime = 0.5f;
+
+/** Client shot timestamps are trusted up to this far in the past */
+static const float MaxShotTimeLatency = 0.5f;
+
+/** Line of sight of a weapon's effects is traced at most this often per viewer, tracers and impacts in between reuse it */
+static const float EffectLineOfSightInterval = 0.25f;
+
+/** Weight of an effect that is behind something */
+static const float EffectOccludedFactor = 0.4f;
+
 
 // Constructor
 ASWeapon::ASWeapon()
 {
+	COOP_LLM_SCOPE(Weapons);
+
 	MeshComp = CreateDefaultSubobject<USkeletalMeshComponent>(TEXT("MeshComp"));
 	RootComponent = MeshComp;
 
@@ -33,11 +110,32 @@ ASWeapon::ASWeapon()
 	BaseDamage = 20.f;
 	RateOfFire = 600;
 	ClipMaxSize = 30;
+	ReloadDuration = 1.5f;
+
+	// Only ticks while shots are scheduled
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
 
-	NetUpdateFrequency = 66.f;
-	MinNetUpdateFrequency = 33.f;
+	FireModes.AddDefaulted();
+	FireModeIndex = 0;
+	ShotsRemaining = 0;
+	NextShotId = 0;
+	bLastShotHitCharacter = false;
+
+	LineOfSightTestTime = 0.f;
+	bLastLineOfSight = false;
+
+	// Idle weapons barely replicate, firing boosts them
+	NetUpdatePolicy = FNetUpdatePolicy(5.f, 66.f, 1.f);
+	NetUpdateFrequency = NetUpdatePolicy.GetFrequency(false);
+	MinNetUpdateFrequency = NetUpdatePolicy.IdleFrequency;
 
 	SetReplicates(true);
+
+	if (HasAnyFlags(RF_ClassDefaultObject) && GetClass() == ASWeapon::StaticClass())
+	{
+		StartupTiming::Mark(EStartupMilestone::WeaponDefaults);
+	}
 }
 
 
@@ -47,24 +145,247 @@ void ASWeapon::BeginPlay()
 	Super::BeginPlay();
 
 	ClipCurrentSize = ClipMaxSize;
-	TimeBetweenShots = 60 / RateOfFire;
+	LastFireTime = -GetTimeBetweenShots();
+
+	// Blueprints may have tuned the policy
+	NetUpdateFrequency = NetUpdatePolicy.GetFrequency(false);
+	MinNetUpdateFrequency = NetUpdatePolicy.IdleFrequency;
 }
 
 
-// Fire function
-void ASWeapon::Fire()
+void ASWeapon::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
+	ReleaseEffectAssets();
 
-	
-	if (!CharacterIsRunning)
+	Super::EndPlay(EndPlayReason);
+}
+
+
+// Put the weapon away, the owner shows a cheap proxy mesh instead
+void ASWeapon::OnHolstered()
+{
+	SetActorHiddenInGame(true);
+	SetActorEnableCollision(false);
+	ShotsRemaining = 0;
+	SetActorTickEnabled(false);
+	MeshComp->SetComponentTickEnabled(false);
+
+	// Keep our cosmetics for when we are drawn again, a weapon holstered from the start streams them behind the equipped one
+	RequestEffectAssets(false);
+
+	// Nothing changes on a holstered weapon, stop considering it for replication
+	if (Role == ROLE_Authority)
+	{
+		GetWorldTimerManager().ClearTimer(TimerHandle_NetIdle);
+		NetUpdateFrequency = NetUpdatePolicy.GetFrequency(false);
+
+		SetNetDormancy(DORM_DormantAll);
+		FlushNetDormancy();
+	}
+}
 
+
+// Our owner is a corpse now
+void ASWeapon::OnOwnerDied()
+{
+	ShotsRemaining = 0;
+	SetActorTickEnabled(false);
+	SetActorEnableCollision(false);
+	MeshComp->SetComponentTickEnabled(false);
+
+	if (Role == ROLE_Authority)
 	{
-		ClipCurrentSize--;
+		SetNetDormancy(DORM_DormantAll);
+	}
+}
+
+
+// Take the weapon out
+void ASWeapon::OnEquipped()
+{
+	// Goes out right away, and the weapon is dormant again once the boost is over
+	NotifyNetActivity();
+
+	SetActorHiddenInGame(false);
+	SetActorEnableCollision(true);
+	MeshComp->SetComponentTickEnabled(true);
+
+	RequestEffectAssets(true);
+}
 
-		// Call server fire if we are on a client
+
+// Back to a full clip, for characters coming out of the pawn pool
+void ASWeapon::ResetAmmo()
+{
+	ClipCurrentSize = ClipMaxSize;
+	ShotsRemaining = 0;
+	LastFireTime = -GetTimeBetweenShots();
+
+	MarkReplicationDirty();
+}
+
+
+void ASWeapon::MarkReplicationDirty()
+{
+	if (Role == ROLE_Authority && NetDormancy > DORM_Awake)
+	{
+		INC_DWORD_STAT(STAT_WeaponDormancyFlushes);
+		FlushNetDormancy();
+	}
+}
+
+
+void ASWeapon::NotifyNetActivity()
+{
+	if (Role < ROLE_Authority)
+	{
+		return;
+	}
+
+	// Only the start of an activity needs to go out right away
+	if (!GetWorldTimerManager().IsTimerActive(TimerHandle_NetIdle))
+	{
+		ForceNetUpdate();
+	}
+
+	// Holstered and dead weapons are dormant whatever the replication mode, activity always wakes us
+	if (NetDormancy > DORM_Awake)
+	{
+		SetNetDormancy(DORM_Awake);
+	}
+
+	NetUpdateFrequency = NetUpdatePolicy.GetFrequency(true);
+	GetWorldTimerManager().SetTimer(TimerHandle_NetIdle, this, &ASWeapon::OnNetIdle, FMath::Max(NetUpdatePolicy.BoostDuration, 0.01f), false);
+}
+
+
+bool ASWeapon::HasFiredRecently() const
+{
+	return ShotsRemaining != 0 || GetWorld()->TimeSeconds - LastFireTime < 0.5f;
+}
+
+
+float ASWeapon::GetNetPriority(const FVector& ViewPos, const FVector& ViewDir, AActor* Viewer, AActor* ViewTarget, UActorChannel* InChannel, float Time, bool bLowBandwidth)
+{
+	ASCharacter* MyOwner = Cast<ASCharacter>(GetOwner());
+
+	// The weapon of the viewer keeps the engine priority, which favors the view target's instigated actors
+	if (!NetPriority::IsEnabled() || !MyOwner || MyOwner == ViewTarget || (Viewer && Viewer == MyOwner->GetController()))
+	{
+		return Super::GetNetPriority(ViewPos, ViewDir, Viewer, ViewTarget, InChannel, Time, bLowBandwidth);
+	}
+
+	return Time * NetPriority * NetPriority::GetViewerScale(GetActorLocation(), ViewPos, ViewDir, HasFiredRecently(), MyOwner->HasRecentlyDamaged(Viewer));
+}
+
+
+void ASWeapon::OnNetIdle()
+{
+	NetUpdateFrequency = NetUpdatePolicy.GetFrequency(false);
+
+	if (GCoopPushReplication > 0)
+	{
+		SetNetDormancy(DORM_DormantAll);
+	}
+}
+
+
+// Stream in our cosmetics, they are only needed while the weapon is out
+void ASWeapon::RequestEffectAssets(bool bHighPriority)
+{
+	COOP_LLM_SCOPE(Effects);
+
+	// Cosmetics are never played on a dedicated server
+	if (IsNetMode(NM_DedicatedServer) || EffectAssetsHandle.IsValid())
+	{
+		return;
+	}
+
+	TArray<FSoftObjectPath> AssetsToLoad;
+	for (const TSoftObjectPtr<UParticleSystem>* Effect : { &MuzzleEffect, &DefaultImpactEffect, &FleshImpactEffect, &TracerEffect })
+	{
+		if (!Effect->IsNull())
+		{
+			AssetsToLoad.Add(Effect->ToSoftObjectPath());
+		}
+	}
+	for (const TSoftObjectPtr<USoundBase>* Sound : { &SoundFire, &SoundBodyHit, &SoundSurfaceHit })
+	{
+		if (!Sound->IsNull())
+		{
+			AssetsToLoad.Add(Sound->ToSoftObjectPath());
+		}
+	}
+
+	if (AssetsToLoad.Num() > 0)
+	{
+		const TAsyncLoadPriority Priority = bHighPriority ? FStreamableManager::AsyncLoadHighPriority : FStreamableManager::DefaultAsyncLoadPriority;
+		EffectAssetsHandle = UAssetManager::GetStreamableManager().RequestAsyncLoad(AssetsToLoad, FStreamableDelegate(), Priority);
+	}
+}
+
+
+void ASWeapon::ReleaseEffectAssets()
+{
+	if (EffectAssetsHandle.IsValid())
+	{
+		EffectAssetsHandle->ReleaseHandle();
+		EffectAssetsHandle.Reset();
+	}
+}
+
+
+float ASWeapon::GetReloadDuration() const
+{
+	return ReloadDuration;
+}
+
+
+uint8 ASWeapon::GetInventorySlot() const
+{
+	const ASCharacter* MyOwner = Cast<ASCharacter>(GetOwner());
+	const int32 Slot = MyOwner ? MyOwner->GetInventory().Find(const_cast<ASWeapon*>(this)) : INDEX_NONE;
+	return Slot != INDEX_NONE ? (uint8)Slot : MAX_uint8;
+}
+
+
+uint32 ASWeapon::GetStateHash(uint32 Crc) const
+{
+	Crc = FCrc::MemCrc32(&ClipCurrentSize, sizeof(ClipCurrentSize), Crc);
+	Crc = FCrc::MemCrc32(&FireModeIndex, sizeof(FireModeIndex), Crc);
+	Crc = FCrc::MemCrc32(&ShotsRemaining, sizeof(ShotsRemaining), Crc);
+	Crc = FCrc::MemCrc32(&LastFireTime, sizeof(LastFireTime), Crc);
+	return FCrc::MemCrc32(&NextShotTime, sizeof(NextShotTime), Crc);
+}
+
+
+UStaticMesh* ASWeapon::GetHolsterMesh() const
+{
+	return HolsterMesh;
+}
+
+
+// Fire function
+bool ASWeapon::Fire(const FWeaponShot& Shot)
+{
+	HitchDetector::FScopedCounter HitchCounter(EGameplayCounter::Fire);
+
+	// An empty clip does not fire, even if the client still thought it had a round
+	if (!CharacterIsRunning && GameplayRules::ConsumeRound(ClipCurrentSize))
+	{
+		// Clip and hit scan trace change with every shot, replicate at the active rate while firing
+		NotifyNetActivity();
+
+		bLastShotHitCharacter = false;
+
+		// Call server fire if we are on a client, with the shot time in server time
+		uint16 SentShotId = 0;
 		if (Role < ROLE_Authority)
 		{
-			ServerFire();
+			FWeaponShot NetShot = Shot;
+			NetShot.ShotTime = USNetClockComponent::LocalToServerWorldTime(GetWorld(), Shot.ShotTime);
+			NetShot.ShotId = SentShotId = NextShotId = NextShotId < MAX_uint16 ? NextShotId + 1 : 1;
+			ServerFire(NetShot);
 		}
 
 		// Get owner of weapon
@@ -75,33 +396,35 @@ void ASWeapon::Fire()
 			FRotator EyeRotation;
 			MyOwner->GetActorEyesViewPoint(EyeLocation, EyeRotation);
 
+			// Use the aim the scheduler interpolated for this shot
+			EyeRotation = Shot.AimRotation;
+
 			FVector ShotDirection = EyeRotation.Vector();
 			FVector TraceEnd = EyeLocation + (EyeRotation.Vector() * 10000);
 			FVector HeightOffset(0.f, 0.f, 20.f);
 
-			FCollisionQueryParams QueryParams;
-			QueryParams.AddIgnoredActor(MyOwner);
-			QueryParams.AddIgnoredActor(this);
-			QueryParams.bTraceComplex = true;
-			QueryParams.bReturnPhysicalMaterial = true;
-
 			FVector TracerEndPoint = TraceEnd;
 
+			if (Role == ROLE_Authority)
+			{
+				CombatLog::Record(ECombatEvent::Shot, MyOwner, nullptr, EyeLocation, ShotDirection, Shot.ShotTime);
+			}
+
 			EPhysicalSurface SurfaceType = SurfaceType_Default;
 
 			FHitResult Hit;
-			if (GetWorld()->LineTraceSingleByChannel(Hit, MeshComp->GetSocketLocation(MuzzleSocketName) + HeightOffset, TraceEnd, COLLISION_WEAPON, QueryParams))
+			if (WeaponTrace(MeshComp->GetSocketLocation(MuzzleSocketName) + HeightOffset, TraceEnd, Hit, SurfaceType))
 			{
 				// Blocking hit, process damage here
 
 				AActor* HitActor = Hit.GetActor();
+				bLastShotHitCharacter = Cast<ASCharacter>(HitActor) != nullptr;
 
-				SurfaceType = UPhysicalMaterial::DetermineSurfaceType(Hit.PhysMaterial.Get());
+				const float ActualDamage = GameplayRules::GetShotDamage(BaseDamage, SurfaceType == SURFACE_FLESHVULNERABLE);
 
-				float ActualDamage = BaseDamage;
-				if (SurfaceType == SURFACE_FLESHVULNERABLE)
+				if (Role == ROLE_Authority)
 				{
-					ActualDamage *= 4.f;
+					CombatLog::Record(ECombatEvent::Hit, MyOwner, HitActor, Hit.ImpactPoint, ShotDirection, ActualDamage, 0.f, SurfaceType);
 				}
 
 				UGameplayStatics::ApplyPointDamage(HitActor, ActualDamage, ShotDirection, Hit, MyOwner->GetInstigatorController(), this, DamageType);
@@ -124,20 +447,124 @@ void ASWeapon::Fire()
 				HitScanTrace.SurfaceType = SurfaceType;
 			}
 
-			LastFireTime = GetWorld()->TimeSeconds;
+			LastFireTime = Shot.ShotTime;
+		}
+
+		// What we saw, to compare with what the server registers
+		USShotLatencyComponent* ShotLatency = SentShotId != 0 ? USShotLatencyComponent::FindFor(this) : nullptr;
+		if (ShotLatency)
+		{
+			ShotLatency->OnShotFired(SentShotId, bLastShotHitCharacter);
 		}
 
-		if (ClipCurrentSize <= 0)
+		if (GameplayRules::ClipIsEmpty(ClipCurrentSize))
 		{
 			ASCharacter* MyOwner = Cast<ASCharacter>(GetOwner());
 			if (MyOwner)
 			{
 				MyOwner->Reload();
 			}
-			return;
 		}
+		return true;
 	}
 
+	return false;
+}
+
+
+// Trace a shot, characters are tested against their hitboxes and the physics scene only handles the world
+bool ASWeapon::WeaponTrace(const FVector& TraceStart, const FVector& TraceEnd, FHitResult& OutHit, EPhysicalSurface& OutSurfaceType) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_WeaponTrace);
+	HitchDetector::FScopedCounter HitchCounter(EGameplayCounter::WeaponTrace);
+
+	AActor* MyOwner = GetOwner();
+
+	FCollisionQueryParams QueryParams;
+	QueryParams.AddIgnoredActor(MyOwner);
+	QueryParams.AddIgnoredActor(this);
+	QueryParams.bTraceComplex = true;
+	QueryParams.bReturnPhysicalMaterial = true;
+
+	if (HitboxTraces <= 0)
+	{
+		if (GetWorld()->LineTraceSingleByChannel(OutHit, TraceStart, TraceEnd, COLLISION_WEAPON, QueryParams))
+		{
+			OutSurfaceType = UPhysicalMaterial::DetermineSurfaceType(OutHit.PhysMaterial.Get());
+			return true;
+		}
+		return false;
+	}
+
+	// Hitboxes of the frame, shared by every weapon of the world, their characters' physics assets stay out of the scene query
+	const FHitboxWorldCache& HitboxCache = FHitboxWorldCache::Get(GetWorld());
+	HitboxCache.AddIgnoredCharacters(QueryParams);
+
+	const FVector TraceDirection = (TraceEnd - TraceStart).GetSafeNormal();
+	const float TraceLength = (TraceEnd - TraceStart).Size();
+
+	// Static geometry first, from the baked BVH of the map when there is one
+	const FWeaponOcclusionBVH* OcclusionBVH = StaticOcclusionBVH > 0 ? FWeaponOcclusionBVH::FindForWorld(GetWorld()) : nullptr;
+	FWeaponOcclusionHit StaticHit;
+	const EWeaponOcclusionResult StaticResult = OcclusionBVH ? OcclusionBVH->Raycast(TraceStart, TraceDirection, TraceLength, StaticHit) : EWeaponOcclusionResult::Incomplete;
+	const bool bStaticHit = StaticResult == EWeaponOcclusionResult::Hit;
+
+	// The physics scene is left with what moves, or with whatever could not be baked (everything if the BVH gave up on the ray)
+	FVector PhysicsTraceEnd = TraceEnd;
+	if (StaticResult != EWeaponOcclusionResult::Incomplete && OcclusionBVH->CoversAllStaticGeometry())
+	{
+		QueryParams.MobilityType = EQueryMobilityType::Dynamic;
+	}
+	if (bStaticHit)
+	{
+		PhysicsTraceEnd = TraceStart + TraceDirection * StaticHit.Distance;
+	}
+
+	bool bBlockingHit = GetWorld()->LineTraceSingleByChannel(OutHit, TraceStart, PhysicsTraceEnd, COLLISION_WEAPON, QueryParams);
+	if (bBlockingHit)
+	{
+		OutSurfaceType = UPhysicalMaterial::DetermineSurfaceType(OutHit.PhysMaterial.Get());
+	}
+	else if (bStaticHit)
+	{
+		OutHit = FHitResult(nullptr, nullptr, TraceStart + TraceDirection * StaticHit.Distance, StaticHit.Normal);
+		OutHit.TraceStart = TraceStart;
+		OutHit.TraceEnd = TraceEnd;
+		OutHit.Distance = StaticHit.Distance;
+		OutHit.Time = StaticHit.Distance / FMath::Max(TraceLength, KINDA_SMALL_NUMBER);
+		OutHit.bBlockingHit = true;
+
+		OutSurfaceType = (EPhysicalSurface)StaticHit.SurfaceType;
+		bBlockingHit = true;
+	}
+
+	// Only hitboxes in front of the world hit count
+	FHitboxRay Ray;
+	Ray.Origin = TraceStart;
+	Ray.Direction = TraceDirection;
+	Ray.MaxDistance = bBlockingHit ? OutHit.Distance : TraceLength;
+	HitboxCache.GetCapsuleRange(Cast<ASCharacter>(MyOwner), Ray.IgnoredBegin, Ray.IgnoredEnd);
+
+	const FHitboxCapsuleSoA& Capsules = HitboxCache.GetCapsules();
+	FHitboxRayHit RayHit;
+	HitboxKernel::IntersectRays(&Ray, 1, Capsules, &RayHit);
+
+	ASCharacter* HitCharacter = RayHit.HitboxIndex != INDEX_NONE ? HitboxCache.GetCharacter(Capsules.OwnerIndex[RayHit.HitboxIndex]) : nullptr;
+	if (HitCharacter)
+	{
+		const FVector ImpactPoint = Ray.Origin + Ray.Direction * RayHit.Distance;
+
+		OutHit = FHitResult(HitCharacter, HitCharacter->GetMesh(), ImpactPoint, -Ray.Direction);
+		OutHit.TraceStart = TraceStart;
+		OutHit.TraceEnd = TraceEnd;
+		OutHit.Distance = RayHit.Distance;
+		OutHit.Time = RayHit.Distance / FMath::Max(TraceLength, KINDA_SMALL_NUMBER);
+
+		OutSurfaceType = (EPhysicalSurface)Capsules.SurfaceType[RayHit.HitboxIndex];
+		bBlockingHit = true;
+	}
+
+	return bBlockingHit;
 }
 
 
@@ -149,49 +576,216 @@ void ASWeapon::OnRep_HitScanTrace()
 }
 
 
-void ASWeapon::ServerFire_Implementation()
+void ASWeapon::ServerFire_Implementation(const FWeaponShot& Shot)
 {
-	Fire();
+	// Floods are dropped before any trace or recording, a few shots of slack absorb network jitter
+	if (!ASPlayerController::ConsumeRpcToken(this, EServerRpc::Fire, 1.f / GetTimeBetweenShots(), 3.f))
+	{
+		return;
+	}
+
+	InputRecording::Record(EInputEvent::Fire, this, Shot.ShotTime, 0.f, FVector::ZeroVector, Shot.AimRotation, GetInventorySlot());
+
+	// Clients stamp shots with their estimate of our clock, never trust it beyond the latency we accept
+	const float Now = GetWorld()->TimeSeconds;
+	FWeaponShot ServerShot = Shot;
+	ServerShot.ShotTime = FMath::Clamp(Shot.ShotTime, Now - MaxShotTimeLatency, Now);
+
+	const double FireStartTime = FPlatformTime::Seconds();
+	const bool bFired = Fire(ServerShot);
+
+	// The unclamped shot time is the client's estimate of our clock when it fired, which gives the one way trip of the shot.
+	// A refused shot (empty clip, running) is never confirmed, its hit flag would be the one of the previous shot.
+	if (bFired && Shot.ShotId != 0)
+	{
+		ClientConfirmShot(Shot.ShotId, bLastShotHitCharacter, Now - Shot.ShotTime, FPlatformTime::Seconds() - FireStartTime);
+	}
 }
 
 
-bool ASWeapon::ServerFire_Validate()
+void ASWeapon::ClientConfirmShot_Implementation(uint16 ShotId, bool bHitCharacter, float FireToServer, float ServerToDamage)
 {
-	return true;
+	USShotLatencyComponent* ShotLatency = USShotLatencyComponent::FindFor(this);
+	if (ShotLatency)
+	{
+		ShotLatency->OnShotConfirmed(ShotId, bHitCharacter, FireToServer, ServerToDamage);
+	}
+}
+
+
+bool ASWeapon::ServerFire_Validate(const FWeaponShot& Shot)
+{
+	return !Shot.AimRotation.ContainsNaN();
 }
 
 
 void ASWeapon::StartFire()
 {
-	float FirstDelay = FMath::Max(LastFireTime + TimeBetweenShots - GetWorld()->TimeSeconds, 0.f);
+	// A burst or a semi-auto shot still pending finishes first, pressing again mid-burst must not make it longer
+	if (!FireModes.IsValidIndex(FireModeIndex) || ShotsRemaining != 0)
+	{
+		return;
+	}
+
+	switch (FireModes[FireModeIndex].FireMode)
+	{
+	case EWeaponFireMode::SemiAuto:
+		ShotsRemaining = 1;
+		break;
+	case EWeaponFireMode::Burst:
+		ShotsRemaining = FMath::Max<int32>(FireModes[FireModeIndex].BurstCount, 1);
+		break;
+	default:
+		ShotsRemaining = INDEX_NONE;
+		break;
+	}
+
+	// Never fire sooner than the rate of fire allows, even when spamming the trigger
+	const float Now = GetWorld()->TimeSeconds;
+	NextShotTime = FMath::Max(LastFireTime + GetTimeBetweenShots(), Now);
+
+	LastAimRotation = GetOwnerAimRotation();
+	LastAimTime = Now;
 
-	GetWorldTimerManager().SetTimer(TimerHandle_TimeBetweenShots, this, &ASWeapon::Fire, TimeBetweenShots, true, FirstDelay);
+	NotifyNetActivity();
+
+	SetActorTickEnabled(true);
+	ProcessScheduledShots();
 }
 
 
 void ASWeapon::StopFire()
 {
-	GetWorldTimerManager().ClearTimer(TimerHandle_TimeBetweenShots);
+	// Bursts always complete, full auto stops with the trigger
+	if (ShotsRemaining == INDEX_NONE)
+	{
+		ShotsRemaining = 0;
+		SetActorTickEnabled(false);
+	}
 }
 
 
-bool ASWeapon::ClipIsFull()
+void ASWeapon::CycleFireMode()
 {
-	if (ClipCurrentSize < ClipMaxSize)
+	if (ShotsRemaining == 0 && FireModes.Num() > 0)
 	{
-		return false;
+		FireModeIndex = (FireModeIndex + 1) % FireModes.Num();
+
+		// Our shots arrive after the mode on the same reliable channel, the server fires them at the same rate
+		if (Role < ROLE_Authority)
+		{
+			ServerSetFireMode((uint8)FireModeIndex);
+		}
 	}
-	return true;
 }
 
 
-bool ASWeapon::ClipIsEmpty()
+void ASWeapon::ServerSetFireMode_Implementation(uint8 NewFireModeIndex)
 {
-	if (ClipCurrentSize <= 0)
+	if (!ASPlayerController::ConsumeRpcToken(this, EServerRpc::SetFireMode, 10.f, 4.f))
 	{
-		return true;
+		return;
 	}
-	return false;
+
+	InputRecording::Record(EInputEvent::SetFireMode, this, 0.f, NewFireModeIndex, FVector::ZeroVector, FRotator::ZeroRotator, GetInventorySlot());
+
+	FireModeIndex = NewFireModeIndex;
+}
+
+
+bool ASWeapon::ServerSetFireMode_Validate(uint8 NewFireModeIndex)
+{
+	return FireModes.IsValidIndex(NewFireModeIndex);
+}
+
+
+void ASWeapon::Tick(float DeltaTime)
+{
+	HitchDetector::FScopedActorTick HitchTick(this);
+
+	Super::Tick(DeltaTime);
+
+	ProcessScheduledShots();
+}
+
+
+void ASWeapon::ProcessScheduledShots()
+{
+	const float Now = GetWorld()->TimeSeconds;
+	const float TimeBetweenShots = GetTimeBetweenShots();
+	const FRotator AimRotation = GetOwnerAimRotation();
+
+	// After a huge hitch, drop the shots that are too old rather than unloading the clip at once
+	NextShotTime = FMath::Max(NextShotTime, Now - MaxFireCatchUpTime);
+
+	const FQuat FromAim = LastAimRotation.Quaternion();
+	const FQuat ToAim = AimRotation.Quaternion();
+	const float FrameTime = Now - LastAimTime;
+
+	while (ShotsRemaining != 0 && NextShotTime <= Now && !ClipIsEmpty())
+	{
+		// Each round is fired where the aim was when it fell due, not where it is at the end of the frame
+		const float Alpha = FrameTime > KINDA_SMALL_NUMBER ? FMath::Clamp((NextShotTime - LastAimTime) / FrameTime, 0.f, 1.f) : 1.f;
+
+		FWeaponShot Shot;
+		Shot.ShotTime = NextShotTime;
+		Shot.AimRotation = FQuat::Slerp(FromAim, ToAim, Alpha).Rotator();
+
+		Fire(Shot);
+
+		NextShotTime += TimeBetweenShots;
+		if (ShotsRemaining > 0)
+		{
+			ShotsRemaining--;
+		}
+	}
+
+	if (ClipIsEmpty())
+	{
+		ShotsRemaining = 0;
+	}
+
+	LastAimRotation = AimRotation;
+	LastAimTime = Now;
+
+	if (ShotsRemaining == 0)
+	{
+		SetActorTickEnabled(false);
+	}
+}
+
+
+FRotator ASWeapon::GetOwnerAimRotation() const
+{
+	AActor* MyOwner = GetOwner();
+	if (MyOwner)
+	{
+		FVector EyeLocation;
+		FRotator EyeRotation;
+		MyOwner->GetActorEyesViewPoint(EyeLocation, EyeRotation);
+		return EyeRotation;
+	}
+
+	return GetActorRotation();
+}
+
+
+float ASWeapon::GetTimeBetweenShots() const
+{
+	const float FireModeRateOfFire = FireModes.IsValidIndex(FireModeIndex) ? FireModes[FireModeIndex].RateOfFire : 0.f;
+	return GameplayRules::GetTimeBetweenShots(GameplayRules::GetRateOfFire(RateOfFire, FireModeRateOfFire));
+}
+
+
+bool ASWeapon::ClipIsFull()
+{
+	return GameplayRules::ClipIsFull(ClipCurrentSize, ClipMaxSize);
+}
+
+
+bool ASWeapon::ClipIsEmpty()
+{
+	return GameplayRules::ClipIsEmpty(ClipCurrentSize);
 }
 
 
@@ -208,17 +802,27 @@ void ASWeapon::Reload()
 
 	if (MyOwner)
 	{
-		// Check how many ammos we can get to fill our clip
-		int32 NewAmmos = MyOwner->RequestAmmos(ClipMaxSize - ClipCurrentSize);
+		// Fill our clip with as many ammos as the owner has left
+		const int32 NewAmmos = MyOwner->ReloadClip(ClipCurrentSize, ClipMaxSize);
+		MarkReplicationDirty();
 
-		// Update our current clip
-		ClipCurrentSize += NewAmmos;
+		if (Role == ROLE_Authority)
+		{
+			CombatLog::Record(ECombatEvent::Reload, MyOwner, nullptr, MyOwner->GetActorLocation(), FVector::ZeroVector, NewAmmos, ClipCurrentSize);
+		}
 	}
 }
 
 
 void ASWeapon::ServerReload_Implementation()
 {
+	if (!ASPlayerController::ConsumeRpcToken(this, EServerRpc::WeaponReload, 1.f / FMath::Max(ReloadDuration, 0.1f), 2.f))
+	{
+		return;
+	}
+
+	InputRecording::Record(EInputEvent::WeaponReload, this, 0.f, 0.f, FVector::ZeroVector, FRotator::ZeroRotator, GetInventorySlot());
+
 	Reload();
 }
 
@@ -232,21 +836,39 @@ bool ASWeapon::ServerReload_Validate()
 // Play effects at muzzle location on fire (locally)
 void ASWeapon::PlayFireEffects(FVector TracerEndPoint)
 {
-	if (MuzzleEffect)
+	COOP_LLM_SCOPE(Effects);
+
+	FVector MuzzleLocation = MeshComp->GetSocketLocation(MuzzleSocketName);
+
+	const EWeaponEffectTier Tier = GetEffectTier(MuzzleLocation);
+	if (Tier == EWeaponEffectTier::Culled)
+	{
+		INC_DWORD_STAT(STAT_WeaponEffectsCulled);
+		return;
+	}
+
+	if (MuzzleEffect.IsValid())
 	{
-		UGameplayStatics::SpawnEmitterAttached(MuzzleEffect, MeshComp, MuzzleSocketName);
+		UGameplayStatics::SpawnEmitterAttached(MuzzleEffect.Get(), MeshComp, MuzzleSocketName);
 	}
 
-	if (SoundFire)
+	if (SoundFire.IsValid())
 	{
-		UGameplayStatics::PlaySoundAtLocation(this, SoundFire, MeshComp->GetSocketLocation(MuzzleSocketName), 0.3);
+		UGameplayStatics::PlaySoundAtLocation(this, SoundFire.Get(), MuzzleLocation, 0.3);
 	}
 
-	if (TracerEffect)
+	// Reduced fidelity keeps the muzzle flash and the shot sound, tracers are only for close or visible weapons
+	if (Tier == EWeaponEffectTier::Reduced)
 	{
-		FVector MuzzleLocation = MeshComp->GetSocketLocation(MuzzleSocketName);
+		INC_DWORD_STAT(STAT_WeaponEffectsReduced);
+		return;
+	}
 
-		UParticleSystemComponent* TracerComp = UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), TracerEffect, MuzzleLocation);
+	INC_DWORD_STAT(STAT_WeaponEffectsFull);
+
+	if (TracerEffect.IsValid())
+	{
+		UParticleSystemComponent* TracerComp = UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), TracerEffect.Get(), MuzzleLocation);
 		if (TracerComp)
 		{
 			TracerComp->SetVectorParameter(TracerTargetName, TracerEndPoint);
@@ -256,8 +878,9 @@ void ASWeapon::PlayFireEffects(FVector TracerEndPoint)
 	APawn* MyOwner = Cast<APawn>(GetOwner());
 	if (MyOwner)
 	{
+		// Only shake the camera of a local shooter, a remote one plays its own shots
 		APlayerController* PC = Cast<APlayerController>(MyOwner->GetController());
-		if (PC)
+		if (PC && PC->IsLocalController())
 		{
 			PC->ClientPlayCameraShake(FireCamShake);
 		}
@@ -268,28 +891,48 @@ void ASWeapon::PlayFireEffects(FVector TracerEndPoint)
 // Play effects on impact (locally)
 void ASWeapon::PlayImpactEffects(EPhysicalSurface SurfaceType, FVector ImpactPoint)
 {
+	COOP_LLM_SCOPE(Effects);
+
+	const EWeaponEffectTier Tier = GetEffectTier(ImpactPoint);
+	if (Tier == EWeaponEffectTier::Culled)
+	{
+		INC_DWORD_STAT(STAT_WeaponEffectsCulled);
+		return;
+	}
+
+	// Reduced fidelity only keeps the impact particles
+	const bool bPlaySound = Tier == EWeaponEffectTier::Full;
+	if (bPlaySound)
+	{
+		INC_DWORD_STAT(STAT_WeaponEffectsFull);
+	}
+	else
+	{
+		INC_DWORD_STAT(STAT_WeaponEffectsReduced);
+	}
+
 	UParticleSystem* SelectedEffect = nullptr;
 	switch (SurfaceType)
 	{
 	case SURFACE_FLESHDEFAULT:
-		SelectedEffect = FleshImpactEffect;
-		if (SoundBodyHit)
+		SelectedEffect = FleshImpactEffect.Get();
+		if (SoundBodyHit.IsValid() && bPlaySound)
 		{
-			UGameplayStatics::PlaySoundAtLocation(this, SoundBodyHit, ImpactPoint, 0.5);
+			UGameplayStatics::PlaySoundAtLocation(this, SoundBodyHit.Get(), ImpactPoint, 0.5);
 		}
 		break;
 	case SURFACE_FLESHVULNERABLE:
-		SelectedEffect = FleshImpactEffect;
-		if (SoundBodyHit)
+		SelectedEffect = FleshImpactEffect.Get();
+		if (SoundBodyHit.IsValid() && bPlaySound)
 		{
-			UGameplayStatics::PlaySoundAtLocation(this, SoundBodyHit, ImpactPoint, 0.5);
+			UGameplayStatics::PlaySoundAtLocation(this, SoundBodyHit.Get(), ImpactPoint, 0.5);
 		}
 		break;
 	default:
-		SelectedEffect = DefaultImpactEffect;
-		if (SoundSurfaceHit)
+		SelectedEffect = DefaultImpactEffect.Get();
+		if (SoundSurfaceHit.IsValid() && bPlaySound)
 		{
-			UGameplayStatics::PlaySoundAtLocation(this, SoundSurfaceHit, ImpactPoint, 0.5);
+			UGameplayStatics::PlaySoundAtLocation(this, SoundSurfaceHit.Get(), ImpactPoint, 0.5);
 		}
 		break;
 	}
@@ -304,6 +947,101 @@ void ASWeapon::PlayImpactEffects(EPhysicalSurface SurfaceType, FVector ImpactPoi
 }
 
 
+static EWeaponEffectTier GetSignificanceTier(float Significance)
+{
+	if (Significance >= EffectFullThreshold)
+	{
+		return EWeaponEffectTier::Full;
+	}
+	return Significance >= EffectCullThreshold ? EWeaponEffectTier::Reduced : EWeaponEffectTier::Culled;
+}
+
+
+// Score a cosmetic against every local view, the best one decides
+EWeaponEffectTier ASWeapon::GetEffectTier(const FVector& EffectLocation) const
+{
+	// Nobody is watching on a dedicated server
+	if (IsNetMode(NM_DedicatedServer))
+	{
+		return EWeaponEffectTier::Culled;
+	}
+
+	if (EffectSignificance <= 0)
+	{
+		return EWeaponEffectTier::Full;
+	}
+
+	// Our own shots always play at full fidelity
+	const APawn* MyOwner = Cast<APawn>(GetOwner());
+	if (MyOwner && MyOwner->IsLocallyControlled())
+	{
+		return EWeaponEffectTier::Full;
+	}
+
+	// The weapon mesh is not rendered the frame it is equipped, nor in first person for other views, so the shooter's body decides
+	const ACharacter* OwnerCharacter = Cast<ACharacter>(MyOwner);
+	const bool bOwnerRendered = OwnerCharacter && OwnerCharacter->GetMesh() && OwnerCharacter->GetMesh()->WasRecentlyRendered(0.2f);
+
+	float BestSignificance = 0.f;
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PC = It->Get();
+		if (!PC || !PC->IsLocalController() || !PC->PlayerCameraManager)
+		{
+			continue;
+		}
+
+		const FVector ViewLocation = PC->PlayerCameraManager->GetCameraLocation();
+		const FVector ViewDirection = PC->PlayerCameraManager->GetCameraRotation().Vector();
+
+		const FVector ToEffect = EffectLocation - ViewLocation;
+		const float Distance = ToEffect.Size();
+		const float DistanceFactor = 1.f - FMath::Clamp(Distance / FMath::Max(EffectMaxDistance, 1.f), 0.f, 1.f);
+
+		// Full weight inside the view cone, fading to a third behind us
+		const float ViewDot = Distance > KINDA_SMALL_NUMBER ? FVector::DotProduct(ToEffect / Distance, ViewDirection) : 1.f;
+		const float ViewFactor = FMath::GetMappedRangeValueClamped(FVector2D(-0.2f, 0.6f), FVector2D(0.33f, 1.f), ViewDot);
+
+		// Occlusion bucket: an effect neither on a shooter we see nor in line of sight is behind something. Only trace when
+		// occlusion can change the outcome, distance and view alone decide most off-screen and far away effects.
+		const float VisibleSignificance = DistanceFactor * ViewFactor;
+		const float OccludedSignificance = VisibleSignificance * EffectOccludedFactor;
+		if (bOwnerRendered)
+		{
+			BestSignificance = FMath::Max(BestSignificance, VisibleSignificance);
+		}
+		else if (VisibleSignificance > BestSignificance && GetSignificanceTier(VisibleSignificance) != GetSignificanceTier(OccludedSignificance))
+		{
+			const float Now = GetWorld()->TimeSeconds;
+			if (LineOfSightViewer.Get() != PC || Now - LineOfSightTestTime >= EffectLineOfSightInterval)
+			{
+				LineOfSightViewer = PC;
+				LineOfSightTestTime = Now;
+				bLastLineOfSight = IsEffectInLineOfSight(EffectLocation, ViewLocation);
+			}
+			BestSignificance = FMath::Max(BestSignificance, bLastLineOfSight ? VisibleSignificance : OccludedSignificance);
+		}
+		else
+		{
+			BestSignificance = FMath::Max(BestSignificance, OccludedSignificance);
+		}
+	}
+
+	return GetSignificanceTier(BestSignificance);
+}
+
+
+bool ASWeapon::IsEffectInLineOfSight(const FVector& EffectLocation, const FVector& ViewLocation) const
+{
+	// Stop short of the effect, impacts sit on the surface that was hit
+	const FVector ToView = (ViewLocation - EffectLocation).GetSafeNormal();
+
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(WeaponEffectLineOfSight), false, GetOwner());
+	QueryParams.AddIgnoredActor(this);
+	return !GetWorld()->LineTraceTestByChannel(EffectLocation + ToView * 10.f, ViewLocation, ECC_Visibility, QueryParams);
+}
+
+
 // Replicate props
 void ASWeapon::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
 {
@@ -0,0 +1,418 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SWeaponOcclusionBVH.h"
+#include "CyberWarfare.h"
+#include "Engine/World.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/PackageName.h"
+#include "Misc/Paths.h"
+#include "Serialization/Archive.h"
+#include "UObject/Package.h"
+#include "UObject/UObjectGlobals.h"
+
+
+/** Leaves hold at most this many triangles */
+static const int32 MaxTrianglesPerLeaf = 4;
+
+/** Baked files live under the content directory in their own folder, staged as is (see DirectoriesToAlwaysStageAsUFS) */
+static const TCHAR* BakedDirectory = TEXT("WeaponOcclusion");
+
+
+/** BVHs of the maps in use, missing files are cached as well so a map without a BVH only hits the disk once */
+static TMap<FString, TSharedPtr<FWeaponOcclusionBVH>>& GetLoadedMaps()
+{
+	static TMap<FString, TSharedPtr<FWeaponOcclusionBVH>> LoadedMaps;
+
+	// A map load may come with a freshly baked file, and a world going away no longer needs its BVH
+	static FDelegateHandle PreLoadMapHandle = FCoreUObjectDelegates::PreLoadMap.AddLambda([](const FString& MapName)
+	{
+		LoadedMaps.Reset();
+	});
+	static FDelegateHandle WorldCleanupHandle = FWorldDelegates::OnWorldCleanup.AddLambda([](UWorld* World, bool bSessionEnded, bool bCleanupResources)
+	{
+		LoadedMaps.Remove(UWorld::RemovePIEPrefix(World->GetOutermost()->GetName()));
+	});
+
+	return LoadedMaps;
+}
+
+
+FWeaponOcclusionBVH::FWeaponOcclusionBVH()
+	: MappedFile(nullptr)
+	, MappedRegion(nullptr)
+	, Header(nullptr)
+	, Nodes(nullptr)
+	, Triangles(nullptr)
+{
+}
+
+
+FWeaponOcclusionBVH::~FWeaponOcclusionBVH()
+{
+	delete MappedRegion;
+	delete MappedFile;
+}
+
+
+const FWeaponOcclusionBVH* FWeaponOcclusionBVH::FindForWorld(const UWorld* World)
+{
+	if (!World)
+	{
+		return nullptr;
+	}
+
+	TMap<FString, TSharedPtr<FWeaponOcclusionBVH>>& LoadedMaps = GetLoadedMaps();
+
+	const FString MapPackageName = UWorld::RemovePIEPrefix(World->GetOutermost()->GetName());
+	if (const TSharedPtr<FWeaponOcclusionBVH>* Found = LoadedMaps.Find(MapPackageName))
+	{
+		return Found->Get();
+	}
+
+	TSharedPtr<FWeaponOcclusionBVH> Loaded = LoadFromFile(GetFilenameForMap(MapPackageName));
+	LoadedMaps.Add(MapPackageName, Loaded);
+
+	if (Loaded.IsValid())
+	{
+		UE_LOG(LogCyberWarfare, Log, TEXT("Loaded weapon occlusion BVH for %s (%d triangles, %s)"), *MapPackageName, Loaded->GetNumTriangles(),
+			Loaded->MappedRegion ? TEXT("memory mapped") : TEXT("in memory"));
+	}
+	return Loaded.Get();
+}
+
+
+FString FWeaponOcclusionBVH::GetFilenameForMap(const FString& MapPackageName)
+{
+	// Next to the map would stage the uncooked map files with it, game maps get a mirror of their path instead
+	static const FString GameRoot(TEXT("/Game/"));
+	if (MapPackageName.StartsWith(GameRoot))
+	{
+		return FPaths::ProjectContentDir() / BakedDirectory / MapPackageName.RightChop(GameRoot.Len()) + TEXT(".wbvh");
+	}
+
+	return FPackageName::LongPackageNameToFilename(MapPackageName, TEXT(".wbvh"));
+}
+
+
+TSharedPtr<FWeaponOcclusionBVH> FWeaponOcclusionBVH::LoadFromFile(const FString& Filename)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	if (!PlatformFile.FileExists(*Filename))
+	{
+		return nullptr;
+	}
+
+	TSharedPtr<FWeaponOcclusionBVH> BVH = MakeShareable(new FWeaponOcclusionBVH());
+
+	// Map the file so its pages are shared, the triangles are only faulted in when traces touch them
+	BVH->MappedFile = PlatformFile.OpenMapped(*Filename);
+	if (BVH->MappedFile)
+	{
+		BVH->MappedRegion = BVH->MappedFile->MapRegion();
+		if (BVH->MappedRegion && BVH->SetData(BVH->MappedRegion->GetMappedPtr(), BVH->MappedRegion->GetMappedSize()))
+		{
+			return BVH;
+		}
+
+		delete BVH->MappedRegion;
+		delete BVH->MappedFile;
+		BVH->MappedRegion = nullptr;
+		BVH->MappedFile = nullptr;
+	}
+
+	// Platforms or pak files without mapping support
+	if (FFileHelper::LoadFileToArray(BVH->LoadedData, *Filename) && BVH->SetData(BVH->LoadedData.GetData(), BVH->LoadedData.Num()))
+	{
+		return BVH;
+	}
+
+	UE_LOG(LogCyberWarfare, Warning, TEXT("Invalid weapon occlusion BVH %s"), *Filename);
+	return nullptr;
+}
+
+
+bool FWeaponOcclusionBVH::SetData(const uint8* Data, int64 Size)
+{
+	if (!Data || Size < (int64)sizeof(FWeaponBVHHeader))
+	{
+		return false;
+	}
+
+	const FWeaponBVHHeader* FileHeader = reinterpret_cast<const FWeaponBVHHeader*>(Data);
+	if (FileHeader->Magic != FWeaponBVHHeader::ExpectedMagic || FileHeader->Version != FWeaponBVHHeader::ExpectedVersion || FileHeader->NumNodes == 0)
+	{
+		return false;
+	}
+
+	const int64 ExpectedSize = sizeof(FWeaponBVHHeader) + (int64)FileHeader->NumNodes * sizeof(FWeaponBVHNode) + (int64)FileHeader->NumTriangles * sizeof(FWeaponBVHTriangle);
+	if (Size < ExpectedSize)
+	{
+		return false;
+	}
+
+	const FWeaponBVHNode* FileNodes = reinterpret_cast<const FWeaponBVHNode*>(Data + sizeof(FWeaponBVHHeader));
+
+	// Raycast trusts every index, check them once here so a stale or corrupt file never reads outside of the mapping.
+	// Children always come after their parent, which also rules out cycles. Without triangles the root is never read.
+	if (FileHeader->NumTriangles > 0)
+	{
+		for (int64 NodeIndex = 0; NodeIndex < FileHeader->NumNodes; NodeIndex++)
+		{
+			const FWeaponBVHNode& Node = FileNodes[NodeIndex];
+			const bool bValidLeaf = Node.Count > 0 && Node.FirstIndex >= 0 && (int64)Node.FirstIndex + Node.Count <= FileHeader->NumTriangles;
+			const bool bValidInner = Node.Count == 0 && Node.FirstIndex > NodeIndex && (int64)Node.FirstIndex + 1 < FileHeader->NumNodes;
+			if (!bValidLeaf && !bValidInner)
+			{
+				return false;
+			}
+		}
+	}
+
+	Header = FileHeader;
+	Nodes = FileNodes;
+	Triangles = reinterpret_cast<const FWeaponBVHTriangle*>(Data + sizeof(FWeaponBVHHeader) + FileHeader->NumNodes * sizeof(FWeaponBVHNode));
+	return true;
+}
+
+
+bool FWeaponOcclusionBVH::CoversAllStaticGeometry() const
+{
+	return Header && Header->bCoversAllStatic != 0;
+}
+
+
+int32 FWeaponOcclusionBVH::GetNumTriangles() const
+{
+	return Header ? Header->NumTriangles : 0;
+}
+
+
+FBox FWeaponOcclusionBVH::GetBounds() const
+{
+	if (!Header || Header->NumTriangles == 0)
+	{
+		return FBox(ForceInit);
+	}
+
+	return FBox(FVector(Nodes[0].Min[0], Nodes[0].Min[1], Nodes[0].Min[2]), FVector(Nodes[0].Max[0], Nodes[0].Max[1], Nodes[0].Max[2]));
+}
+
+
+bool FWeaponOcclusionBVH::BuildAndSave(const TArray<FWeaponBVHTriangle>& InTriangles, bool bCoversAllStatic, const FString& Filename)
+{
+	struct FTriangleRef
+	{
+		FBox Bounds;
+		FVector Centroid;
+		int32 Index;
+	};
+
+	TArray<FTriangleRef> Refs;
+	Refs.Reserve(InTriangles.Num());
+	for (int32 Index = 0; Index < InTriangles.Num(); Index++)
+	{
+		const FWeaponBVHTriangle& Triangle = InTriangles[Index];
+		const FVector V0(Triangle.V0[0], Triangle.V0[1], Triangle.V0[2]);
+		const FVector V1 = V0 + FVector(Triangle.E1[0], Triangle.E1[1], Triangle.E1[2]);
+		const FVector V2 = V0 + FVector(Triangle.E2[0], Triangle.E2[1], Triangle.E2[2]);
+
+		FTriangleRef& Ref = Refs[Refs.AddUninitialized()];
+		Ref.Bounds = FBox(ForceInit);
+		Ref.Bounds += V0;
+		Ref.Bounds += V1;
+		Ref.Bounds += V2;
+		Ref.Centroid = (V0 + V1 + V2) / 3.f;
+		Ref.Index = Index;
+	}
+
+	TArray<FWeaponBVHNode> BuiltNodes;
+	BuiltNodes.AddZeroed();
+
+	// Median split on the longest centroid axis, children are stored next to each other
+	TFunction<void(int32, int32, int32)> BuildNode = [&](int32 NodeIndex, int32 Begin, int32 End)
+	{
+		FBox Bounds(ForceInit);
+		FBox CentroidBounds(ForceInit);
+		for (int32 RefIndex = Begin; RefIndex < End; RefIndex++)
+		{
+			Bounds += Refs[RefIndex].Bounds;
+			CentroidBounds += Refs[RefIndex].Centroid;
+		}
+
+		FWeaponBVHNode& Node = BuiltNodes[NodeIndex];
+		Node.Min[0] = Bounds.Min.X; Node.Min[1] = Bounds.Min.Y; Node.Min[2] = Bounds.Min.Z;
+		Node.Max[0] = Bounds.Max.X; Node.Max[1] = Bounds.Max.Y; Node.Max[2] = Bounds.Max.Z;
+
+		const FVector Extent = CentroidBounds.GetSize();
+		const int32 Axis = Extent.X >= Extent.Y && Extent.X >= Extent.Z ? 0 : (Extent.Y >= Extent.Z ? 1 : 2);
+
+		if (End - Begin <= MaxTrianglesPerLeaf || Extent[Axis] <= KINDA_SMALL_NUMBER)
+		{
+			Node.FirstIndex = Begin;
+			Node.Count = End - Begin;
+			return;
+		}
+
+		Sort(&Refs[Begin], End - Begin, [Axis](const FTriangleRef& A, const FTriangleRef& B) { return A.Centroid[Axis] < B.Centroid[Axis]; });
+
+		const int32 FirstChild = BuiltNodes.AddZeroed(2);
+		BuiltNodes[NodeIndex].FirstIndex = FirstChild;
+		BuiltNodes[NodeIndex].Count = 0;
+
+		const int32 Middle = (Begin + End) / 2;
+		BuildNode(FirstChild, Begin, Middle);
+		BuildNode(FirstChild + 1, Middle, End);
+	};
+
+	if (Refs.Num() > 0)
+	{
+		BuildNode(0, 0, Refs.Num());
+	}
+
+	FWeaponBVHHeader FileHeader;
+	FMemory::Memzero(FileHeader);
+	FileHeader.Magic = FWeaponBVHHeader::ExpectedMagic;
+	FileHeader.Version = FWeaponBVHHeader::ExpectedVersion;
+	FileHeader.NumNodes = BuiltNodes.Num();
+	FileHeader.NumTriangles = Refs.Num();
+	FileHeader.bCoversAllStatic = bCoversAllStatic ? 1 : 0;
+
+	IFileManager::Get().MakeDirectory(*FPaths::GetPath(Filename), true);
+	TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*Filename));
+	if (!Writer)
+	{
+		return false;
+	}
+
+	Writer->Serialize(&FileHeader, sizeof(FileHeader));
+	Writer->Serialize(BuiltNodes.GetData(), BuiltNodes.Num() * sizeof(FWeaponBVHNode));
+	for (const FTriangleRef& Ref : Refs)
+	{
+		Writer->Serialize(const_cast<FWeaponBVHTriangle*>(&InTriangles[Ref.Index]), sizeof(FWeaponBVHTriangle));
+	}
+
+	return Writer->Close();
+}
+
+
+EWeaponOcclusionResult FWeaponOcclusionBVH::Raycast(const FVector& Origin, const FVector& Direction, float MaxDistance, FWeaponOcclusionHit& OutHit) const
+{
+	if (!Header || Header->NumTriangles == 0)
+	{
+		return EWeaponOcclusionResult::Miss;
+	}
+
+	const FVector InvDirection(
+		FMath::Abs(Direction.X) > SMALL_NUMBER ? 1.f / Direction.X : BIG_NUMBER,
+		FMath::Abs(Direction.Y) > SMALL_NUMBER ? 1.f / Direction.Y : BIG_NUMBER,
+		FMath::Abs(Direction.Z) > SMALL_NUMBER ? 1.f / Direction.Z : BIG_NUMBER);
+
+	// Entry distance into a node box, or a value past BestDistance if missed
+	auto IntersectNode = [&](const FWeaponBVHNode& Node, float BestDistance) -> float
+	{
+		const float T0X = (Node.Min[0] - Origin.X) * InvDirection.X;
+		const float T1X = (Node.Max[0] - Origin.X) * InvDirection.X;
+		const float T0Y = (Node.Min[1] - Origin.Y) * InvDirection.Y;
+		const float T1Y = (Node.Max[1] - Origin.Y) * InvDirection.Y;
+		const float T0Z = (Node.Min[2] - Origin.Z) * InvDirection.Z;
+		const float T1Z = (Node.Max[2] - Origin.Z) * InvDirection.Z;
+
+		const float Enter = FMath::Max3(FMath::Min(T0X, T1X), FMath::Min(T0Y, T1Y), FMath::Min(T0Z, T1Z));
+		const float Exit = FMath::Min3(FMath::Max(T0X, T1X), FMath::Max(T0Y, T1Y), FMath::Max(T0Z, T1Z));
+		return (Exit >= FMath::Max(Enter, 0.f) && Enter <= BestDistance) ? FMath::Max(Enter, 0.f) : BIG_NUMBER;
+	};
+
+	float BestDistance = MaxDistance;
+	int32 BestTriangle = INDEX_NONE;
+
+	int32 Stack[64];
+	int32 StackSize = 0;
+	if (IntersectNode(Nodes[0], BestDistance) < BIG_NUMBER)
+	{
+		Stack[StackSize++] = 0;
+	}
+
+	while (StackSize > 0)
+	{
+		const FWeaponBVHNode& Node = Nodes[Stack[--StackSize]];
+
+		if (Node.Count > 0)
+		{
+			// Moller-Trumbore, double sided like complex collision
+			for (int32 Index = Node.FirstIndex; Index < Node.FirstIndex + Node.Count; Index++)
+			{
+				const FWeaponBVHTriangle& Triangle = Triangles[Index];
+				const FVector E1(Triangle.E1[0], Triangle.E1[1], Triangle.E1[2]);
+				const FVector E2(Triangle.E2[0], Triangle.E2[1], Triangle.E2[2]);
+
+				const FVector P = FVector::CrossProduct(Direction, E2);
+				const float Determinant = FVector::DotProduct(E1, P);
+				if (FMath::Abs(Determinant) < SMALL_NUMBER)
+				{
+					continue;
+				}
+
+				const float InvDeterminant = 1.f / Determinant;
+				const FVector T = Origin - FVector(Triangle.V0[0], Triangle.V0[1], Triangle.V0[2]);
+				const float U = FVector::DotProduct(T, P) * InvDeterminant;
+				if (U < 0.f || U > 1.f)
+				{
+					continue;
+				}
+
+				const FVector Q = FVector::CrossProduct(T, E1);
+				const float V = FVector::DotProduct(Direction, Q) * InvDeterminant;
+				if (V < 0.f || U + V > 1.f)
+				{
+					continue;
+				}
+
+				const float Distance = FVector::DotProduct(E2, Q) * InvDeterminant;
+				if (Distance >= 0.f && Distance < BestDistance)
+				{
+					BestDistance = Distance;
+					BestTriangle = Index;
+				}
+			}
+			continue;
+		}
+
+		// Visit the nearest child first so farther ones get culled by BestDistance
+		const int32 Left = Node.FirstIndex;
+		const int32 Right = Node.FirstIndex + 1;
+		const float LeftDistance = IntersectNode(Nodes[Left], BestDistance);
+		const float RightDistance = IntersectNode(Nodes[Right], BestDistance);
+
+		// Median splits keep the tree far shallower than the stack, a deeper one is a broken file
+		if (!ensureMsgf(StackSize + 2 <= ARRAY_COUNT(Stack), TEXT("Weapon occlusion BVH deeper than its traversal stack, tracing through physics instead")))
+		{
+			return EWeaponOcclusionResult::Incomplete;
+		}
+		if (LeftDistance <= RightDistance)
+		{
+			if (RightDistance < BIG_NUMBER) { Stack[StackSize++] = Right; }
+			if (LeftDistance < BIG_NUMBER) { Stack[StackSize++] = Left; }
+		}
+		else
+		{
+			if (LeftDistance < BIG_NUMBER) { Stack[StackSize++] = Left; }
+			if (RightDistance < BIG_NUMBER) { Stack[StackSize++] = Right; }
+		}
+	}
+
+	if (BestTriangle == INDEX_NONE)
+	{
+		return EWeaponOcclusionResult::Miss;
+	}
+
+	const FWeaponBVHTriangle& Triangle = Triangles[BestTriangle];
+	const FVector Normal = FVector::CrossProduct(FVector(Triangle.E1[0], Triangle.E1[1], Triangle.E1[2]), FVector(Triangle.E2[0], Triangle.E2[1], Triangle.E2[2])).GetSafeNormal();
+
+	OutHit.Distance = BestDistance;
+	OutHit.Normal = FVector::DotProduct(Normal, Direction) > 0.f ? -Normal : Normal;
+	OutHit.SurfaceType = (uint8)Triangle.SurfaceType;
+	return EWeaponOcclusionResult::Hit;
+}
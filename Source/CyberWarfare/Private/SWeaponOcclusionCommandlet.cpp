@@ -0,0 +1,229 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SWeaponOcclusionCommandlet.h"
+#include "SWeaponOcclusionBVH.h"
+#include "CyberWarfare.h"
+#include "EngineUtils.h"
+#include "Engine/World.h"
+#include "Engine/StaticMesh.h"
+#include "Components/StaticMeshComponent.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Interfaces/Interface_CollisionDataProvider.h"
+#include "PhysicsEngine/BodySetup.h"
+#include "PhysicalMaterials/PhysicalMaterial.h"
+#include "Materials/MaterialInterface.h"
+#include "UObject/Package.h"
+
+
+USWeaponOcclusionCommandlet::USWeaponOcclusionCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+}
+
+
+int32 USWeaponOcclusionCommandlet::Main(const FString& Params)
+{
+	FString MapName = TEXT("/Game/Maps/P_TestLevel");
+	FParse::Value(*Params, TEXT("map="), MapName);
+
+	int32 NumVerifyRays = 0;
+	FParse::Value(*Params, TEXT("verify="), NumVerifyRays);
+
+	const bool bBake = !FParse::Param(*Params, TEXT("nobake"));
+
+	UPackage* Package = LoadPackage(nullptr, *MapName, LOAD_None);
+	UWorld* World = Package ? UWorld::FindWorldInPackage(Package) : nullptr;
+	if (!World)
+	{
+		UE_LOG(LogCyberWarfare, Error, TEXT("Could not load map %s"), *MapName);
+		return 1;
+	}
+
+	// Only the static collision of the map is needed, no game and no rendering
+	World->AddToRoot();
+	World->WorldType = EWorldType::Editor;
+	World->InitWorld(UWorld::InitializationValues()
+		.CreatePhysicsScene(true)
+		.EnableTraceCollision(true)
+		.ShouldSimulatePhysics(false)
+		.CreateNavigation(false)
+		.CreateAISystem(false)
+		.AllowAudioPlayback(false)
+		.RequiresHitProxies(false));
+	World->UpdateWorldComponents(true, false);
+
+	const FString Filename = FWeaponOcclusionBVH::GetFilenameForMap(MapName);
+	int32 Result = 0;
+
+	if (bBake)
+	{
+		TArray<FWeaponBVHTriangle> Triangles;
+		const bool bCoversAllStatic = GatherStaticTriangles(World, Triangles);
+
+		if (FWeaponOcclusionBVH::BuildAndSave(Triangles, bCoversAllStatic, Filename))
+		{
+			UE_LOG(LogCyberWarfare, Display, TEXT("Baked %d triangles to %s (%s)"), Triangles.Num(), *Filename,
+				bCoversAllStatic ? TEXT("covers all static geometry") : TEXT("partial, physics still queried for static geometry"));
+		}
+		else
+		{
+			UE_LOG(LogCyberWarfare, Error, TEXT("Could not write %s"), *Filename);
+			Result = 1;
+		}
+	}
+
+	if (Result == 0 && NumVerifyRays > 0)
+	{
+		TSharedPtr<FWeaponOcclusionBVH> BVH = FWeaponOcclusionBVH::LoadFromFile(Filename);
+		if (!BVH.IsValid())
+		{
+			UE_LOG(LogCyberWarfare, Error, TEXT("Could not load %s"), *Filename);
+			Result = 1;
+		}
+		else
+		{
+			// Rays starting inside geometry can legitimately disagree, allow a tiny fraction of them
+			const int32 Mismatches = Verify(World, *BVH, NumVerifyRays);
+			UE_LOG(LogCyberWarfare, Display, TEXT("Verify: %d / %d rays disagree with the physics scene"), Mismatches, NumVerifyRays);
+			Result = Mismatches > NumVerifyRays / 200 ? 1 : 0;
+		}
+	}
+
+	World->DestroyWorld(false);
+	World->RemoveFromRoot();
+
+	return Result;
+}
+
+
+bool USWeaponOcclusionCommandlet::GatherStaticTriangles(UWorld* World, TArray<FWeaponBVHTriangle>& OutTriangles) const
+{
+	bool bCoversAllStatic = true;
+
+	for (TActorIterator<AActor> It(World); It; ++It)
+	{
+		TInlineComponentArray<UPrimitiveComponent*> Primitives;
+		It->GetComponents(Primitives);
+
+		// Stationary primitives are static bodies to the physics scene too, a Dynamic mobility query skips both
+		for (UPrimitiveComponent* Primitive : Primitives)
+		{
+			if (Primitive->Mobility == EComponentMobility::Movable
+				|| !CollisionEnabledHasQuery(Primitive->GetCollisionEnabled())
+				|| Primitive->GetCollisionResponseToChannel(COLLISION_WEAPON) != ECR_Block)
+			{
+				continue;
+			}
+
+			// Find the triangle data and the transforms it is placed with
+			IInterface_CollisionDataProvider* Provider = nullptr;
+			TArray<FTransform> Transforms;
+
+			if (UStaticMeshComponent* StaticMeshComp = Cast<UStaticMeshComponent>(Primitive))
+			{
+				Provider = StaticMeshComp->GetStaticMesh();
+
+				// Complex traces against such meshes hit the simple shapes, not the triangles
+				UBodySetup* BodySetup = StaticMeshComp->GetBodySetup();
+				if (BodySetup && BodySetup->GetCollisionTraceFlag() == CTF_UseSimpleAsComplex)
+				{
+					Provider = nullptr;
+				}
+
+				if (UInstancedStaticMeshComponent* InstancedComp = Cast<UInstancedStaticMeshComponent>(StaticMeshComp))
+				{
+					for (int32 Instance = 0; Instance < InstancedComp->GetInstanceCount(); Instance++)
+					{
+						FTransform InstanceTransform;
+						InstancedComp->GetInstanceTransform(Instance, InstanceTransform, true);
+						Transforms.Add(InstanceTransform);
+					}
+				}
+				else
+				{
+					Transforms.Add(StaticMeshComp->GetComponentTransform());
+				}
+			}
+			else
+			{
+				Provider = Cast<IInterface_CollisionDataProvider>(Primitive);
+				Transforms.Add(Primitive->GetComponentTransform());
+			}
+
+			FTriMeshCollisionData TriMesh;
+			if (!Provider || !Provider->ContainsPhysicsTriMeshData(true) || !Provider->GetPhysicsTriMeshData(&TriMesh, true))
+			{
+				UE_LOG(LogCyberWarfare, Warning, TEXT("Cannot bake %s, static geometry will still be traced through physics"), *Primitive->GetPathName());
+				bCoversAllStatic = false;
+				continue;
+			}
+
+			for (const FTransform& Transform : Transforms)
+			{
+				for (int32 Index = 0; Index < TriMesh.Indices.Num(); Index++)
+				{
+					const FTriIndices& Indices = TriMesh.Indices[Index];
+					const FVector V0 = Transform.TransformPosition(TriMesh.Vertices[Indices.v0]);
+					const FVector V1 = Transform.TransformPosition(TriMesh.Vertices[Indices.v1]);
+					const FVector V2 = Transform.TransformPosition(TriMesh.Vertices[Indices.v2]);
+
+					const int32 MaterialIndex = TriMesh.MaterialIndices.IsValidIndex(Index) ? TriMesh.MaterialIndices[Index] : 0;
+					UMaterialInterface* Material = Primitive->GetMaterial(MaterialIndex);
+
+					FWeaponBVHTriangle& Triangle = OutTriangles[OutTriangles.AddUninitialized()];
+					Triangle.V0[0] = V0.X; Triangle.V0[1] = V0.Y; Triangle.V0[2] = V0.Z;
+					Triangle.E1[0] = V1.X - V0.X; Triangle.E1[1] = V1.Y - V0.Y; Triangle.E1[2] = V1.Z - V0.Z;
+					Triangle.E2[0] = V2.X - V0.X; Triangle.E2[1] = V2.Y - V0.Y; Triangle.E2[2] = V2.Z - V0.Z;
+					Triangle.SurfaceType = UPhysicalMaterial::DetermineSurfaceType(Material ? Material->GetPhysicalMaterial() : nullptr);
+				}
+			}
+		}
+	}
+
+	return bCoversAllStatic;
+}
+
+
+int32 USWeaponOcclusionCommandlet::Verify(UWorld* World, const FWeaponOcclusionBVH& BVH, int32 NumRays) const
+{
+	FRandomStream Random(42);
+	const FBox Bounds = BVH.GetBounds();
+	const float TraceLength = 10000.f;
+
+	// Same query as the weapons, restricted to what the BVH replaces
+	FCollisionQueryParams QueryParams;
+	QueryParams.bTraceComplex = true;
+	QueryParams.MobilityType = EQueryMobilityType::Static;
+
+	int32 Mismatches = 0;
+	double PhysicsTime = 0.0;
+	double BVHTime = 0.0;
+
+	for (int32 RayIndex = 0; RayIndex < NumRays; RayIndex++)
+	{
+		const FVector Origin = Random.RandPointInBox(Bounds);
+		const FVector Direction = Random.GetUnitVector();
+
+		double StartTime = FPlatformTime::Seconds();
+		FHitResult PhysicsHit;
+		const bool bPhysicsHit = World->LineTraceSingleByChannel(PhysicsHit, Origin, Origin + Direction * TraceLength, COLLISION_WEAPON, QueryParams);
+		PhysicsTime += FPlatformTime::Seconds() - StartTime;
+
+		StartTime = FPlatformTime::Seconds();
+		FWeaponOcclusionHit BVHHit;
+		const EWeaponOcclusionResult BVHResult = BVH.Raycast(Origin, Direction, TraceLength, BVHHit);
+		const bool bBVHHit = BVHResult == EWeaponOcclusionResult::Hit;
+		BVHTime += FPlatformTime::Seconds() - StartTime;
+
+		if (BVHResult == EWeaponOcclusionResult::Incomplete || bPhysicsHit != bBVHHit || (bPhysicsHit && FMath::Abs(PhysicsHit.Distance - BVHHit.Distance) > 1.f))
+		{
+			Mismatches++;
+		}
+	}
+
+	UE_LOG(LogCyberWarfare, Display, TEXT("Verify: physics %.0f rays/s, BVH %.0f rays/s"), NumRays / FMath::Max(PhysicsTime, 1e-9), NumRays / FMath::Max(BVHTime, 1e-9));
+	return Mismatches;
+}
@@ -0,0 +1,430 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "CyberWarfare.h"
+#include "SAllocationCounter.h"
+#include "SCharacter.h"
+#include "SWeapon.h"
+#include "Public/Components/SHealthComponent.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "Misc/CommandLine.h"
+#include "Misc/ConfigCacheIni.h"
+#include "Misc/Paths.h"
+
+
+/** Result of one benchmark, best of its runs */
+struct FBenchmarkResult
+{
+	double NanosecondsPerOp;
+	double AllocationsPerOp;
+};
+
+
+/**
+ * Runs gameplay functions in a bare game world, compares their cost to the baseline and reports regressions.
+ * Baseline: Config/Benchmarks/GameplayBenchmarks.ini, or -BenchmarkBaseline=<file>. A missing entry is a warning until the
+ * baselines are recorded (an error with -BenchmarkRequireBaseline), -BenchmarkUpdateBaseline records the current run instead
+ * of comparing. -BenchmarkThreshold=<ratio> (default 0.2).
+ * Allocations are only counted and compared with -CountAllocations (see AllocationCounter).
+ */
+struct FGameplayBenchmark
+{
+	/** Timed runs per benchmark, the fastest one is kept to filter out noise */
+	static const int32 NumRuns = 5;
+
+	explicit FGameplayBenchmark(FAutomationTestBase& InTest)
+		: Test(InTest)
+		, World(nullptr)
+		, Threshold(0.2f)
+		, bUpdateBaseline(FParse::Param(FCommandLine::Get(), TEXT("BenchmarkUpdateBaseline")))
+		, bRequireBaseline(FParse::Param(FCommandLine::Get(), TEXT("BenchmarkRequireBaseline")))
+	{
+		FParse::Value(FCommandLine::Get(), TEXT("BenchmarkThreshold="), Threshold);
+
+		if (!FParse::Value(FCommandLine::Get(), TEXT("BenchmarkBaseline="), BaselinePath))
+		{
+			BaselinePath = FPaths::ProjectConfigDir() / TEXT("Benchmarks/GameplayBenchmarks.ini");
+		}
+		Baseline.Read(BaselinePath);
+
+		// The characters and weapons of the game, with the meshes their hitboxes and muzzles need
+		CharacterClass = LoadClass<ASCharacter>(nullptr, TEXT("/Game/Blueprints/BP_PlayerPawn.BP_PlayerPawn_C"));
+		WeaponClass = LoadClass<ASWeapon>(nullptr, TEXT("/Game/Blueprints/BP_Rifle.BP_Rifle_C"));
+		if (!CharacterClass || !WeaponClass)
+		{
+			Test.AddError(TEXT("Could not load BP_PlayerPawn or BP_Rifle, the benchmarks fall back on the bare native classes"));
+			CharacterClass = ASCharacter::StaticClass();
+			WeaponClass = ASWeapon::StaticClass();
+		}
+
+		World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("GameplayBenchmarkWorld"));
+		FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+		WorldContext.SetCurrentWorld(World);
+
+		World->InitializeActorsForPlay(FURL());
+		World->BeginPlay();
+	}
+
+	~FGameplayBenchmark()
+	{
+		GEngine->DestroyWorldContext(World);
+		World->DestroyWorld(false);
+
+		if (bUpdateBaseline && Baseline.Dirty)
+		{
+			Baseline.Write(BaselinePath);
+		}
+	}
+
+	ASCharacter* SpawnCharacter(const FVector& Location)
+	{
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		return World->SpawnActor<ASCharacter>(CharacterClass, Location, FRotator::ZeroRotator, SpawnParams);
+	}
+
+	ASWeapon* SpawnWeapon(ASCharacter* Owner)
+	{
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		SpawnParams.Owner = Owner;
+		SpawnParams.Instigator = Owner;
+		return World->SpawnActor<ASWeapon>(WeaponClass, FVector::ZeroVector, FRotator::ZeroRotator, SpawnParams);
+	}
+
+	/**
+	 * Times Op over NumOps calls, in batches of BatchSize calls with an untimed Reset between two batches,
+	 * then checks the result against the baseline.
+	 */
+	template<typename OpType, typename ResetType>
+	void Run(const FString& Name, int32 NumOps, int32 BatchSize, OpType Op, ResetType Reset)
+	{
+		// Warm caches and one-time allocations up
+		Reset();
+		for (int32 Index = 0; Index < FMath::Min(BatchSize, NumOps); Index++)
+		{
+			Op(Index);
+		}
+
+		FBenchmarkResult Best = { DBL_MAX, DBL_MAX };
+		const bool bCountAllocations = AllocationCounter::IsCounting();
+
+		for (int32 RunIndex = 0; RunIndex < NumRuns; RunIndex++)
+		{
+			uint64 Cycles = 0;
+			uint64 NumAllocations = 0;
+
+			for (int32 BatchStart = 0; BatchStart < NumOps; BatchStart += BatchSize)
+			{
+				Reset();
+
+				const uint64 StartAllocations = AllocationCounter::GetGameThreadAllocations();
+				const int32 BatchEnd = FMath::Min(BatchStart + BatchSize, NumOps);
+				const uint64 StartCycles = FPlatformTime::Cycles64();
+				for (int32 Index = BatchStart; Index < BatchEnd; Index++)
+				{
+					Op(Index);
+				}
+				Cycles += FPlatformTime::Cycles64() - StartCycles;
+				NumAllocations += AllocationCounter::GetGameThreadAllocations() - StartAllocations;
+			}
+
+			Best.NanosecondsPerOp = FMath::Min(Best.NanosecondsPerOp, FPlatformTime::ToSeconds64(Cycles) * 1e9 / NumOps);
+			Best.AllocationsPerOp = FMath::Min(Best.AllocationsPerOp, (double)NumAllocations / NumOps);
+		}
+
+		Compare(Name, Best, bCountAllocations);
+	}
+
+	void Compare(const FString& Name, const FBenchmarkResult& Result, bool bCountAllocations)
+	{
+		static const TCHAR* Section = TEXT("GameplayBenchmarks");
+		const FString TimeKey = Name + TEXT(".NsPerOp");
+		const FString AllocationsKey = Name + TEXT(".AllocsPerOp");
+
+		if (bUpdateBaseline)
+		{
+			Test.AddInfo(FString::Printf(TEXT("%s: %.1f ns/op, %.2f allocs/op (recorded as baseline)"), *Name, Result.NanosecondsPerOp, Result.AllocationsPerOp));
+
+			Baseline.SetString(Section, *TimeKey, *FString::Printf(TEXT("%.1f"), Result.NanosecondsPerOp));
+			if (bCountAllocations)
+			{
+				Baseline.SetString(Section, *AllocationsKey, *FString::Printf(TEXT("%.2f"), Result.AllocationsPerOp));
+			}
+			else
+			{
+				Test.AddWarning(FString::Printf(TEXT("%s: allocations not recorded, run with -CountAllocations"), *Name));
+			}
+			Baseline.Dirty = true;
+			return;
+		}
+
+		// A benchmark without a baseline passes whatever it costs, say so loudly
+		FString BaselineTime;
+		FString BaselineAllocations;
+		if (!Baseline.GetString(Section, *TimeKey, BaselineTime) || (bCountAllocations && !Baseline.GetString(Section, *AllocationsKey, BaselineAllocations)))
+		{
+			const FString Message = FString::Printf(TEXT("%s has no baseline in %s (%.1f ns/op, %.2f allocs/op), record it with -BenchmarkUpdateBaseline on the reference machine"),
+				*Name, *BaselinePath, Result.NanosecondsPerOp, Result.AllocationsPerOp);
+			if (bRequireBaseline)
+			{
+				Test.AddError(Message);
+			}
+			else
+			{
+				Test.AddWarning(Message);
+			}
+			return;
+		}
+
+		const double BaselineNs = FCString::Atod(*BaselineTime);
+
+		Test.AddInfo(FString::Printf(TEXT("%s: %.1f ns/op (baseline %.1f)"), *Name, Result.NanosecondsPerOp, BaselineNs));
+
+		if (Result.NanosecondsPerOp > BaselineNs * (1.0 + Threshold))
+		{
+			Test.AddError(FString::Printf(TEXT("%s regressed: %.1f ns/op against %.1f ns/op (threshold %.0f%%)"),
+				*Name, Result.NanosecondsPerOp, BaselineNs, Threshold * 100.f));
+		}
+
+		if (!bCountAllocations)
+		{
+			return;
+		}
+
+		const double BaselineAllocs = FCString::Atod(*BaselineAllocations);
+
+		Test.AddInfo(FString::Printf(TEXT("%s: %.2f allocs/op (baseline %.2f)"), *Name, Result.AllocationsPerOp, BaselineAllocs));
+
+		// Allocation counts are deterministic, a small absolute slack covers one-off allocations amortized over the run
+		if (Result.AllocationsPerOp > BaselineAllocs * (1.0 + Threshold) + 0.01)
+		{
+			Test.AddError(FString::Printf(TEXT("%s regressed: %.2f allocs/op against %.2f allocs/op"),
+				*Name, Result.AllocationsPerOp, BaselineAllocs));
+		}
+	}
+
+	/** ASWeapon::Fire from a character facing NumTargets characters lined up in front of it */
+	void RunWeaponFire(int32 NumTargets)
+	{
+		ASCharacter* Shooter = SpawnCharacter(FVector::ZeroVector);
+		ASWeapon* Weapon = SpawnWeapon(Shooter);
+
+		// In the shooter's hands, so the shots leave from the muzzle at chest height
+		Shooter->NewWeapon = Weapon;
+		Shooter->EquipNewWeapon();
+
+		TArray<ASCharacter*> Targets;
+		for (int32 Index = 0; Index < NumTargets; Index++)
+		{
+			// Rows of four, the first one of each row right in the line of fire, the others on both sides of it
+			const float Side = 60.f * ((Index % 4 + 1) / 2) * (Index % 2 ? -1.f : 1.f);
+
+			// Hits stay the same from op to op, the targets never die
+			ASCharacter* Target = SpawnCharacter(FVector(300.f + 100.f * (Index / 4), Side, 0.f));
+			Target->bCanBeDamaged = false;
+			Targets.Add(Target);
+		}
+
+		FWeaponShot Shot;
+		Shot.AimRotation = FRotator::ZeroRotator;
+
+		// A benchmark of shots that miss would not be testing the hitboxes
+		int32 NumHits = 0;
+
+		const int32 NumOps = 2000;
+		Run(FString::Printf(TEXT("WeaponFire.%d"), NumTargets), NumOps, NumOps,
+			[&](int32 Index)
+			{
+				Shot.ShotTime = World->TimeSeconds;
+				const bool bFired = Weapon->Fire(Shot);
+				NumHits += bFired && Weapon->bLastShotHitCharacter ? 1 : 0;
+			},
+			[&]()
+			{
+				// Never empty the clip, reloading is not part of this benchmark
+				Weapon->ClipCurrentSize = NumOps + 1;
+			});
+
+		Test.TestTrue(FString::Printf(TEXT("WeaponFire.%d hits its targets (%d hits)"), NumTargets, NumHits), NumHits > 0);
+
+		for (ASCharacter* Target : Targets)
+		{
+			Target->Destroy();
+		}
+		Weapon->Destroy();
+		Shooter->Destroy();
+	}
+
+	/** HandleTakeAnyDamage through the damage delegate, with small hits that never kill */
+	void RunTakeAnyDamage()
+	{
+		ASCharacter* Target = SpawnCharacter(FVector::ZeroVector);
+		USHealthComponent* HealthComp = Target->FindComponentByClass<USHealthComponent>();
+
+		Run(TEXT("TakeAnyDamage"), 20000, 1000,
+			[&](int32 Index)
+			{
+				Target->OnTakeAnyDamage.Broadcast(Target, 0.01f, nullptr, nullptr, nullptr);
+			},
+			[&]()
+			{
+				HealthComp->ResetHealth();
+			});
+
+		Target->Destroy();
+	}
+
+	/** TickShield round robin over many health components, with their shields regenerating */
+	void RunTickShield()
+	{
+		const int32 NumCharacters = 64;
+
+		TArray<USHealthComponent*> HealthComps;
+		TArray<ASCharacter*> Characters;
+		for (int32 Index = 0; Index < NumCharacters; Index++)
+		{
+			ASCharacter* Character = SpawnCharacter(FVector(200.f * Index, 0.f, 0.f));
+			Characters.Add(Character);
+			HealthComps.Add(Character->FindComponentByClass<USHealthComponent>());
+		}
+
+		Run(TEXT("TickShield"), NumCharacters * 500, NumCharacters * 500,
+			[&](int32 Index)
+			{
+				HealthComps[Index % NumCharacters]->TickShield(1.f / 30.f);
+			},
+			[&]()
+			{
+				// Empty shields, regeneration kicks in after TimeBeforeShieldRegen of ticks
+				for (int32 Index = 0; Index < NumCharacters; Index++)
+				{
+					HealthComps[Index]->ResetHealth();
+					Characters[Index]->OnTakeAnyDamage.Broadcast(Characters[Index], 100.f, nullptr, nullptr, nullptr);
+				}
+			});
+
+		for (ASCharacter* Character : Characters)
+		{
+			Character->Destroy();
+		}
+	}
+
+	/** EquipNewWeapon swapping back and forth between two weapons */
+	void RunEquipNewWeapon()
+	{
+		ASCharacter* Character = SpawnCharacter(FVector::ZeroVector);
+		ASWeapon* Weapons[2] = { SpawnWeapon(Character), SpawnWeapon(Character) };
+
+		Run(TEXT("EquipNewWeapon"), 2000, 2000,
+			[&](int32 Index)
+			{
+				Character->NewWeapon = Weapons[Index % 2];
+				Character->EquipNewWeapon();
+			},
+			[&]()
+			{
+			});
+
+		Character->Destroy();
+		Weapons[0]->Destroy();
+		Weapons[1]->Destroy();
+	}
+
+	/** Spawning a full inventory once the weapon class is loaded (SpawnInventorySlots) */
+	void RunSpawnInventory()
+	{
+		ASCharacter* Character = SpawnCharacter(FVector::ZeroVector);
+		const TSoftClassPtr<ASWeapon> InventoryClass(WeaponClass.Get());
+
+		Run(TEXT("SpawnInventory"), 100, 1,
+			[&](int32 Index)
+			{
+				Character->SpawnInventorySlots(InventoryClass, 0, Character->InventorySize - 1);
+			},
+			[&]()
+			{
+				for (ASWeapon* Weapon : Character->Inventory)
+				{
+					if (Weapon)
+					{
+						Weapon->Destroy();
+					}
+				}
+
+				Character->CurrentWeapon = nullptr;
+				Character->NewWeapon = nullptr;
+				Character->Inventory.Reset();
+				Character->Inventory.SetNumZeroed(Character->InventorySize);
+			});
+
+		Character->Destroy();
+	}
+
+	FAutomationTestBase& Test;
+	TSubclassOf<ASCharacter> CharacterClass;
+	TSubclassOf<ASWeapon> WeaponClass;
+	UWorld* World;
+	FConfigFile Baseline;
+	FString BaselinePath;
+	float Threshold;
+	bool bUpdateBaseline;
+	bool bRequireBaseline;
+};
+
+
+static const uint32 GameplayBenchmarkFlags = EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter;
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FWeaponFireBenchmark, "CyberWarfare.Benchmarks.WeaponFire", GameplayBenchmarkFlags)
+bool FWeaponFireBenchmark::RunTest(const FString& Parameters)
+{
+	FGameplayBenchmark Benchmark(*this);
+	Benchmark.RunWeaponFire(1);
+	Benchmark.RunWeaponFire(8);
+	Benchmark.RunWeaponFire(32);
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTakeAnyDamageBenchmark, "CyberWarfare.Benchmarks.TakeAnyDamage", GameplayBenchmarkFlags)
+bool FTakeAnyDamageBenchmark::RunTest(const FString& Parameters)
+{
+	FGameplayBenchmark Benchmark(*this);
+	Benchmark.RunTakeAnyDamage();
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTickShieldBenchmark, "CyberWarfare.Benchmarks.TickShield", GameplayBenchmarkFlags)
+bool FTickShieldBenchmark::RunTest(const FString& Parameters)
+{
+	FGameplayBenchmark Benchmark(*this);
+	Benchmark.RunTickShield();
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FEquipNewWeaponBenchmark, "CyberWarfare.Benchmarks.EquipNewWeapon", GameplayBenchmarkFlags)
+bool FEquipNewWeaponBenchmark::RunTest(const FString& Parameters)
+{
+	FGameplayBenchmark Benchmark(*this);
+	Benchmark.RunEquipNewWeapon();
+	return true;
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSpawnInventoryBenchmark, "CyberWarfare.Benchmarks.SpawnInventory", GameplayBenchmarkFlags)
+bool FSpawnInventoryBenchmark::RunTest(const FString& Parameters)
+{
+	FGameplayBenchmark Benchmark(*this);
+	Benchmark.RunSpawnInventory();
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,38 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "SCharacterMovementComponent.generated.h"
+
+
+/**
+ * Character movement of our characters, counts the position corrections the server sends to the owning client and records
+ * the moves the server receives
+ */
+UCLASS()
+class CYBERWARFARE_API USCharacterMovementComponent : public UCharacterMovementComponent
+{
+	GENERATED_BODY()
+
+public:
+
+	USCharacterMovementComponent();
+
+	/** Counts the correction before applying it */
+	virtual void ClientAdjustPosition_Implementation(float TimeStamp, FVector NewLoc, FVector NewVel, UPrimitiveComponent* NewBase, FName NewBaseBoneName, bool bHasBase, bool bBaseRelativePosition, uint8 ServerMovementMode) override;
+
+	/** Returns the number of position corrections received since this component was created */
+	int32 GetNumCorrections() const;
+
+	/** Performs a recorded client move on the server (input replay) */
+	void ReplayMove(float ClientTimeStamp, float DeltaTime, uint8 CompressedFlags, const FVector& NewAccel);
+
+protected:
+
+	/** Records moves of remote clients before performing them */
+	virtual void MoveAutonomous(float ClientTimeStamp, float DeltaTime, uint8 CompressedFlags, const FVector& NewAccel) override;
+
+	int32 NumCorrections;
+};
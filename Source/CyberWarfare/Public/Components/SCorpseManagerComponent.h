@@ -0,0 +1,58 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "SCorpseManagerComponent.generated.h"
+
+class ASCharacter;
+
+
+/** A dead character and the time it died */
+struct FCorpseEntry
+{
+	TWeakObjectPtr<ASCharacter> Character;
+	float DeathTime;
+};
+
+
+/**
+ * Keeps the number of corpses in the world under budget (server only).
+ * Corpses freeze themselves once settled, this evicts them after CorpseTime, or oldest first when over MaxCorpses.
+ */
+UCLASS(ClassGroup=(COOP), meta=(BlueprintSpawnableComponent))
+class CYBERWARFARE_API USCorpseManagerComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+
+	/** Sets default values for this component's properties */
+	USCorpseManagerComponent();
+
+	/** Starts tracking a character that just died, evicting the oldest corpses if we are over budget */
+	void AddCorpse(ASCharacter* Character);
+
+	/** Returns the number of corpses currently in the world */
+	int32 GetNumCorpses() const;
+
+	/** Evicts expired corpses */
+	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+protected:
+
+	/** Removes a corpse from the world, the game mode decides whether it goes back to its pawn pool */
+	void EvictCorpse(int32 Index);
+
+	/** Maximum number of corpses in the world at once */
+	UPROPERTY(EditDefaultsOnly, Category = "Corpses")
+		int32 MaxCorpses;
+
+	/** How long a corpse stays in the world */
+	UPROPERTY(EditDefaultsOnly, Category = "Corpses")
+		float CorpseTime;
+
+	/** Oldest first */
+	TArray<FCorpseEntry> Corpses;
+};
@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
+#include "SGameplayRules.h"
 #include "SHealthComponent.generated.h"
 
 /** On health changed event */
@@ -23,6 +24,21 @@ public:
 	/** Called every tick by of our owner to update our shield (NOTE: this should only be called on the server) */
 	void TickShield(float DeltaTime);
 
+	/** Puts health and shield back to their defaults (used when a pooled character respawns) */
+	void ResetHealth();
+
+	/** Flags Health or Shield as changed, our owner skips replicating us while nothing changed */
+	void MarkReplicationDirty();
+
+	/** Returns true if Channel has not compared our latest changes yet (always on a new channel), and records them as compared */
+	bool ConsumeReplicationDirty(const class UActorChannel* Channel, bool bNetInitial);
+
+	/** Number of properties a skipped replication pass did not compare */
+	int32 GetNumReplicatedProperties() const;
+
+	/** Folds health, shield and regen timer into Crc (deterministic mode) */
+	uint32 GetStateHash(uint32 Crc) const;
+
 	/** Health change signature */
 	UPROPERTY(BlueprintAssignable, Category = "Events")
 		FOnHealthChangedSignature OnHealthChanged;
@@ -59,6 +75,22 @@ protected:
 	UPROPERTY(Replicated, BlueprintReadOnly, Category = "HealthComponent")
 		float Shield;
 
+	/** Bumped every time a replicated property changes */
+	uint32 ReplicationSerial;
+
+	/** Serial each connection last compared, and when (a reopened channel starts over with bNetInitial) */
+	struct FReplicationSerialSent
+	{
+		uint32 Serial;
+		float Time;
+	};
+	TMap<TWeakObjectPtr<class UNetConnection>, FReplicationSerialSent> ReplicationSerialsSent;
+
+	/** Our tuning and state for the combat rules */
+	GameplayRules::FHealthSettings GetHealthSettings() const;
+	GameplayRules::FHealthState GetHealthState() const;
+	void SetHealthState(const GameplayRules::FHealthState& State);
+
 	/** Handles damage taken */
 	UFUNCTION()
 		void HandleTakeAnyDamage(AActor* DamagedActor, float Damage, const class UDamageType* DamageType, class AController* InstigatedBy, AActor* DamageCauser);
@@ -0,0 +1,107 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "SNetClockComponent.generated.h"
+
+
+/**
+ * Estimates the server world time on the owning client of a player controller.
+ * Exchanges timestamped unreliable pings, keeps the samples with the lowest round trip and fits offset and drift on them.
+ */
+UCLASS(ClassGroup=(COOP), meta=(BlueprintSpawnableComponent))
+class CYBERWARFARE_API USNetClockComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+
+	/** Sets default values for this component's properties */
+	USNetClockComponent();
+
+	/** Sends the pings (owning client only) */
+	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	/** Returns the estimated server world time right now (the actual world time on the server) */
+	UFUNCTION(BlueprintCallable, Category = "NetClock")
+		float GetServerTime() const;
+
+	/** Converts a world time of this machine to the server world time */
+	float LocalToServerTime(float LocalWorldTime) const;
+
+	/** Returns true once enough pings came back to trust the estimate */
+	bool IsSynchronized() const;
+
+	/** Returns the lowest round trip time among the samples we keep */
+	float GetMinRoundTripTime() const;
+
+	/** Returns the estimated drift of the server clock against ours, in seconds per second */
+	double GetDrift() const;
+
+	/** Server world time for gameplay code anywhere: the world time on servers, the local player's estimate on clients */
+	static float GetServerWorldTime(const UWorld* World);
+
+	/** Converts a local world time to the server world time, see GetServerWorldTime */
+	static float LocalToServerWorldTime(const UWorld* World, float LocalWorldTime);
+
+	/** Returns the clock of the first local player, if any */
+	static const USNetClockComponent* FindLocal(const UWorld* World);
+
+protected:
+
+	/** Called when the game starts */
+	virtual void BeginPlay() override;
+
+	/** Ping, ClientTime is echoed back (doubles, a float is down to milliseconds after a few hours) */
+	UFUNCTION(Server, Unreliable, WithValidation)
+		void ServerRequestTime(double ClientTime);
+
+	/** Pong with the server world time at the moment the ping was processed */
+	UFUNCTION(Client, Unreliable)
+		void ClientReceiveTime(double ClientTime, double ServerTime);
+
+	/** Refits offset and drift on the samples close to the lowest round trip */
+	void UpdateEstimate();
+
+	/** Our time base, seconds since ClockStartTime */
+	double GetClockTime() const;
+
+	/** One ping: the local time half way through the round trip, and server time minus local time at that moment */
+	struct FClockSample
+	{
+		double LocalTime;
+		double Offset;
+		float RoundTripTime;
+	};
+
+	/** Ring buffer of the last samples */
+	TArray<FClockSample> Samples;
+	int32 NextSampleIndex;
+
+	/** Pings sent quickly after joining, before settling on RequestInterval */
+	UPROPERTY(EditDefaultsOnly, Category = "NetClock")
+		int32 NumBurstRequests;
+
+	UPROPERTY(EditDefaultsOnly, Category = "NetClock")
+		float BurstInterval;
+
+	UPROPERTY(EditDefaultsOnly, Category = "NetClock")
+		float RequestInterval;
+
+	/** Number of samples kept for the estimate */
+	UPROPERTY(EditDefaultsOnly, Category = "NetClock")
+		int32 MaxSamples;
+
+	double ClockStartTime;
+	double NextRequestTime;
+	int32 NumRequestsSent;
+
+	/** Estimate: server time = local time + Offset + Drift * (local time - ReferenceTime) */
+	double EstimateReferenceTime;
+	double EstimateOffset;
+	double EstimateDrift;
+	bool bHasEstimate;
+	float MinRoundTripTime;
+};
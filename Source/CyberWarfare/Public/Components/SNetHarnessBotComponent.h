@@ -0,0 +1,86 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "SShotLatencyComponent.h"
+#include "SNetHarnessBotComponent.generated.h"
+
+class ASCharacter;
+
+
+/**
+ * Harness bot of a headless client (-NetHarnessBot): strafes, aims at the closest enemy with a seeded wobble and fires bursts.
+ * Reports hit registration, corrections, bandwidth, shot latency and how often the other characters got updated (in view and
+ * out of view) once the scenario is over, then quits.
+ */
+UCLASS(ClassGroup=(COOP))
+class CYBERWARFARE_API USNetHarnessBotComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+
+	/** Sets default values for this component's properties */
+	USNetHarnessBotComponent();
+
+	/** Plays the scenario on the owning local player controller */
+	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+protected:
+
+	/** Called when the game starts */
+	virtual void BeginPlay() override;
+
+	/** Returns the closest living character other than ours */
+	ASCharacter* FindTarget(const ASCharacter* Character) const;
+
+	/** Samples the bandwidth of our connection, once per second */
+	void SampleBandwidth();
+
+	/** Records the time between two updates of every other character that just got one */
+	void SampleUpdateGaps(const ASCharacter* Character);
+
+	/** Writes the client report and quits */
+	void FinishScenario();
+
+	/** Length of a fire cycle, and the part of it spent firing */
+	UPROPERTY(EditDefaultsOnly, Category = "NetHarness")
+		float FireCycle;
+	UPROPERTY(EditDefaultsOnly, Category = "NetHarness")
+		float FireDutyCycle;
+
+	/** Largest aim error (degrees) of the wobble around the target */
+	UPROPERTY(EditDefaultsOnly, Category = "NetHarness")
+		float AimError;
+
+	/** Strafe cycles per second */
+	UPROPERTY(EditDefaultsOnly, Category = "NetHarness")
+		float StrafeFrequency;
+
+	FRandomStream Random;
+	float StartTime;
+	float Duration;
+	float NextRestartTime;
+	float NextBandwidthSampleTime;
+	float AimPhase;
+	bool bFiring;
+	bool bFinished;
+
+	/** Corrections of the characters we played so far (pooled characters change between lives) */
+	TWeakObjectPtr<ASCharacter> CorrectedCharacter;
+	int32 LastNumCorrections;
+	int32 NumCorrections;
+
+	/** Time between two updates of the characters in our view cone, and of the others */
+	FLatencyHistogram InViewUpdateGaps;
+	FLatencyHistogram OutOfViewUpdateGaps;
+	TMap<TWeakObjectPtr<ASCharacter>, float> LastUpdateTimes;
+
+	int64 InBytesPerSecondSum;
+	int64 OutBytesPerSecondSum;
+	int32 MaxInBytesPerSecond;
+	int32 MaxOutBytesPerSecond;
+	int32 NumBandwidthSamples;
+};
@@ -0,0 +1,66 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "SNetHarnessMonitorComponent.generated.h"
+
+class UNetConnection;
+
+
+/**
+ * Server side of a harness run (-NetHarness on the server): tracks bandwidth, reliable buffers and disconnects of every
+ * client connection, writes the server report once the scenario and a grace period are over, then quits.
+ * With -NetHarnessRate every client connection is held to that rate.
+ */
+UCLASS(ClassGroup=(COOP))
+class CYBERWARFARE_API USNetHarnessMonitorComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+
+	/** Sets default values for this component's properties */
+	USNetHarnessMonitorComponent();
+
+	/** Watches the reliable buffers every frame and samples the bandwidth every second */
+	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+protected:
+
+	/** Called when the game starts */
+	virtual void BeginPlay() override;
+
+	/** Writes the server report and quits */
+	void FinishScenario();
+
+	struct FConnectionStats
+	{
+		TWeakObjectPtr<UNetConnection> Connection;
+		FString Name;
+		int64 InBytesPerSecondSum;
+		int64 OutBytesPerSecondSum;
+		int32 MaxInBytesPerSecond;
+		int32 MaxOutBytesPerSecond;
+		int32 NumBandwidthSamples;
+		/** Most reliable bunches waiting for an ack in one channel */
+		int32 MaxReliableBuffered;
+		/** Times a channel filled its reliable buffer (the engine closes the connection when it overflows) */
+		int32 ReliableBufferFull;
+		bool bReliableBufferWasFull;
+		bool bDisconnected;
+	};
+
+	/** Returns the stats of Connection, new connections get an entry */
+	FConnectionStats& FindOrAddStats(UNetConnection* Connection);
+
+	/** Clients report first, the server waits this long after the scenario before reporting */
+	UPROPERTY(EditDefaultsOnly, Category = "NetHarness")
+		float ReportGraceTime;
+
+	TArray<FConnectionStats> ConnectionStats;
+	float StartTime;
+	float NextBandwidthSampleTime;
+	bool bFinished;
+};
@@ -0,0 +1,154 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "SShotLatencyComponent.generated.h"
+
+
+/** Stages of the fire and reload paths measured on the shooter's machine */
+enum class EShotLatencyStage : uint8
+{
+	/** Trigger pressed to the first shot of the pull fired locally */
+	InputToFire,
+	/** Shot fired locally to ServerFire running on the server (server clock estimate) */
+	FireToServer,
+	/** ServerFire running to its damage applied on the server */
+	ServerToDamage,
+	/** Shot fired locally to its confirmation received */
+	FireToConfirm,
+	/** Trigger pressed to the confirmation of the first shot of the pull */
+	InputToConfirm,
+	/** Reload pressed to the server accepting it */
+	ReloadToConfirm,
+	Num
+};
+
+
+/** Fixed bucket latency histogram, in milliseconds */
+struct FLatencyHistogram
+{
+	static const int32 NumBuckets = 16;
+
+	/** Upper bound (ms) of every bucket but the last one, which takes everything above */
+	static const float BucketLimits[NumBuckets - 1];
+
+	FLatencyHistogram();
+
+	void Add(float Milliseconds);
+
+	void Reset();
+
+	/** Returns the upper bound of the bucket holding the given percentile (0..1), clamped to the largest sample */
+	float GetPercentile(float Percentile) const;
+
+	float GetMean() const;
+
+	int32 Buckets[NumBuckets];
+	int32 Count;
+	double Sum;
+	float Min;
+	float Max;
+};
+
+
+/** Client-seen hits against server-confirmed hits */
+struct FHitRegistrationStats
+{
+	FHitRegistrationStats()
+		: ConfirmedShots(0)
+		, LostShots(0)
+		, ClientHits(0)
+		, ServerHits(0)
+		, AgreedHits(0)
+	{
+	}
+
+	/** Shots the server confirmed, and shots it never did (dropped RPC or confirmation) */
+	int32 ConfirmedShots;
+	int32 LostShots;
+
+	/** Confirmed shots that hit a character on the client, on the server, and on both */
+	int32 ClientHits;
+	int32 ServerHits;
+	int32 AgreedHits;
+};
+
+
+/**
+ * Measures where the milliseconds of a shot go, from the trigger to the server confirmation, on the owning client
+ * of a player controller. Shots are matched to their confirmations by the shot id they carry to the server.
+ */
+UCLASS(ClassGroup=(COOP), meta=(BlueprintSpawnableComponent))
+class CYBERWARFARE_API USShotLatencyComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+
+	/** Sets default values for this component's properties */
+	USShotLatencyComponent();
+
+	/** Trigger pressed */
+	void OnFireInput();
+
+	/** Shot ShotId fired locally, the first shot after OnFireInput is timed from the input */
+	void OnShotFired(uint16 ShotId, bool bHitCharacter);
+
+	/** The server confirmed ShotId, with its own measurements in seconds */
+	void OnShotConfirmed(uint16 ShotId, bool bHitCharacter, float FireToServer, float ServerToDamage);
+
+	/** Reload pressed */
+	void OnReloadInput();
+
+	/** The server accepted our last reload */
+	void OnReloadConfirmed();
+
+	/** Returns the histogram of one stage */
+	const FLatencyHistogram& GetHistogram(EShotLatencyStage Stage) const;
+
+	/** Returns how the hits we saw compare to the ones the server registered */
+	const FHitRegistrationStats& GetHitRegistration() const;
+
+	/** Forgets every sample */
+	void ResetHistograms();
+
+	/** Writes the histograms as CSV, returns false if the file could not be written */
+	bool ExportHistograms(const FString& Path) const;
+
+	/** Returns a printable name for Stage */
+	static const TCHAR* GetStageName(EShotLatencyStage Stage);
+
+	/** Returns the component of the local player controller owning OwnedActor (weapon, character), null for other machines' actors */
+	static USShotLatencyComponent* FindFor(const AActor* OwnedActor);
+
+protected:
+
+	/** Exports the histograms when running with -ShotLatencyExport */
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	struct FPendingShot
+	{
+		double InputTime;
+		double FireTime;
+		uint16 ShotId;
+		bool bPending;
+		bool bHitCharacter;
+	};
+
+	/** Ring of the last shots waiting for their confirmation, older ones are given up on */
+	static const int32 MaxPendingShots = 64;
+	FPendingShot PendingShots[MaxPendingShots];
+	int32 NextPendingShot;
+
+	/** Time of the trigger press not yet matched with a shot, 0 if none */
+	double PendingInputTime;
+
+	/** Time of the reload press not yet confirmed, 0 if none */
+	double PendingReloadTime;
+
+	FLatencyHistogram Histograms[(int32)EShotLatencyStage::Num];
+
+	FHitRegistrationStats HitRegistration;
+};
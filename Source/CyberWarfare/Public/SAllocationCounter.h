@@ -0,0 +1,22 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+/**
+ * Counts the game thread allocations for the gameplay benchmarks. With -CountAllocations the game module puts a forwarding
+ * allocator in front of GMalloc at startup, it stays there for the rest of the process. Without it nothing is counted.
+ */
+namespace AllocationCounter
+{
+	/** Installs the counting allocator if the command line asks for it (the game module does it) */
+	void Start();
+
+	/** Returns true if allocations are being counted */
+	bool IsCounting();
+
+	/** Returns the number of allocations made on the game thread since startup */
+	uint64 GetGameThreadAllocations();
+}
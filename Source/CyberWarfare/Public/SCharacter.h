@@ -4,6 +4,8 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
+#include "Engine/StreamableManager.h"
+#include "SNetUpdatePolicy.h"
 #include "SCharacter.generated.h"
 
 class UCameraComponent;
@@ -11,15 +13,132 @@ class USpringArmComponent;
 class ASWeapon;
 class USHealthComponent;
 class USkeletalMeshComponent;
+class UStaticMeshComponent;
+struct FHitboxCapsuleSoA;
+
+
+/** Replicated weapon switch state (Sequence lets the owning client match the server answer with its own prediction) */
+USTRUCT()
+struct FWeaponSwitchState
+{
+	GENERATED_BODY()
+
+public:
+
+	FWeaponSwitchState()
+		: InventoryIndex(0)
+		, Sequence(0)
+		, RespawnCount(0)
+	{
+	}
+
+	UPROPERTY()
+		uint8 InventoryIndex;
+
+	UPROPERTY()
+		uint8 Sequence;
+
+	/** Bumped by every respawn from the pawn pool, so clients re-equip even when the slot did not change */
+	UPROPERTY()
+		uint8 RespawnCount;
+
+};
+
+
+/** Animation and gameplay state flags of a character, replicated as a single bit field */
+USTRUCT()
+struct FCharacterStateFlags
+{
+	GENERATED_BODY()
+
+public:
+
+	enum EFlag : uint8
+	{
+		WantsToZoom	= 1 << 0,
+		Firing		= 1 << 1,
+		Reloading	= 1 << 2,
+		Running		= 1 << 3,
+		Died		= 1 << 4,
+	};
+
+	/** Number of bits actually sent */
+	static const uint32 NumFlags = 5;
+
+	FCharacterStateFlags()
+		: Bits(0)
+	{
+	}
+
+	bool HasFlag(EFlag Flag) const
+	{
+		return (Bits & Flag) != 0;
+	}
+
+	void SetFlag(EFlag Flag, bool bValue)
+	{
+		Bits = bValue ? (Bits | Flag) : (Bits & ~Flag);
+	}
+
+	bool operator==(const FCharacterStateFlags& Other) const
+	{
+		return Bits == Other.Bits;
+	}
+
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+
+	uint8 Bits;
+
+};
+
+template<>
+struct TStructOpsTypeTraits<FCharacterStateFlags> : public TStructOpsTypeTraitsBase2<FCharacterStateFlags>
+{
+	enum
+	{
+		WithNetSerializer = true,
+		WithIdenticalViaEquality = true,
+	};
+};
+
+
+/** A capsule hit volume between two bones (a sphere around BoneName when EndBoneName is None) */
+USTRUCT()
+struct FCharacterHitbox
+{
+	GENERATED_BODY()
+
+public:
+
+	UPROPERTY(EditDefaultsOnly)
+		FName BoneName;
+
+	UPROPERTY(EditDefaultsOnly)
+		FName EndBoneName;
+
+	UPROPERTY(EditDefaultsOnly)
+		float Radius;
+
+	UPROPERTY(EditDefaultsOnly)
+		TEnumAsByte<EPhysicalSurface> SurfaceType;
+
+};
+
 
 UCLASS()
 class CYBERWARFARE_API ASCharacter : public ACharacter
 {
 	GENERATED_BODY()
 
+	/** The gameplay benchmarks drive our inventory directly */
+	friend struct FGameplayBenchmark;
+
+	/** Input replay calls our server RPCs as if a client had sent them */
+	friend struct FInputReplay;
+
 public:
-	// Sets default values for this character's properties
-	ASCharacter();
+	// Sets default values for this character's properties (with our movement component)
+	ASCharacter(const FObjectInitializer& ObjectInitializer);
 
 	/** Called every frame */
 	virtual void Tick(float DeltaTime) override;
@@ -33,9 +152,15 @@ public:
 	/** Request a certain amount of ammo from player, and update our ammo count (will return Request if we have enough ammo, or less if we don't have enough ammo) */
 	int32 RequestAmmos(int32 Request);
 
+	/** Fills a weapon clip from our ammo count, returns the number of rounds loaded */
+	int32 ReloadClip(int32& ClipCurrentSize, int32 ClipMaxSize);
+
 	/** Handles reloading */
 	void Reload();
 
+	/** Returns true if Reload would start reloading (a weapon with room in its clip) */
+	bool CanReload() const;
+
 	/** This is called once the reloading animation has ended */
 	UFUNCTION(BlueprintCallable)
 		void Reload_AnimationFinished(ASWeapon* ReloadingWeapon);
@@ -46,6 +171,9 @@ public:
 	/** Handles ending fire (useful for auto weapons) */
 	void StopFire();
 
+	/** Cycles the fire mode of the current weapon */
+	void SwitchFireMode();
+
 	/** Handles running */
 	void StartRunning();
 	void StopRunning();
@@ -66,6 +194,66 @@ public:
 	UFUNCTION(BlueprintCallable)
 	ASWeapon* GetCurrentWeapon();
 
+	/** Returns our inventory slots (some may still be empty while weapon classes stream in) */
+	const TArray<ASWeapon*>& GetInventory() const;
+
+	/** Appends our hitboxes in world space for the weapon hitbox kernel */
+	void AppendWorldHitboxes(FHitboxCapsuleSoA& Capsules, int32 OwnerIndex) const;
+
+	/** Returns the hitbox at the given index of our Hitboxes array */
+	const FCharacterHitbox& GetHitbox(int32 HitboxIndex) const;
+
+	/** Returns the number of hitboxes we publish */
+	int32 GetNumHitboxes() const;
+
+	/** Returns true from our death until we respawn */
+	bool IsDead() const;
+
+	/** Folds our transform, velocity, health, flags and inventory into Crc (deterministic mode) */
+	uint32 GetStateHash(uint32 Crc) const;
+
+	/** Parks this character out of the game until the game mode hands it out again (hidden, no collision, no tick, dormant) */
+	void OnEnterPool();
+
+	/** Brings a pooled character back to its spawn state in place (health, ammo, equipped slot, movement) */
+	void ResetForRespawn();
+
+	/** Equips our weapon for the new controller, pooled characters are only equipped once possessed */
+	virtual void PossessedBy(AController* NewController) override;
+
+	/** Takes our inventory down with us */
+	virtual void Destroyed() override;
+
+	/** Notifies net activity before applying the damage */
+	virtual float TakeDamage(float DamageAmount, struct FDamageEvent const& DamageEvent, class AController* EventInstigator, AActor* DamageCauser) override;
+
+	/** Forces a net update and replicates at the active frequency for a while (damage, weapon switches, movement) */
+	void NotifyNetActivity();
+
+	/** Raises our priority for viewers we are close to, in front of, shooting at or recently damaged */
+	virtual float GetNetPriority(const FVector& ViewPos, const FVector& ViewDir, class AActor* Viewer, AActor* ViewTarget, class UActorChannel* InChannel, float Time, bool bLowBandwidth) override;
+
+	/** Remembers that we damaged the character controlled by Victim, for net prioritization */
+	void RecordDamageDealt(AController* Victim);
+
+	/** Returns true if we damaged the character of this viewer in the last few seconds */
+	bool HasRecentlyDamaged(const AActor* Viewer) const;
+
+	/** Returns true if we are shooting or just shot */
+	bool IsShooting() const;
+
+	/** Packs our state flags before they are compared for replication */
+	virtual void PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker) override;
+
+	/** Replicates our components, skipping the health component while it has not been marked dirty */
+	virtual bool ReplicateSubobjects(class UActorChannel* Channel, class FOutBunch* Bunch, FReplicationFlags* RepFlags) override;
+
+	/** Remembers when the server last updated us (clients) */
+	virtual void PostNetReceive() override;
+
+	/** Returns the world time of the last update received from the server */
+	float GetLastNetReceiveTime() const;
+
 
 protected:
 
@@ -114,6 +302,10 @@ protected:
 	UFUNCTION(Server, Reliable, WithValidation)
 		void ServerReload();
 
+	/** Tells the owning client the server accepted its reload, for the latency measurements */
+	UFUNCTION(Client, Unreliable)
+		void ClientConfirmReload();
+
 
 	/** Rates for looking around */
 	/** Base turn rate, in deg/sec. Other scaling may affect final turn rate. */
@@ -132,40 +324,99 @@ protected:
 	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true"), Category = "Components")
 		USkeletalMeshComponent* MeshCompFPS;
 
+	/** Proxy mesh for the last holstered weapon, attached to the back socket (no tick, no collision) */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Components")
+		UStaticMeshComponent* HolsterMeshComp;
+
 	/** Health component */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Components")
 		USHealthComponent* HealthComp;
 
+	/** Net update frequencies while stationary and while active */
+	UPROPERTY(EditDefaultsOnly, Category = "Replication")
+		FNetUpdatePolicy NetUpdatePolicy;
+
+	/** Time at which the last activity stops boosting our net update frequency */
+	float NetActiveEndTime;
+
+	/** Control rotation when we were last found turning, aiming in place counts as activity */
+	FRotator NetActiveControlRotation;
+
+	/** World time of the last update received from the server */
+	float LastNetReceiveTime;
+
+	/** Controllers whose character we recently damaged, and when */
+	struct FDamagedViewer
+	{
+		TWeakObjectPtr<AController> Controller;
+		float Time;
+	};
+	TArray<FDamagedViewer> RecentlyDamagedViewers;
+
+	/** Hit volumes tested by hit scan weapons instead of the physics asset */
+	UPROPERTY(EditDefaultsOnly, Category = "Hitboxes")
+		TArray<FCharacterHitbox> Hitboxes;
+
+	/** World space end points of our hitboxes, and the frame they were computed on */
+	mutable TArray<FVector> HitboxPoints;
+	mutable uint64 HitboxPointsFrame;
+
 
-	/** Variables for animations */
+	/** Variables for animations (only StateFlags is replicated, these mirror it for gameplay code and blueprints) */
 	/** Is set to true when the player asks to zoom in */
-	UPROPERTY(Replicated, BlueprintReadOnly)
+	UPROPERTY(BlueprintReadOnly)
 		bool bWantsToZoom;
 	/** Is set to true when the player is firing */
-	UPROPERTY(Replicated, BlueprintReadOnly)
+	UPROPERTY(BlueprintReadOnly)
 		bool bIsFiring;
 	/** Is set to true when we are reloading */
-	UPROPERTY(Replicated, BlueprintReadWrite)
+	UPROPERTY(BlueprintReadWrite)
 		bool bIsReloading;
 	/** Replicated controller rotation for other clients to know where this character is looking */
 	UPROPERTY(BlueprintReadWrite)
 		FRotator LookRotation;
-	UPROPERTY(Replicated, BlueprintReadOnly, Category = "Movement")
+	UPROPERTY(BlueprintReadOnly, Category = "Movement")
 		bool bIsRunning;
 	/** Called on character's death */
-	UPROPERTY(Replicated, BlueprintReadOnly, Category = "Player")
+	UPROPERTY(BlueprintReadOnly, Category = "Player")
 		bool bDied;
 
+	/** The flags above packed in a single property, filled in PreReplication on the server */
+	UPROPERTY(ReplicatedUsing = OnRep_StateFlags)
+		FCharacterStateFlags StateFlags;
+
+	/** Unpacks StateFlags into the bools and reacts to the ones that changed */
+	UFUNCTION()
+		void OnRep_StateFlags(FCharacterStateFlags PreviousStateFlags);
+
+	/** Starts or undoes the corpse state when bDied changes on a client */
+	void OnDiedChanged();
+
+	/** Time a corpse keeps animating (or simulating its ragdoll) before its pose is frozen */
+	UPROPERTY(EditDefaultsOnly, Category = "Player")
+		float CorpseSettleTime;
+
+	/** Turns our weapons off and schedules the pose freeze, on the server and on clients */
+	void StartCorpse();
+
+	/** Freezes the pose, drops mesh tick and collision, and puts the corpse to dormant replication on the server */
+	void FreezeCorpse();
+
+	/** Undoes FreezeCorpse when we respawn */
+	void ThawCorpse();
+
+	FTimerHandle TimerHandle_FreezeCorpse;
+
 
 	/** Items that can be hold by the player */
-	/** Holds the current weapon of the player */
-	UPROPERTY(Replicated, BlueprintReadOnly, Category = "Weapon")
+	/** Holds the current weapon of the player (derived locally from WeaponSwitch, never replicated) */
+	UPROPERTY(BlueprintReadOnly, Category = "Weapon")
 		ASWeapon* CurrentWeapon;
-	/** Holds the weapon class of the player */
+	/** Holds the weapon class of the player (streamed in when the inventory spawns) */
 	UPROPERTY(EditDefaultsOnly, Category = "Player")
-		TSubclassOf<ASWeapon> StarterWeaponClass;
+		TSoftClassPtr<ASWeapon> StarterWeaponClass;
 	UPROPERTY(EditDefaultsOnly, Category = "Player")
-		TSubclassOf<ASWeapon> StarterWeaponClass2Test;
+		TSoftClassPtr<ASWeapon> StarterWeaponClass2Test;
 	/** Holds total ammo count for the player */
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "PlayerBag")
 		int32 AmmoCount;
@@ -201,7 +452,18 @@ protected:
 	UFUNCTION(Server, Reliable, WithValidation)
 		void Server_SpawnInventory();
 
-	TArray<ASWeapon*> Inventory;
+	/** Streams a weapon class in and spawns it in the given inventory slots once loaded */
+	void LoadInventorySlots(const TSoftClassPtr<ASWeapon>& WeaponClass, int32 FirstSlot, int32 LastSlot);
+	void SpawnInventorySlots(TSoftClassPtr<ASWeapon> WeaponClass, int32 FirstSlot, int32 LastSlot);
+
+	/** Keeps our weapon classes loaded */
+	TArray<TSharedPtr<FStreamableHandle>> InventoryClassHandles;
+
+	UFUNCTION()
+		void OnRep_Inventory();
+
+	UPROPERTY(ReplicatedUsing = OnRep_Inventory)
+		TArray<ASWeapon*> Inventory;
 	int InventorySize;
 	int CurrentInventoryIndex;
 
@@ -213,6 +475,32 @@ protected:
 	void NextWeapon();
 	void PreviousWeapon();
 
+	/** Swaps to the given inventory slot right away, and asks the server to do the same if we are a client */
+	void SwitchToWeapon(int32 InventoryIndex);
+
+	/** Server side of a weapon switch, Sequence is echoed back through WeaponSwitch */
+	UFUNCTION(Server, Reliable, WithValidation)
+		void ServerSwitchWeapon(uint8 InventoryIndex, uint8 Sequence);
+
+	/** Equips the weapon WeaponSwitch points to (if it already replicated) */
+	void ApplyWeaponSwitch();
+
+	UFUNCTION()
+		void OnRep_WeaponSwitch();
+
+	/** Authoritative inventory slot, the owner only applies it once it has caught up with its own predictions */
+	UPROPERTY(ReplicatedUsing = OnRep_WeaponSwitch)
+		FWeaponSwitchState WeaponSwitch;
+
+	/** Sequence of the last switch predicted by this client */
+	uint8 PredictedSwitchSequence;
+
+	/** Last WeaponSwitch.RespawnCount this client re-equipped for */
+	uint8 AppliedRespawnCount;
+
+	/** Set while the game mode keeps us in its pawn pool, nothing gets equipped until we respawn */
+	bool bInPawnPool;
+
 	void EquipNewWeapon();
 	ASWeapon* NewWeapon;
 };
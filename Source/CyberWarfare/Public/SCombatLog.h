@@ -0,0 +1,67 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class AActor;
+class UWorld;
+
+
+/** Kinds of combat records, see FCombatRecord for what each one stores */
+enum class ECombatEvent : uint8
+{
+	/** Location is the eye, Direction the aim, Value the shot time */
+	Shot,
+	/** Location is the impact point, Direction the shot direction, Value the damage, Detail the surface type */
+	Hit,
+	/** Location is the victim, Value the damage, Result the health left, Detail is 1 if the shield took it */
+	Damage,
+	/** Location is the victim, Value the damage of the killing blow */
+	Death,
+	/** Location is the reloading character, Value the rounds loaded, Result the clip size after the reload */
+	Reload
+};
+
+
+/** One combat event as written to the log (little endian, no padding) */
+struct FCombatRecord
+{
+	/** Server world time of the event */
+	float WorldTime;
+
+	/** ECombatEvent */
+	uint8 Event;
+
+	/** Event specific */
+	uint8 Detail;
+	uint16 Reserved;
+
+	/** Player ids of the player behind the event and of the player it happened to, INDEX_NONE if none */
+	int32 InstigatorId;
+	int32 VictimId;
+
+	FVector Location;
+	FVector Direction;
+	float Value;
+	float Result;
+};
+
+static_assert(sizeof(FCombatRecord) == 48, "Combat log readers expect 48 byte records");
+
+
+/**
+ * Binary log of server combat events. Recording only pushes a record into a lock-free ring buffer drained to
+ * Saved/CombatLogs by a worker thread, a full buffer drops (and counts) records instead of waiting.
+ */
+namespace CombatLog
+{
+	/** Opens a new log for World and starts the writer thread (the game mode does it on the server) */
+	void Start(UWorld* World);
+
+	/** Writes what is left in the buffer and closes the log */
+	void Stop(UWorld* World);
+
+	/** Records an event, game thread only */
+	void Record(ECombatEvent Event, const AActor* Instigator, const AActor* Victim, const FVector& Location, const FVector& Direction = FVector::ZeroVector, float Value = 0.f, float Result = 0.f, uint8 Detail = 0);
+}
@@ -0,0 +1,36 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UWorld;
+
+
+/**
+ * Deterministic fast forward mode (-CoopDeterministic, standalone only, run with -nullrhi): the world advances by a fixed
+ * step of 1 / -CoopStepRate= (default 60) seconds as fast as the CPU allows, random numbers are seeded with -CoopSeed=
+ * (default 0) and a hash of the gameplay state is logged every -CoopHashInterval= frames (default 60) to
+ * -CoopHashOutput=<file> (default Saved/Deterministic/StateHashes-<seed>.txt). With -CoopSimSeconds=<seconds> the game
+ * quits after simulating that long. Two runs of a build, or two builds, can then be compared line by line.
+ */
+namespace DeterministicSim
+{
+	/** Returns true when the game runs in deterministic mode */
+	bool IsEnabled();
+
+	/** Returns the seed of the run */
+	int32 GetSeed();
+
+	/** Switches the engine to the fixed step and seeds the random numbers (the game module does it) */
+	void Start();
+
+	/** Reseeds the random numbers and starts hashing the state of World (the game mode does it) */
+	void BeginWorld(UWorld* World);
+
+	/** Stops hashing World and writes the hashes */
+	void EndWorld(UWorld* World);
+
+	/** Returns a hash of the gameplay state of World: characters, their health, inventory and weapons */
+	uint32 HashWorld(UWorld* World);
+}
@@ -0,0 +1,83 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Combat rules of the game in plain C++: damage, shield absorption and regen, clip and ammo accounting, rate of fire.
+ * The weapon, character and health component call these, Tools/DuelSim builds them without the engine for balance
+ * simulations, unit tests and benchmarks. Keep this file and SGameplayRules.cpp free of engine includes.
+ */
+namespace GameplayRules
+{
+	/** Damage multiplier of a hit on a vulnerable surface (head) */
+	constexpr float VulnerableDamageMultiplier = 4.f;
+
+	/** Time the shield waits between two regen steps once it regenerates */
+	constexpr float ShieldRegenInterval = 0.25f;
+
+	/** Tuning of a health component */
+	struct FHealthSettings
+	{
+		float DefaultHealth = 100.f;
+		float DefaultShield = 100.f;
+		/** Time without taking damage before the shield regenerates */
+		float TimeBeforeShieldRegen = 5.f;
+		/** Shield regenerated every ShieldRegenInterval */
+		float ShieldRegenRate = 1.f;
+	};
+
+	/** What a health component changes as it takes damage and regenerates */
+	struct FHealthState
+	{
+		float Health = 100.f;
+		float Shield = 100.f;
+		float TimeWithoutTakingDamage = 0.f;
+	};
+
+	/** What a hit did */
+	enum class EDamageResult : uint8_t
+	{
+		/** No damage to take */
+		None,
+		/** The shield took the whole hit, even the part larger than the shield */
+		Shield,
+		/** The health took the hit */
+		Health
+	};
+
+	/** Puts health and shield back to their defaults */
+	void ResetHealth(FHealthState& State, const FHealthSettings& Settings);
+
+	/** Takes Damage over the shield if there is any left, over the health otherwise */
+	EDamageResult ApplyDamage(FHealthState& State, const FHealthSettings& Settings, float Damage);
+
+	/** Regenerates the shield once it went long enough without damage, returns true if the shield changed */
+	bool TickShield(FHealthState& State, const FHealthSettings& Settings, float DeltaTime);
+
+	/** Returns true once the health is gone */
+	bool IsDead(const FHealthState& State);
+
+	/** Damage of a hit of a weapon doing BaseDamage */
+	float GetShotDamage(float BaseDamage, bool bVulnerableSurface);
+
+	/** Rounds per minute of a weapon in a fire mode (a fire mode rate of 0 uses the weapon rate) */
+	float GetRateOfFire(float WeaponRateOfFire, float FireModeRateOfFire);
+
+	/** Seconds between two shots at RoundsPerMinute */
+	float GetTimeBetweenShots(float RoundsPerMinute);
+
+	bool ClipIsFull(int32_t ClipCurrentSize, int32_t ClipMaxSize);
+
+	bool ClipIsEmpty(int32_t ClipCurrentSize);
+
+	/** Takes one round out of the clip for a shot, returns false without firing if the clip is empty */
+	bool ConsumeRound(int32_t& ClipCurrentSize);
+
+	/** Takes up to Request rounds out of AmmoCount, returns how many were taken */
+	int32_t RequestAmmos(int32_t& AmmoCount, int32_t Request);
+
+	/** Fills the clip from AmmoCount, returns the number of rounds loaded */
+	int32_t ReloadClip(int32_t& ClipCurrentSize, int32_t ClipMaxSize, int32_t& AmmoCount);
+}
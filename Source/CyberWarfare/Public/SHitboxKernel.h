@@ -0,0 +1,106 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UWorld;
+class ASCharacter;
+struct FCollisionQueryParams;
+
+/**
+ * Capsule hitboxes stored as a structure of arrays so the kernel can test 4 of them per instruction.
+ * A sphere is a capsule whose two end points are the same.
+ */
+struct CYBERWARFARE_API FHitboxCapsuleSoA
+{
+	/** Segment start */
+	TArray<float> AX, AY, AZ;
+	/** Segment end */
+	TArray<float> BX, BY, BZ;
+	TArray<float> Radius;
+
+	/** Index of the character owning each capsule, and its surface type */
+	TArray<int32> OwnerIndex;
+	TArray<uint8> SurfaceType;
+
+	/** Number of real capsules (arrays are padded to a multiple of 4 with capsules that can never be hit) */
+	int32 Num = 0;
+
+	void Reset();
+	void Add(const FVector& A, const FVector& B, float InRadius, int32 InOwnerIndex, uint8 InSurfaceType);
+
+	/** Pads the arrays to a multiple of 4, must be called before handing the set to the kernel */
+	void Pad();
+};
+
+
+/** A ray for the hitbox kernel, Direction must be normalized */
+struct FHitboxRay
+{
+	FVector Origin;
+	FVector Direction;
+	float MaxDistance;
+
+	/** Capsules [IgnoredBegin, IgnoredEnd) are skipped, the hitboxes of the shooter */
+	int32 IgnoredBegin;
+	int32 IgnoredEnd;
+};
+
+
+/** Closest capsule hit by a ray (HitboxIndex is INDEX_NONE on a miss) */
+struct FHitboxRayHit
+{
+	int32 HitboxIndex;
+	float Distance;
+};
+
+
+namespace HitboxKernel
+{
+	/** Finds the closest capsule along each ray, 4 capsules at a time */
+	CYBERWARFARE_API void IntersectRays(const FHitboxRay* Rays, int32 NumRays, const FHitboxCapsuleSoA& Capsules, FHitboxRayHit* OutHits);
+
+	/** Reference scalar version of IntersectRays (same results, used to validate and benchmark the vector one) */
+	CYBERWARFARE_API void IntersectRaysScalar(const FHitboxRay* Rays, int32 NumRays, const FHitboxCapsuleSoA& Capsules, FHitboxRayHit* OutHits);
+}
+
+
+/**
+ * Hitboxes of the characters of a world, gathered by the first shot of a frame and shared by the other shots of that frame.
+ * Every world (game, each PIE instance) has its own, dropped when the world is cleaned up.
+ */
+class CYBERWARFARE_API FHitboxWorldCache
+{
+public:
+
+	/** Returns the hitboxes of World for the current frame */
+	static const FHitboxWorldCache& Get(UWorld* World);
+
+	/** Makes the next Get of World gather the hitboxes again (a character died or respawned) */
+	static void Invalidate(const UWorld* World);
+
+	const FHitboxCapsuleSoA& GetCapsules() const;
+
+	/** Returns the character of an owner index of the capsules, null if it is gone */
+	ASCharacter* GetCharacter(int32 OwnerIndex) const;
+
+	/** Returns the capsules [OutBegin, OutEnd) of Character, an empty range if it has none */
+	void GetCapsuleRange(const ASCharacter* Character, int32& OutBegin, int32& OutEnd) const;
+
+	/** Keeps the characters that have hitboxes out of a physics scene query */
+	void AddIgnoredCharacters(FCollisionQueryParams& QueryParams) const;
+
+private:
+
+	void Rebuild(UWorld* World);
+
+	FHitboxCapsuleSoA Capsules;
+
+	/** Characters with hitboxes, and the first capsule of each (with one more entry for the end of the last one) */
+	TArray<TWeakObjectPtr<ASCharacter>> Characters;
+	TArray<int32> FirstCapsules;
+
+	/** Frame the capsules were gathered on */
+	uint64 BuiltFrame = MAX_uint64;
+};
@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class AActor;
+class UWorld;
+enum class EServerRpc : uint8;
+
+
+/** Gameplay work counted per frame by the hitch detector */
+enum class EGameplayCounter : uint8
+{
+	Fire,
+	WeaponTrace,
+	Damage,
+	Death,
+	Spawn,
+	Num
+};
+
+
+/**
+ * Server frame watchdog: every frame over COOP.HitchBudgetMs gets a snapshot of its gameplay counters, RPC counts,
+ * actor counts and most expensive ticking actors, written to Saved/Hitches. Capturing only copies into preallocated
+ * snapshots, they are formatted and written on the next frame within budget.
+ */
+namespace HitchDetector
+{
+	/** Starts watching the frames of World (the game mode does it on the server) */
+	void Start(UWorld* World);
+
+	/** Stops watching World and writes the pending snapshots */
+	void Stop(UWorld* World);
+
+	/** Counts one piece of gameplay work in the current frame, with the cycles it took if known */
+	void Count(EGameplayCounter Counter, uint32 Cycles = 0);
+
+	/** Counts one gameplay RPC received in the current frame */
+	void CountRpc(EServerRpc Rpc);
+
+	/** Adds Cycles to the tick time of Actor in the current frame */
+	void CountActorTick(const AActor* Actor, uint32 Cycles);
+
+	/** Counts the work done in a scope along with its cycles */
+	struct FScopedCounter
+	{
+		explicit FScopedCounter(EGameplayCounter InCounter);
+		~FScopedCounter();
+
+	private:
+		EGameplayCounter Counter;
+		uint32 StartCycles;
+		bool bActive;
+	};
+
+	/** Adds the cycles of a scope to the tick time of an actor */
+	struct FScopedActorTick
+	{
+		explicit FScopedActorTick(const AActor* InActor);
+		~FScopedActorTick();
+
+	private:
+		const AActor* Actor;
+		uint32 StartCycles;
+		bool bActive;
+	};
+}
@@ -0,0 +1,77 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class AActor;
+class UWorld;
+
+
+/** Kinds of input records, see FInputRecord for what each one stores */
+enum class EInputEvent : uint8
+{
+	/** Time is the client time stamp, Value the delta time, Vector the acceleration, Rotation the control rotation, Detail the compressed move flags */
+	Move,
+	/** Time is the shot time, Rotation the aim, Detail the inventory slot of the weapon */
+	Fire,
+	/** Character reload */
+	Reload,
+	/** Weapon reload, Detail is the inventory slot of the weapon */
+	WeaponReload,
+	/** Detail is the inventory slot, Value the switch sequence */
+	SwitchWeapon,
+	SpawnInventory,
+	/** The player left the game */
+	Leave,
+	/** Detail is the inventory slot of the weapon, Value the fire mode index */
+	SetFireMode
+};
+
+
+/** One input received by the server as written to the recording (little endian, no padding) */
+struct FInputRecord
+{
+	/** Server world time the input was received at */
+	float WorldTime;
+
+	/** EInputEvent */
+	uint8 Event;
+
+	/** Event specific */
+	uint8 Detail;
+	uint16 Reserved;
+
+	/** Player id of the connection that sent the input */
+	int32 PlayerId;
+
+	float Time;
+	float Value;
+	FVector Vector;
+	FRotator Rotation;
+};
+
+static_assert(sizeof(FInputRecord) == 44, "Input recording readers expect 44 byte records");
+
+
+/**
+ * Records the moves and gameplay RPCs every client sends to the server (COOP.InputRecording, on by default) to
+ * Saved/InputRecordings, through the same kind of lock-free ring buffer and writer thread as the combat log. The writer
+ * thread moves on to a new file (-1, -2...) every COOP.InputRecordingMaxMB, each one replays on its own, and deletes the
+ * oldest recordings to keep them all under COOP.InputRecordingMaxTotalMB.
+ * A server started with -InputReplay=<file> on the map of the recording instead spawns a player controller per recorded
+ * player and feeds them the recorded inputs at their recorded times, then quits. -InputReplayProfile captures a stats
+ * file of the replay (stat startfile / stat stopfile). Run it headless: -server -nullrhi.
+ * Calls dropped by the RPC rate limits are never recorded, they had no effect to replay (COOP.RpcDrops counts them).
+ */
+namespace InputRecording
+{
+	/** Opens a new recording for World, or starts replaying one (the game mode does it on the server) */
+	void Start(UWorld* World);
+
+	/** Writes what is left in the buffer and closes the recording, or stops the replay */
+	void Stop(UWorld* World);
+
+	/** Records an input received from the player owning OwnedActor (controller, character or weapon), game thread only */
+	void Record(EInputEvent Event, const AActor* OwnedActor, float Time = 0.f, float Value = 0.f, const FVector& Vector = FVector::ZeroVector, const FRotator& Rotation = FRotator::ZeroRotator, uint8 Detail = 0);
+}
@@ -0,0 +1,33 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+/**
+ * Command line of the network condition harness (Scripts/NetHarness):
+ * -NetHarness on the server and the clients, -NetHarnessBot on clients driven by a bot,
+ * -NetHarnessDuration=<seconds> (default 60), -NetHarnessSeed=<seed>, -NetHarnessOutput=<dir> (default Saved/NetHarness),
+ * -NetHarnessRate=<bytes per second> on the server to throttle what it sends to every client (default 0, not throttled).
+ */
+namespace NetHarness
+{
+	/** Returns true when this process takes part in a harness run */
+	bool IsEnabled();
+
+	/** Returns true when the local player is driven by the harness bot */
+	bool IsBot();
+
+	/** Returns the length of the scenario, the process reports and quits after it */
+	float GetDuration();
+
+	/** Returns the seed of the scenario */
+	int32 GetSeed();
+
+	/** Returns the rate the server sends to each client at (0 if not throttled) */
+	int32 GetRateLimit();
+
+	/** Writes a report to the output directory */
+	void WriteReport(const FString& FileName, const FString& Json);
+}
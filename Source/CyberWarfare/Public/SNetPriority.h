@@ -0,0 +1,26 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+/** Per viewer net priority of combat actors: what is close, in view, firing or hurting the viewer replicates first */
+namespace NetPriority
+{
+	/** Returns false when COOP.NetPrioritization is off and actors should use the engine priority */
+	bool IsEnabled();
+
+	/**
+	 * Returns the multiplier to apply to an actor's NetPriority for one viewer.
+	 * @param ActorLocation		Location of the actor being prioritized
+	 * @param ViewPos			Location of the viewer
+	 * @param ViewDir			View direction of the viewer
+	 * @param bFiring			True if the actor is shooting
+	 * @param bDamagedViewer	True if the actor recently damaged this viewer
+	 */
+	float GetViewerScale(const FVector& ActorLocation, const FVector& ViewPos, const FVector& ViewDir, bool bFiring, bool bDamagedViewer);
+
+	/** Returns true if the actor is in the cone where it gets the full view factor */
+	bool IsInViewCone(const FVector& ActorLocation, const FVector& ViewPos, const FVector& ViewDir);
+}
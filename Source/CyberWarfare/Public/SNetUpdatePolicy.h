@@ -0,0 +1,53 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SNetUpdatePolicy.generated.h"
+
+
+/** COOP.AdaptiveNetUpdate: idle actors drop to their idle net update frequency */
+extern int32 GCoopAdaptiveNetUpdate;
+
+
+/** How often an actor replicates while idle and for how long activity boosts it, tuned per class in defaults */
+USTRUCT(BlueprintType)
+struct FNetUpdatePolicy
+{
+	GENERATED_BODY()
+
+public:
+
+	FNetUpdatePolicy()
+		: IdleFrequency(10.f)
+		, ActiveFrequency(66.f)
+		, BoostDuration(1.f)
+	{
+	}
+
+	FNetUpdatePolicy(float InIdleFrequency, float InActiveFrequency, float InBoostDuration)
+		: IdleFrequency(InIdleFrequency)
+		, ActiveFrequency(InActiveFrequency)
+		, BoostDuration(InBoostDuration)
+	{
+	}
+
+	/** Returns the net update frequency to use */
+	float GetFrequency(bool bActive) const
+	{
+		return (bActive || GCoopAdaptiveNetUpdate <= 0) ? ActiveFrequency : IdleFrequency;
+	}
+
+	/** Net updates per second while nothing happens */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Replication", meta = (ClampMin = "0.1"))
+		float IdleFrequency;
+
+	/** Net updates per second while active */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Replication", meta = (ClampMin = "0.1"))
+		float ActiveFrequency;
+
+	/** How long an activity keeps the active frequency */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Replication", meta = (ClampMin = "0"))
+		float BoostDuration;
+
+};
@@ -0,0 +1,96 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/PlayerController.h"
+#include "SPlayerController.generated.h"
+
+class USNetClockComponent;
+class USShotLatencyComponent;
+
+
+/** Gameplay RPCs rate limited per connection */
+enum class EServerRpc : uint8
+{
+	Fire,
+	Reload,
+	WeaponReload,
+	SwitchWeapon,
+	SpawnInventory,
+	SetFireMode,
+	Num
+};
+
+
+/** Token bucket refilled at a given rate, up to a burst size */
+struct FRpcTokenBucket
+{
+	FRpcTokenBucket()
+		: Tokens(0.f)
+		, LastRefillTime(-1.f)
+	{
+	}
+
+	/** Refills the bucket and takes a token out of it, returns false if it was empty */
+	bool Consume(float Time, float TokensPerSecond, float Burst);
+
+	float Tokens;
+	float LastRefillTime;
+};
+
+
+/**
+ * Player controller of the game, owns per connection state such as the RPC rate limits and the network clock
+ */
+UCLASS()
+class CYBERWARFARE_API ASPlayerController : public APlayerController
+{
+	GENERATED_BODY()
+
+public:
+
+	ASPlayerController();
+
+	/** Hands the local player to the harness bot when asked to */
+	virtual void BeginPlay() override;
+
+	/** Returns the controller of the player owning an actor: itself for a controller, its owner for a character, its owner's owner for a weapon */
+	static AController* FindOwningController(const AActor* OwnedActor);
+
+	/** Same as above if that controller is one of ours */
+	static ASPlayerController* FindOwningPlayer(const AActor* OwnedActor);
+
+	/** Returns false if this connection calls Rpc faster than CallsPerSecond (with Burst calls of slack), the call must then be dropped */
+	bool ConsumeRpcToken(EServerRpc Rpc, float CallsPerSecond, float Burst);
+
+	/** Same as above for an actor owned by a player (character, weapon), always true for actors without a player controller */
+	static bool ConsumeRpcToken(AActor* OwnedActor, EServerRpc Rpc, float CallsPerSecond, float Burst);
+
+	/** Returns the number of calls of Rpc dropped for this connection */
+	int32 GetNumDroppedRpcs(EServerRpc Rpc) const;
+
+	/** Returns a printable name for Rpc */
+	static const TCHAR* GetRpcName(EServerRpc Rpc);
+
+	/** Returns our estimate of the server clock */
+	USNetClockComponent* GetNetClock() const;
+
+	/** Returns our fire and reload latency measurements */
+	USShotLatencyComponent* GetShotLatency() const;
+
+protected:
+
+	/** Server clock estimate for gameplay timestamps */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Components")
+		USNetClockComponent* NetClockComp;
+
+	/** Fire and reload latency histograms of the owning client */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Components")
+		USShotLatencyComponent* ShotLatencyComp;
+
+	FRpcTokenBucket RpcBuckets[(int32)EServerRpc::Num];
+
+	int32 DroppedRpcs[(int32)EServerRpc::Num];
+	
+};
@@ -16,7 +16,7 @@ class CYBERWARFARE_API ASProjectileWeapon : public ASWeapon
 
 protected:
 
-	virtual void Fire() override;
+	virtual bool Fire(const FWeaponShot& Shot) override;
 
 	UPROPERTY(EditDefaultsOnly, Category = "Projectile weapon")
 	TSubclassOf<AActor> ProjectileClass;
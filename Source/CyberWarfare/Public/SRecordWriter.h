@@ -0,0 +1,123 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/CircularQueue.h"
+#include "HAL/Runnable.h"
+#include "HAL/ThreadSafeBool.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "Serialization/Archive.h"
+
+
+/**
+ * Drains a ring buffer of fixed size records to a file every DrainInterval seconds, the game thread is the only producer
+ * and the thread running the writer the only consumer (combat log, input recording). Owns the file.
+ * With SetRotation, the writer moves on to a new file itself once the current one reaches a size, the game thread never waits.
+ */
+template <typename RecordType>
+class TRecordWriter : public FRunnable
+{
+public:
+
+	/** Opens file FileIndex (1 for the first rotation), FirstRecord is the first record it will get. Null drops the records. */
+	typedef TFunction<FArchive*(int32 FileIndex, const RecordType& FirstRecord)> FOpenFileFunction;
+
+	TRecordWriter(FArchive* InFile, uint32 Capacity, float InDrainInterval)
+		: Queue(Capacity)
+		, NumFiles(1)
+		, File(InFile)
+		, DrainInterval(InDrainInterval)
+		, MaxFileSize(0)
+		, FileRecordBytes(0)
+	{
+		Batch.Reserve(1024);
+	}
+
+	/** Rotates files at InMaxFileSize bytes, call before starting the thread. OpenFile runs on the writer thread. */
+	void SetRotation(int64 InMaxFileSize, const FOpenFileFunction& InOpenFile)
+	{
+		MaxFileSize = InMaxFileSize;
+		OpenFile = InOpenFile;
+	}
+
+	virtual ~TRecordWriter()
+	{
+		delete File;
+	}
+
+	virtual uint32 Run() override
+	{
+		while (!bStopping)
+		{
+			Drain();
+			FPlatformProcess::Sleep(DrainInterval);
+		}
+
+		// The game thread stopped producing before asking us to stop
+		Drain();
+		return 0;
+	}
+
+	virtual void Stop() override
+	{
+		bStopping = true;
+	}
+
+	void Drain()
+	{
+		RecordType Record;
+		while (Queue.Dequeue(Record))
+		{
+			Batch.Add(Record);
+		}
+
+		if (Batch.Num() == 0)
+		{
+			return;
+		}
+
+		const int64 BatchBytes = Batch.Num() * sizeof(RecordType);
+
+		// Move on before this batch takes the file past its size, a file always gets at least one batch
+		if (MaxFileSize > 0 && OpenFile && File && FileRecordBytes > 0 && File->Tell() + BatchBytes > MaxFileSize)
+		{
+			delete File;
+			File = OpenFile(NumFiles.GetValue(), Batch[0]);
+			FileRecordBytes = 0;
+			NumFiles.Increment();
+		}
+
+		if (File)
+		{
+			File->Serialize(Batch.GetData(), BatchBytes);
+			File->Flush();
+
+			FileRecordBytes += BatchBytes;
+			NumWritten.Add(Batch.Num());
+		}
+		else
+		{
+			NumLost.Add(Batch.Num());
+		}
+		Batch.Reset();
+	}
+
+	TCircularQueue<RecordType> Queue;
+	FThreadSafeCounter NumWritten;
+	/** Records lost because the next file could not be opened */
+	FThreadSafeCounter NumLost;
+	/** Files written to so far */
+	FThreadSafeCounter NumFiles;
+
+private:
+
+	FArchive* File;
+	float DrainInterval;
+	TArray<RecordType> Batch;
+	FThreadSafeBool bStopping;
+
+	int64 MaxFileSize;
+	FOpenFileFunction OpenFile;
+	int64 FileRecordBytes;
+};
@@ -0,0 +1,41 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+/** Points of the startup path, in seconds since the process started */
+enum class EStartupMilestone : uint8
+{
+	/** Once per process */
+	ModuleStartup,
+	CharacterDefaults,
+	WeaponDefaults,
+	EngineInitialized,
+
+	/** Once per map load */
+	MapLoadStarted,
+	MapLoaded,
+	FirstBeginPlay,
+	InventorySpawned,
+	FirstPlayableFrame,
+
+	Num
+};
+
+
+/**
+ * Startup and map load timing. Milestones are always recorded, with -StartupTiming every playable map writes a report to
+ * -StartupTimingOutput=<file> (default Saved/StartupTiming/Startup-<Server|Client>.json), -StartupTimingExit quits after
+ * the first one. The first playable frame is the first frame completed after the first inventory spawned: the locally
+ * controlled character on a client, the first pooled character on a server. Only non seamless travel is a map load.
+ */
+namespace StartupTiming
+{
+	/** Records the module startup and starts following map loads (the game module does it) */
+	void Start();
+
+	/** Records the first time of Milestone for the process or for the current map load */
+	void Mark(EStartupMilestone Milestone);
+}
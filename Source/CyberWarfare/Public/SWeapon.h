@@ -4,12 +4,16 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "Engine/StreamableManager.h"
+#include "SNetUpdatePolicy.h"
 #include "SWeapon.generated.h"
 
 class USkeletalMeshComponent;
 class UDamageType;
 class UParticleSystem;
 class USoundBase;
+class UStaticMesh;
+class APlayerController;
 
 /** Contains info of a single hit scan weapon line trace */
 USTRUCT()
@@ -28,10 +32,94 @@ public:
 };
 
 
+/** How much of a weapon cosmetic is worth playing for the local viewers */
+enum class EWeaponEffectTier : uint8
+{
+	Full,
+	Reduced,
+	Culled
+};
+
+
+/** How the trigger drives the weapon */
+UENUM(BlueprintType)
+enum class EWeaponFireMode : uint8
+{
+	SemiAuto,
+	Burst,
+	FullAuto
+};
+
+
+/** One row of the weapon fire mode table */
+USTRUCT(BlueprintType)
+struct FWeaponFireModeData
+{
+	GENERATED_BODY()
+
+public:
+
+	FWeaponFireModeData()
+		: FireMode(EWeaponFireMode::FullAuto)
+		, BurstCount(3)
+		, RateOfFire(0.f)
+	{
+	}
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
+		EWeaponFireMode FireMode;
+
+	/** Rounds fired per trigger pull in burst mode */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, meta = (ClampMin = 1))
+		uint8 BurstCount;
+
+	/** Rounds per minute for this mode (0 uses the weapon RateOfFire) */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, meta = (ClampMin = 0))
+		float RateOfFire;
+
+};
+
+
+/** A single shot produced by the fire scheduler */
+USTRUCT()
+struct FWeaponShot
+{
+	GENERATED_BODY()
+
+public:
+
+	FWeaponShot()
+		: ShotTime(0.f)
+		, AimRotation(ForceInit)
+		, ShotId(0)
+	{
+	}
+
+	/** World time the shot was due at (may be earlier than the frame it is processed in), server world time once sent to the server */
+	UPROPERTY()
+		float ShotTime;
+
+	/** Aim interpolated to ShotTime */
+	UPROPERTY()
+		FRotator AimRotation;
+
+	/** Sequence number of the shot on its client (0 for shots fired by the server), echoed back by ClientConfirmShot */
+	UPROPERTY()
+		uint16 ShotId;
+
+};
+
+
 UCLASS()
 class CYBERWARFARE_API ASWeapon : public AActor
 {
 	GENERATED_BODY()
+
+	/** The gameplay benchmarks fire shots directly */
+	friend struct FGameplayBenchmark;
+
+	/** Input replay calls our server RPCs as if a client had sent them */
+	friend struct FInputReplay;
 	
 public:
 
@@ -42,27 +130,118 @@ public:
 
 	void StopFire();
 
+	/** Switches to the next row of the fire mode table (ignored while shooting) */
+	void CycleFireMode();
+
+	/** Selects a row of the fire mode table on the server, which sizes its rate limit and bursts from it */
+	UFUNCTION(Server, Reliable, WithValidation)
+		void ServerSetFireMode(uint8 NewFireModeIndex);
+
+	/** Called every frame while shots are scheduled */
+	virtual void Tick(float DeltaTime) override;
+
 	bool ClipIsFull();
 	bool ClipIsEmpty();
 
 	/** Reload function */
 	void Reload();
 
+	/** Called by the owning character when this weapon is put away (hidden, no tick, no collision, dormant) */
+	void OnHolstered();
+
+	/** Called by the owning character when this weapon is taken out */
+	void OnEquipped();
+
+	/** Refills the clip and forgets pending shots, used when a pooled character respawns */
+	void ResetAmmo();
+
+	/** Called when the owning character dies, the weapon stays in its hands but stops ticking, colliding and replicating */
+	void OnOwnerDied();
+
+	/** Sends a change of replicated state to clients, the weapon is dormant unless it is firing */
+	void MarkReplicationDirty();
+
+	/** Forces a net update and replicates at the active frequency for a while (firing, equipping) */
+	void NotifyNetActivity();
+
+	/** Returns true while shots are scheduled or right after a shot */
+	bool HasFiredRecently() const;
+
+	/** Uses the priority of our owner for other viewers, raised while we fire */
+	virtual float GetNetPriority(const FVector& ViewPos, const FVector& ViewDir, class AActor* Viewer, AActor* ViewTarget, class UActorChannel* InChannel, float Time, bool bLowBandwidth) override;
+
+	/** Returns the mesh used to represent this weapon while holstered (may be null) */
+	UStaticMesh* GetHolsterMesh() const;
+
+	/** Returns the length of a reload */
+	float GetReloadDuration() const;
+
+	/** Folds ammo, fire mode and fire scheduler state into Crc (deterministic mode) */
+	uint32 GetStateHash(uint32 Crc) const;
+
 protected:
 
 	/** Begin play */
 	virtual void BeginPlay() override;
 
+	/** Lets our cosmetics go once the weapon is gone */
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/** Back to the idle frequency (and dormant) once the activity boost is over */
+	void OnNetIdle();
+
+	FTimerHandle TimerHandle_NetIdle;
+
+	/** Net update frequencies while idle and while firing */
+	UPROPERTY(EditDefaultsOnly, Category = "Replication")
+		FNetUpdatePolicy NetUpdatePolicy;
+
 
 	/** Locally play effects */
 	void PlayFireEffects(FVector TracerEndPoint);
 	void PlayImpactEffects(EPhysicalSurface SurfaceType, FVector ImpactPoint);
+
+	/** Scores an effect location against the local views (distance, view cone, occlusion) */
+	EWeaponEffectTier GetEffectTier(const FVector& EffectLocation) const;
+
+	/** Returns true if nothing blocks the view from ViewLocation to EffectLocation */
+	bool IsEffectInLineOfSight(const FVector& EffectLocation, const FVector& ViewLocation) const;
+
+	/** Last line of sight test of our effects, reused by the same viewer for a short while */
+	mutable TWeakObjectPtr<const APlayerController> LineOfSightViewer;
+	mutable float LineOfSightTestTime;
+	mutable bool bLastLineOfSight;
 	
 	
-	/** Fire functions */
-	virtual void Fire();
+	/** Fire functions, Fire returns false if the shot was refused (running, empty clip) */
+	virtual bool Fire(const FWeaponShot& Shot);
 	UFUNCTION(Server, Reliable, WithValidation)
-		void ServerFire();
+		void ServerFire(const FWeaponShot& Shot);
+
+	/** Tells the shooter the server processed ShotId, whether it hit a character, and the time it took to get here and to apply its damage */
+	UFUNCTION(Client, Unreliable)
+		void ClientConfirmShot(uint16 ShotId, bool bHitCharacter, float FireToServer, float ServerToDamage);
+
+	/** Last shot id sent to the server */
+	uint16 NextShotId;
+
+	/** True if the last shot fired hit a character */
+	bool bLastShotHitCharacter;
+
+	/** Returns our slot in the inventory of our owner (MAX_uint8 if not in one), identifies us in input recordings */
+	uint8 GetInventorySlot() const;
+
+	/** Traces a shot from TraceStart to TraceEnd, returns true on a blocking hit */
+	bool WeaponTrace(const FVector& TraceStart, const FVector& TraceEnd, FHitResult& OutHit, EPhysicalSurface& OutSurfaceType) const;
+
+	/** Fires every shot that fell due since the last call, with per-shot timestamps and interpolated aim */
+	void ProcessScheduledShots();
+
+	/** Current aim of our owner */
+	FRotator GetOwnerAimRotation() const;
+
+	/** Seconds between two shots in the current fire mode */
+	float GetTimeBetweenShots() const;
 	UFUNCTION()
 		void OnRep_HitScanTrace();
 
@@ -77,6 +256,11 @@ protected:
 		USkeletalMeshComponent* MeshComp;
 
 
+	/** Cheap static mesh shown on the owner's back while this weapon is holstered */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Components")
+		UStaticMesh* HolsterMesh;
+
+
 	/** Weapon sockets */
 	UPROPERTY(VisibleDefaultsOnly, BlueprintReadOnly, Category = "Weapon")
 		FName MuzzleSocketName;
@@ -84,26 +268,35 @@ protected:
 		FName TracerTargetName;
 
 
-	/** Weapon special effects */
+	/** Weapon special effects (streamed in while the weapon is in an inventory, see RequestEffectAssets) */
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "WeaponEffects")
-		UParticleSystem* MuzzleEffect;
+		TSoftObjectPtr<UParticleSystem> MuzzleEffect;
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "WeaponEffects")
-		UParticleSystem* DefaultImpactEffect;
+		TSoftObjectPtr<UParticleSystem> DefaultImpactEffect;
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "WeaponEffects")
-		UParticleSystem* FleshImpactEffect;
+		TSoftObjectPtr<UParticleSystem> FleshImpactEffect;
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "WeaponEffects")
-		UParticleSystem* TracerEffect;
+		TSoftObjectPtr<UParticleSystem> TracerEffect;
 	UPROPERTY(EditDefaultsOnly, Category = "WeaponEffects")
 		TSubclassOf<UCameraShake> FireCamShake;
 
 
-	/** Sound effects */
+	/** Sound effects (streamed like the special effects) */
 	UPROPERTY(EditDefaultsOnly, Category = "WeaponSounds")
-		USoundBase* SoundFire;
+		TSoftObjectPtr<USoundBase> SoundFire;
 	UPROPERTY(EditDefaultsOnly, Category = "WeaponSounds")
-		USoundBase* SoundBodyHit;
+		TSoftObjectPtr<USoundBase> SoundBodyHit;
 	UPROPERTY(EditDefaultsOnly, Category = "WeaponSounds")
-		USoundBase* SoundSurfaceHit;
+		TSoftObjectPtr<USoundBase> SoundSurfaceHit;
+
+	/** Streams our effects and sounds in, the equipped weapon asks with a high priority */
+	void RequestEffectAssets(bool bHighPriority);
+
+	/** Lets our effects and sounds be garbage collected */
+	void ReleaseEffectAssets();
+
+	/** Keeps our effects and sounds loaded while we are held, equipped or holstered, until EndPlay */
+	TSharedPtr<FStreamableHandle> EffectAssetsHandle;
 
 
 	/** Weapon stats */
@@ -117,16 +310,29 @@ protected:
 		int32 ClipCurrentSize;
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "WeaponStats")
 		int32 ClipMaxSize;
+	/** Length of the reload animation, the server refuses reloads requested faster than that */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "WeaponStats")
+		float ReloadDuration;
 
 
 	/** Utilities for replication */
 	UPROPERTY(ReplicatedUsing = OnRep_HitScanTrace)
 		FHitScanTrace HitScanTrace;
 
-	/** Times and timers for weapon fire */
-	float TimeBetweenShots;
+	/** Fire mode table, the trigger cycles through it with CycleFireMode */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "WeaponStats")
+		TArray<FWeaponFireModeData> FireModes;
+	UPROPERTY(BlueprintReadOnly, Category = "WeaponStats")
+		int32 FireModeIndex;
+
+	/** Fire scheduler state */
 	float LastFireTime;
-	FTimerHandle TimerHandle_TimeBetweenShots;
+	float NextShotTime;
+	/** Shots left for the current trigger pull (INDEX_NONE while a full auto trigger is held) */
+	int32 ShotsRemaining;
+	/** Aim and time at the end of the last processed frame, shots in between interpolate from it */
+	FRotator LastAimRotation;
+	float LastAimTime;
 
 	UPROPERTY(BlueprintReadWrite, Category = "Movement")
 	bool CharacterIsRunning;
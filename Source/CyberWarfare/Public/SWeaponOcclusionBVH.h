@@ -0,0 +1,109 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UWorld;
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+/** File header of a baked weapon occlusion BVH (Content/WeaponOcclusion/<Map path>.wbvh, staged with the game) */
+struct FWeaponBVHHeader
+{
+	static const uint32 ExpectedMagic = 0x48564257; // 'WBVH'
+	/** 2: stationary geometry is baked as well */
+	static const uint32 ExpectedVersion = 2;
+
+	uint32 Magic;
+	uint32 Version;
+	uint32 NumNodes;
+	uint32 NumTriangles;
+	/** Non zero if every static primitive blocking weapons was baked, the physics scene can then skip static geometry */
+	uint32 bCoversAllStatic;
+	uint32 Padding[3];
+};
+
+/** BVH node, a leaf if Count > 0 (triangles [FirstIndex, FirstIndex + Count)), else children are FirstIndex and FirstIndex + 1 */
+struct FWeaponBVHNode
+{
+	float Min[3];
+	int32 FirstIndex;
+	float Max[3];
+	int32 Count;
+};
+
+/** Triangle stored as a vertex and two edges, ready for the ray test */
+struct FWeaponBVHTriangle
+{
+	float V0[3];
+	float E1[3];
+	float E2[3];
+	uint32 SurfaceType;
+};
+
+/** Closest static geometry hit */
+struct FWeaponOcclusionHit
+{
+	float Distance;
+	FVector Normal;
+	uint8 SurfaceType;
+};
+
+/** Outcome of a BVH raycast */
+enum class EWeaponOcclusionResult : uint8
+{
+	Miss,
+	Hit,
+	/** The traversal ran out of stack, the ray has to be traced through the physics scene instead */
+	Incomplete
+};
+
+
+/**
+ * Read only BVH of the static geometry blocking weapons in a level, baked offline by USWeaponOcclusionCommandlet.
+ * The file is memory mapped when the platform allows it, and loaded in memory otherwise.
+ */
+class CYBERWARFARE_API FWeaponOcclusionBVH
+{
+public:
+
+	~FWeaponOcclusionBVH();
+
+	/** Returns the BVH baked for the world's map, or null if there is none (loaded once per map, forgotten when a map loads or a world is cleaned up) */
+	static const FWeaponOcclusionBVH* FindForWorld(const UWorld* World);
+
+	/** Returns the file name of the BVH of a map package (/Game/Maps/P_TestLevel -> .../Content/WeaponOcclusion/Maps/P_TestLevel.wbvh) */
+	static FString GetFilenameForMap(const FString& MapPackageName);
+
+	/** Maps or loads a baked file, returns null if it is missing or invalid */
+	static TSharedPtr<FWeaponOcclusionBVH> LoadFromFile(const FString& Filename);
+
+	/** Builds the BVH of a triangle soup and writes it to Filename */
+	static bool BuildAndSave(const TArray<FWeaponBVHTriangle>& Triangles, bool bCoversAllStatic, const FString& Filename);
+
+	/** Finds the closest triangle along a ray (Direction must be normalized) */
+	EWeaponOcclusionResult Raycast(const FVector& Origin, const FVector& Direction, float MaxDistance, FWeaponOcclusionHit& OutHit) const;
+
+	/** True if the physics scene does not need to be queried for static geometry at all */
+	bool CoversAllStaticGeometry() const;
+
+	int32 GetNumTriangles() const;
+
+	/** Bounds of all the baked geometry */
+	FBox GetBounds() const;
+
+private:
+
+	FWeaponOcclusionBVH();
+
+	bool SetData(const uint8* Data, int64 Size);
+
+	IMappedFileHandle* MappedFile;
+	IMappedFileRegion* MappedRegion;
+	TArray<uint8> LoadedData;
+
+	const FWeaponBVHHeader* Header;
+	const FWeaponBVHNode* Nodes;
+	const FWeaponBVHTriangle* Triangles;
+};
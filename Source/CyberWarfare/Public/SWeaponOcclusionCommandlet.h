@@ -0,0 +1,31 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "SWeaponOcclusionCommandlet.generated.h"
+
+/**
+ * Bakes the weapon occlusion BVH of a map, and optionally checks it against the physics scene.
+ * UE4Editor-Cmd CyberWarfare.uproject -run=SWeaponOcclusion -map=/Game/Maps/P_TestLevel [-verify=10000] [-nobake]
+ */
+UCLASS()
+class CYBERWARFARE_API USWeaponOcclusionCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+
+	USWeaponOcclusionCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+protected:
+
+	/** Gathers the triangles of every static and stationary primitive blocking weapons, returns false if some could not be baked */
+	bool GatherStaticTriangles(UWorld* World, TArray<struct FWeaponBVHTriangle>& OutTriangles) const;
+
+	/** Casts random rays through the BVH and the static physics scene, returns the number of disagreements */
+	int32 Verify(UWorld* World, const class FWeaponOcclusionBVH& BVH, int32 NumRays) const;
+};
@@ -0,0 +1,123 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "DuelSimulator.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+/**
+ * Throughput of the simulator and cost of the rules it is made of. Each benchmark keeps the best of NumRuns runs.
+ * --duels=N sets the duels of the simulator benchmarks (default 1000000), smaller values make a quick smoke run.
+ */
+
+static const int NumRuns = 5;
+
+/** Keeps the optimizer from dropping the benchmarked work */
+static volatile float Sink;
+
+
+template<typename FunctionType>
+static double BestSeconds(FunctionType Function)
+{
+	double Best = 0.0;
+	for (int Run = 0; Run < NumRuns; Run++)
+	{
+		const auto StartTime = std::chrono::steady_clock::now();
+		Function();
+		const double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - StartTime).count();
+		Best = Run == 0 || Seconds < Best ? Seconds : Best;
+	}
+	return Best;
+}
+
+
+static void ReportNanoseconds(const char* Name, double Seconds, uint64_t NumOps)
+{
+	std::printf("%-28s %10.2f ns/op\n", Name, Seconds * 1.e9 / NumOps);
+}
+
+
+static void ReportDuels(const char* Name, double Seconds, uint64_t NumDuels)
+{
+	std::printf("%-28s %10.0f duels/s\n", Name, Seconds > 0.0 ? NumDuels / Seconds : 0.0);
+}
+
+
+int main(int Argc, char** Argv)
+{
+	uint64_t NumDuels = 1000000;
+	for (int Index = 1; Index < Argc; Index++)
+	{
+		if (std::strncmp(Argv[Index], "--duels=", 8) == 0)
+		{
+			NumDuels = std::strtoull(Argv[Index] + 8, nullptr, 10);
+		}
+	}
+	const uint64_t NumOps = NumDuels * 10;
+
+	GameplayRules::FHealthSettings HealthSettings;
+
+	// Shield hits that never kill, like the TakeAnyDamage benchmark of the game
+	const double ApplyDamageSeconds = BestSeconds([&]()
+	{
+		GameplayRules::FHealthState State;
+		for (uint64_t Op = 0; Op < NumOps; Op++)
+		{
+			State.Shield = 100.f;
+			GameplayRules::ApplyDamage(State, HealthSettings, 20.f);
+		}
+		Sink = State.Shield;
+	});
+	ReportNanoseconds("ApplyDamage", ApplyDamageSeconds, NumOps);
+
+	// A regenerating shield, one call per frame
+	const double TickShieldSeconds = BestSeconds([&]()
+	{
+		GameplayRules::FHealthState State;
+		for (uint64_t Op = 0; Op < NumOps; Op++)
+		{
+			State.Shield = 0.f;
+			GameplayRules::TickShield(State, HealthSettings, 1.f / 60.f);
+		}
+		Sink = State.TimeWithoutTakingDamage;
+	});
+	ReportNanoseconds("TickShield", TickShieldSeconds, NumOps);
+
+	const double ReloadSeconds = BestSeconds([&]()
+	{
+		int32_t Loaded = 0;
+		for (uint64_t Op = 0; Op < NumOps; Op++)
+		{
+			int32_t Clip = (int32_t)(Op & 31);
+			int32_t AmmoCount = 300;
+			Loaded += GameplayRules::ReloadClip(Clip, 30, AmmoCount);
+		}
+		Sink = (float)Loaded;
+	});
+	ReportNanoseconds("ReloadClip", ReloadSeconds, NumOps);
+
+	DuelSim::FDuelSettings Settings;
+
+	const double SingleThreadSeconds = BestSeconds([&]()
+	{
+		Sink = (float)DuelSim::RunDuels(Settings, NumDuels, 1, 1).GetMeanTimeToKill();
+	});
+	ReportDuels("Duels, 1 thread", SingleThreadSeconds, NumDuels);
+
+	// With a single core (or an unknown count) all threads is the single thread run again
+	const unsigned NumThreads = std::thread::hardware_concurrency();
+	if (NumThreads > 1)
+	{
+		const double AllThreadsSeconds = BestSeconds([&]()
+		{
+			Sink = (float)DuelSim::RunDuels(Settings, NumDuels, 0, 1).GetMeanTimeToKill();
+		});
+		char Name[64];
+		std::snprintf(Name, sizeof(Name), "Duels, %u threads", NumThreads);
+		ReportDuels(Name, AllThreadsSeconds, NumDuels);
+	}
+
+	return 0;
+}
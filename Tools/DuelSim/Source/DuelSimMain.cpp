@@ -0,0 +1,125 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "DuelSimulator.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+
+static void PrintUsage()
+{
+	std::printf(
+		"Usage: DuelSim [options]\n"
+		"  --duels=N            duels to play (default 1000000)\n"
+		"  --threads=N          worker threads, 0 for every core (default 0)\n"
+		"  --seed=N             seed, same seed and duels give the same results (default 1)\n"
+		"  --frame-rate=N       server frames per second (default 60)\n"
+		"  --max-duration=S     duels longer than this are a timeout (default 30)\n"
+		"  --json               print the results as json\n"
+		"Duelist options, prefixed by --a. or --b. (defaults are those of the game):\n"
+		"  damage= rpm= clip= ammo= reload= accuracy= headshot= reaction=\n"
+		"  health= shield= regen-delay= regen-rate=\n");
+}
+
+
+/** Reads Name=Value out of Arg into Value, returns false if Arg is another option */
+template<typename ValueType>
+static bool ParseValue(const char* Arg, const char* Name, ValueType& Value)
+{
+	const size_t Length = std::strlen(Name);
+	if (std::strncmp(Arg, Name, Length) != 0 || Arg[Length] != '=')
+	{
+		return false;
+	}
+
+	Value = (ValueType)std::strtod(Arg + Length + 1, nullptr);
+	return true;
+}
+
+
+static bool ParseDuelist(const char* Arg, DuelSim::FDuelistSettings& Duelist)
+{
+	return ParseValue(Arg, "damage", Duelist.BaseDamage)
+		|| ParseValue(Arg, "rpm", Duelist.RateOfFire)
+		|| ParseValue(Arg, "clip", Duelist.ClipMaxSize)
+		|| ParseValue(Arg, "ammo", Duelist.AmmoCount)
+		|| ParseValue(Arg, "reload", Duelist.ReloadDuration)
+		|| ParseValue(Arg, "accuracy", Duelist.Accuracy)
+		|| ParseValue(Arg, "headshot", Duelist.HeadshotChance)
+		|| ParseValue(Arg, "reaction", Duelist.ReactionTime)
+		|| ParseValue(Arg, "health", Duelist.Health.DefaultHealth)
+		|| ParseValue(Arg, "shield", Duelist.Health.DefaultShield)
+		|| ParseValue(Arg, "regen-delay", Duelist.Health.TimeBeforeShieldRegen)
+		|| ParseValue(Arg, "regen-rate", Duelist.Health.ShieldRegenRate);
+}
+
+
+int main(int Argc, char** Argv)
+{
+	DuelSim::FDuelSettings Settings;
+	uint64_t NumDuels = 1000000;
+	uint32_t NumThreads = 0;
+	uint64_t Seed = 1;
+	float FrameRate = 60.f;
+	bool bJson = false;
+
+	for (int Index = 1; Index < Argc; Index++)
+	{
+		const char* Arg = Argv[Index];
+		const bool bParsed = std::strcmp(Arg, "--json") == 0 ? (bJson = true)
+			: std::strncmp(Arg, "--a.", 4) == 0 ? ParseDuelist(Arg + 4, Settings.Duelists[0])
+			: std::strncmp(Arg, "--b.", 4) == 0 ? ParseDuelist(Arg + 4, Settings.Duelists[1])
+			: ParseValue(Arg, "--duels", NumDuels)
+			|| ParseValue(Arg, "--threads", NumThreads)
+			|| ParseValue(Arg, "--seed", Seed)
+			|| ParseValue(Arg, "--frame-rate", FrameRate)
+			|| ParseValue(Arg, "--max-duration", Settings.MaxDuration);
+
+		if (!bParsed)
+		{
+			PrintUsage();
+			return std::strcmp(Arg, "--help") == 0 ? 0 : 1;
+		}
+	}
+
+	if (FrameRate <= 0.f)
+	{
+		std::fprintf(stderr, "DuelSim: --frame-rate must be positive\n");
+		return 1;
+	}
+	Settings.FrameTime = 1.f / FrameRate;
+
+	const auto StartTime = std::chrono::steady_clock::now();
+	const DuelSim::FDuelStats Stats = DuelSim::RunDuels(Settings, NumDuels, NumThreads, Seed);
+	const double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - StartTime).count();
+	const double DuelsPerSecond = Seconds > 0.0 ? Stats.NumDuels / Seconds : 0.0;
+
+	const double Timeouts = Stats.NumDuels > 0 ? (double)Stats.Outcomes[(int32_t)DuelSim::EDuelOutcome::Timeout] / Stats.NumDuels : 0.0;
+	const double Accuracy[2] =
+	{
+		Stats.Shots[0] > 0 ? (double)Stats.Hits[0] / Stats.Shots[0] : 0.0,
+		Stats.Shots[1] > 0 ? (double)Stats.Hits[1] / Stats.Shots[1] : 0.0
+	};
+
+	if (bJson)
+	{
+		std::printf("{\"duels\": %llu, \"seed\": %llu, \"win_rate_a\": %.6f, \"win_rate_b\": %.6f, \"timeouts\": %.6f, "
+			"\"mean_time_to_kill\": %.6f, \"shots_a\": %llu, \"shots_b\": %llu, \"hit_rate_a\": %.6f, \"hit_rate_b\": %.6f, "
+			"\"seconds\": %.3f, \"duels_per_second\": %.0f}\n",
+			(unsigned long long)Stats.NumDuels, (unsigned long long)Seed, Stats.GetWinRate(0), Stats.GetWinRate(1), Timeouts,
+			Stats.GetMeanTimeToKill(), (unsigned long long)Stats.Shots[0], (unsigned long long)Stats.Shots[1], Accuracy[0], Accuracy[1],
+			Seconds, DuelsPerSecond);
+	}
+	else
+	{
+		std::printf("Duels:             %llu (seed %llu)\n", (unsigned long long)Stats.NumDuels, (unsigned long long)Seed);
+		std::printf("Win rate A / B:    %.2f%% / %.2f%%\n", Stats.GetWinRate(0) * 100.0, Stats.GetWinRate(1) * 100.0);
+		std::printf("Timeouts:          %.2f%%\n", Timeouts * 100.0);
+		std::printf("Mean time to kill: %.3f s\n", Stats.GetMeanTimeToKill());
+		std::printf("Hit rate A / B:    %.2f%% / %.2f%%\n", Accuracy[0] * 100.0, Accuracy[1] * 100.0);
+		std::printf("Simulated in %.3f s, %.0f duels/s\n", Seconds, DuelsPerSecond);
+	}
+	return 0;
+}
@@ -0,0 +1,242 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "DuelSimulator.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+namespace
+{
+	constexpr float Never = std::numeric_limits<float>::max();
+
+	struct FDuelist
+	{
+		const DuelSim::FDuelistSettings* Settings;
+		GameplayRules::FHealthState Health;
+		int32_t ClipCurrentSize;
+		int32_t AmmoCount;
+		float TimeBetweenShots;
+		/** Time of the next shot, or of the end of the reload while reloading */
+		float NextActionTime;
+		bool bReloading;
+
+		void Reset(const DuelSim::FDuelistSettings& InSettings)
+		{
+			Settings = &InSettings;
+			GameplayRules::ResetHealth(Health, InSettings.Health);
+			ClipCurrentSize = InSettings.ClipMaxSize;
+			AmmoCount = InSettings.AmmoCount;
+			TimeBetweenShots = GameplayRules::GetTimeBetweenShots(InSettings.RateOfFire);
+			NextActionTime = GameplayRules::ClipIsEmpty(ClipCurrentSize) ? Never : InSettings.ReactionTime;
+			bReloading = false;
+		}
+	};
+
+
+	/** Returns true if Target died from the shot */
+	bool Shoot(FDuelist& Shooter, FDuelist& Target, int32_t ShooterIndex, DuelSim::FDuelResult& Result, DuelSim::FRandom& Random)
+	{
+		const DuelSim::FDuelistSettings& Settings = *Shooter.Settings;
+		const float ShotTime = Shooter.NextActionTime;
+
+		// Only scheduled with rounds in the clip, an empty one stops the shooter rather than firing
+		if (!GameplayRules::ConsumeRound(Shooter.ClipCurrentSize))
+		{
+			Shooter.NextActionTime = Never;
+			return false;
+		}
+		Result.Shots[ShooterIndex]++;
+
+		if (Random.NextFloat() < Settings.Accuracy)
+		{
+			Result.Hits[ShooterIndex]++;
+
+			const bool bHeadshot = Random.NextFloat() < Settings.HeadshotChance;
+			GameplayRules::ApplyDamage(Target.Health, Target.Settings->Health, GameplayRules::GetShotDamage(Settings.BaseDamage, bHeadshot));
+
+			if (GameplayRules::IsDead(Target.Health))
+			{
+				return true;
+			}
+		}
+
+		// The character reloads as soon as the clip runs dry, the reload ends ReloadDuration later
+		if (!GameplayRules::ClipIsEmpty(Shooter.ClipCurrentSize))
+		{
+			Shooter.NextActionTime = ShotTime + Shooter.TimeBetweenShots;
+		}
+		else if (Shooter.AmmoCount > 0)
+		{
+			Shooter.bReloading = true;
+			Shooter.NextActionTime = ShotTime + Settings.ReloadDuration;
+		}
+		else
+		{
+			Shooter.NextActionTime = Never;
+		}
+		return false;
+	}
+
+
+	void FinishReload(FDuelist& Duelist)
+	{
+		GameplayRules::ReloadClip(Duelist.ClipCurrentSize, Duelist.Settings->ClipMaxSize, Duelist.AmmoCount);
+		Duelist.bReloading = false;
+
+		// The trigger is still held, the next round goes out as the reload ends
+		if (GameplayRules::ClipIsEmpty(Duelist.ClipCurrentSize))
+		{
+			Duelist.NextActionTime = Never;
+		}
+	}
+}
+
+
+void DuelSim::FDuelStats::Add(const FDuelResult& Result)
+{
+	NumDuels++;
+	Outcomes[(int32_t)Result.Outcome]++;
+	if (Result.Outcome != EDuelOutcome::Timeout)
+	{
+		KillDuration += Result.Duration;
+	}
+
+	for (int32_t Duelist = 0; Duelist < 2; Duelist++)
+	{
+		Shots[Duelist] += Result.Shots[Duelist];
+		Hits[Duelist] += Result.Hits[Duelist];
+	}
+}
+
+
+void DuelSim::FDuelStats::Merge(const FDuelStats& Other)
+{
+	NumDuels += Other.NumDuels;
+	for (int32_t Outcome = 0; Outcome < (int32_t)EDuelOutcome::Num; Outcome++)
+	{
+		Outcomes[Outcome] += Other.Outcomes[Outcome];
+	}
+	KillDuration += Other.KillDuration;
+
+	for (int32_t Duelist = 0; Duelist < 2; Duelist++)
+	{
+		Shots[Duelist] += Other.Shots[Duelist];
+		Hits[Duelist] += Other.Hits[Duelist];
+	}
+}
+
+
+double DuelSim::FDuelStats::GetWinRate(int32_t Duelist) const
+{
+	const EDuelOutcome Outcome = Duelist == 0 ? EDuelOutcome::FirstWins : EDuelOutcome::SecondWins;
+	return NumDuels > 0 ? (double)Outcomes[(int32_t)Outcome] / NumDuels : 0.0;
+}
+
+
+double DuelSim::FDuelStats::GetMeanTimeToKill() const
+{
+	const uint64_t NumKills = NumDuels - Outcomes[(int32_t)EDuelOutcome::Timeout];
+	return NumKills > 0 ? KillDuration / NumKills : 0.0;
+}
+
+
+DuelSim::FDuelResult DuelSim::SimulateDuel(const FDuelSettings& Settings, FRandom& Random)
+{
+	FDuelist Duelists[2];
+	Duelists[0].Reset(Settings.Duelists[0]);
+	Duelists[1].Reset(Settings.Duelists[1]);
+
+	FDuelResult Result;
+
+	const int32_t NumFrames = (int32_t)(Settings.MaxDuration / Settings.FrameTime);
+	for (int32_t Frame = 0; Frame < NumFrames; Frame++)
+	{
+		const float FrameEnd = (Frame + 1) * Settings.FrameTime;
+
+		// Everything that falls due in the frame, earliest first, a coin decides exact ties
+		for (;;)
+		{
+			const float Times[2] = { Duelists[0].NextActionTime, Duelists[1].NextActionTime };
+			int32_t Actor = Times[0] < Times[1] ? 0 : 1;
+			if (Times[Actor] > FrameEnd)
+			{
+				break;
+			}
+			if (Times[0] == Times[1])
+			{
+				Actor = (int32_t)(Random.Next() & 1);
+			}
+
+			FDuelist& Duelist = Duelists[Actor];
+			if (Duelist.bReloading)
+			{
+				FinishReload(Duelist);
+			}
+			else if (Shoot(Duelist, Duelists[1 - Actor], Actor, Result, Random))
+			{
+				Result.Outcome = Actor == 0 ? EDuelOutcome::FirstWins : EDuelOutcome::SecondWins;
+				Result.Duration = Duelist.NextActionTime;
+				return Result;
+			}
+		}
+
+		GameplayRules::TickShield(Duelists[0].Health, Settings.Duelists[0].Health, Settings.FrameTime);
+		GameplayRules::TickShield(Duelists[1].Health, Settings.Duelists[1].Health, Settings.FrameTime);
+	}
+
+	Result.Outcome = EDuelOutcome::Timeout;
+	Result.Duration = Settings.MaxDuration;
+	return Result;
+}
+
+
+DuelSim::FDuelStats DuelSim::RunDuels(const FDuelSettings& Settings, uint64_t NumDuels, uint32_t NumThreads, uint64_t Seed)
+{
+	const uint64_t NumBlocks = (NumDuels + DuelsPerBlock - 1) / DuelsPerBlock;
+	std::vector<FDuelStats> BlockStats((size_t)NumBlocks);
+	std::atomic<uint64_t> NextBlock(0);
+
+	auto Worker = [&]()
+	{
+		for (uint64_t Block = NextBlock++; Block < NumBlocks; Block = NextBlock++)
+		{
+			// Seeds of neighbouring blocks go through the generator once so their streams do not overlap
+			FRandom Random(FRandom(Seed ^ (Block * 0xD1B54A32D192ED03ull)).Next());
+
+			const uint64_t FirstDuel = Block * DuelsPerBlock;
+			const uint64_t LastDuel = std::min(FirstDuel + DuelsPerBlock, NumDuels);
+
+			FDuelStats& Stats = BlockStats[(size_t)Block];
+			for (uint64_t Duel = FirstDuel; Duel < LastDuel; Duel++)
+			{
+				Stats.Add(SimulateDuel(Settings, Random));
+			}
+		}
+	};
+
+	if (NumThreads == 0)
+	{
+		NumThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+	NumThreads = (uint32_t)std::min<uint64_t>(NumThreads, std::max<uint64_t>(NumBlocks, 1));
+
+	std::vector<std::thread> Threads;
+	for (uint32_t Thread = 1; Thread < NumThreads; Thread++)
+	{
+		Threads.emplace_back(Worker);
+	}
+	Worker();
+	for (std::thread& Thread : Threads)
+	{
+		Thread.join();
+	}
+
+	FDuelStats Stats;
+	for (const FDuelStats& Block : BlockStats)
+	{
+		Stats.Merge(Block);
+	}
+	return Stats;
+}
@@ -0,0 +1,124 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "SGameplayRules.h"
+#include <cstdint>
+#include <limits>
+
+/**
+ * Monte Carlo duels between two players using the combat rules of the game (GameplayRules). Both start facing each other
+ * with full health and shield and fire until one dies. Shots are resolved in the order of their scheduled time, like the
+ * fire scheduler stamps them, and the shields tick once per frame like the characters do on the server.
+ */
+namespace DuelSim
+{
+	/** One side of a duel, weapon defaults are those of ASWeapon and ASCharacter */
+	struct FDuelistSettings
+	{
+		GameplayRules::FHealthSettings Health;
+
+		float BaseDamage = 20.f;
+		/** Rounds per minute */
+		float RateOfFire = 600.f;
+		int32_t ClipMaxSize = 30;
+		/** Rounds carried besides the clip */
+		int32_t AmmoCount = 300;
+		float ReloadDuration = 1.5f;
+
+		/** Chance of a shot hitting the other duelist */
+		float Accuracy = 0.5f;
+		/** Chance of a hit landing on the head (vulnerable surface) */
+		float HeadshotChance = 0.1f;
+		/** Time before the first shot */
+		float ReactionTime = 0.25f;
+	};
+
+	struct FDuelSettings
+	{
+		FDuelistSettings Duelists[2];
+
+		/** Server frame, the shields tick once per frame */
+		float FrameTime = 1.f / 60.f;
+		/** Duels still going after this long are a timeout */
+		float MaxDuration = 30.f;
+	};
+
+	enum class EDuelOutcome : uint8_t
+	{
+		FirstWins,
+		SecondWins,
+		Timeout,
+		Num
+	};
+
+	struct FDuelResult
+	{
+		EDuelOutcome Outcome = EDuelOutcome::Timeout;
+		/** Time of the killing shot, MaxDuration for a timeout */
+		float Duration = 0.f;
+		int32_t Shots[2] = { 0, 0 };
+		int32_t Hits[2] = { 0, 0 };
+	};
+
+	/** Totals over many duels */
+	struct FDuelStats
+	{
+		uint64_t NumDuels = 0;
+		uint64_t Outcomes[(int32_t)EDuelOutcome::Num] = { 0, 0, 0 };
+		/** Sum of the durations of the duels that ended with a kill */
+		double KillDuration = 0.0;
+		uint64_t Shots[2] = { 0, 0 };
+		uint64_t Hits[2] = { 0, 0 };
+
+		void Add(const FDuelResult& Result);
+		void Merge(const FDuelStats& Other);
+
+		/** Share of the duels won by Duelist (0 or 1) */
+		double GetWinRate(int32_t Duelist) const;
+
+		/** Mean time to kill of the duels that did not time out */
+		double GetMeanTimeToKill() const;
+	};
+
+	/** Small fast generator (splitmix64), one per thread */
+	class FRandom
+	{
+	public:
+
+		explicit FRandom(uint64_t Seed)
+			: State(Seed)
+		{
+		}
+
+		uint64_t Next()
+		{
+			uint64_t Value = (State += 0x9E3779B97F4A7C15ull);
+			Value = (Value ^ (Value >> 30)) * 0xBF58476D1CE4E5B9ull;
+			Value = (Value ^ (Value >> 27)) * 0x94D049BB133111EBull;
+			return Value ^ (Value >> 31);
+		}
+
+		/** Uniform in [0, 1) */
+		float NextFloat()
+		{
+			return (Next() >> 40) * (1.f / 16777216.f);
+		}
+
+	private:
+
+		uint64_t State;
+	};
+
+	/** Plays one duel */
+	FDuelResult SimulateDuel(const FDuelSettings& Settings, FRandom& Random);
+
+	/** Duels are simulated in blocks of this many, each drawing from its own generator */
+	constexpr uint64_t DuelsPerBlock = 4096;
+
+	/**
+	 * Plays NumDuels duels over NumThreads threads (0 uses every core). Block i draws from a generator seeded from Seed and i,
+	 * and blocks are merged in order, so the stats only depend on the settings, NumDuels and Seed.
+	 */
+	FDuelStats RunDuels(const FDuelSettings& Settings, uint64_t NumDuels, uint32_t NumThreads, uint64_t Seed);
+}
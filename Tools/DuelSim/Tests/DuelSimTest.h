@@ -0,0 +1,53 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+
+/** Minimal test registry, tests are plain functions registered by DUELSIM_TEST and run by TestMain.cpp */
+namespace DuelSimTest
+{
+	typedef void (*FTestFunction)();
+
+	struct FTest
+	{
+		const char* Name;
+		FTestFunction Function;
+		FTest* Next;
+	};
+
+	/** Head of the list of registered tests */
+	FTest*& GetTests();
+
+	/** Number of failed checks */
+	int& GetFailures();
+
+	struct FTestRegistrar
+	{
+		FTest Test;
+
+		FTestRegistrar(const char* Name, FTestFunction Function)
+			: Test{ Name, Function, GetTests() }
+		{
+			GetTests() = &Test;
+		}
+	};
+
+	inline void Fail(const char* File, int Line, const char* Expression)
+	{
+		std::printf("  %s:%d: check failed: %s\n", File, Line, Expression);
+		GetFailures()++;
+	}
+}
+
+#define DUELSIM_TEST(Name) \
+	static void Name(); \
+	static DuelSimTest::FTestRegistrar Name##Registrar(#Name, &Name); \
+	static void Name()
+
+#define DUELSIM_CHECK(Expression) \
+	do { if (!(Expression)) { DuelSimTest::Fail(__FILE__, __LINE__, #Expression); } } while (0)
+
+#define DUELSIM_CHECK_NEAR(Value, Expected, Tolerance) \
+	DUELSIM_CHECK(std::fabs((double)(Value) - (double)(Expected)) <= (Tolerance))
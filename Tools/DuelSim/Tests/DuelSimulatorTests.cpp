@@ -0,0 +1,120 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "DuelSimTest.h"
+#include "DuelSimulator.h"
+
+using namespace DuelSim;
+
+
+static bool operator==(const FDuelStats& A, const FDuelStats& B)
+{
+	return A.NumDuels == B.NumDuels
+		&& A.Outcomes[0] == B.Outcomes[0] && A.Outcomes[1] == B.Outcomes[1] && A.Outcomes[2] == B.Outcomes[2]
+		&& A.KillDuration == B.KillDuration
+		&& A.Shots[0] == B.Shots[0] && A.Shots[1] == B.Shots[1]
+		&& A.Hits[0] == B.Hits[0] && A.Hits[1] == B.Hits[1];
+}
+
+
+DUELSIM_TEST(SameSeedSameResults)
+{
+	FDuelSettings Settings;
+
+	const FDuelStats SingleThread = RunDuels(Settings, 20000, 1, 42);
+	DUELSIM_CHECK(SingleThread.NumDuels == 20000);
+	DUELSIM_CHECK(RunDuels(Settings, 20000, 1, 42) == SingleThread);
+	DUELSIM_CHECK(RunDuels(Settings, 20000, 4, 42) == SingleThread);
+	DUELSIM_CHECK(!(RunDuels(Settings, 20000, 4, 43) == SingleThread));
+}
+
+
+DUELSIM_TEST(MirrorDuelIsBalanced)
+{
+	FDuelSettings Settings;
+	const FDuelStats Stats = RunDuels(Settings, 100000, 0, 7);
+
+	DUELSIM_CHECK_NEAR(Stats.GetWinRate(0), Stats.GetWinRate(1), 0.02);
+	DUELSIM_CHECK(Stats.Outcomes[(int32_t)EDuelOutcome::Timeout] == 0);
+	DUELSIM_CHECK_NEAR((double)Stats.Hits[0] / Stats.Shots[0], Settings.Duelists[0].Accuracy, 0.01);
+}
+
+
+DUELSIM_TEST(PerfectAimKillsInExpectedTime)
+{
+	// 100 shield then 100 health at 20 a hit is ten hits, the first at the reaction time and one every 0.1 s after it
+	FDuelSettings Settings;
+	Settings.Duelists[0].Accuracy = 1.f;
+	Settings.Duelists[0].HeadshotChance = 0.f;
+	Settings.Duelists[1].Accuracy = 0.f;
+
+	FRandom Random(1);
+	const FDuelResult Result = SimulateDuel(Settings, Random);
+	DUELSIM_CHECK(Result.Outcome == EDuelOutcome::FirstWins);
+	DUELSIM_CHECK(Result.Shots[0] == 10);
+	DUELSIM_CHECK(Result.Hits[0] == 10);
+	DUELSIM_CHECK(Result.Hits[1] == 0);
+	DUELSIM_CHECK_NEAR(Result.Duration, Settings.Duelists[0].ReactionTime + 9 * 0.1, 1e-4);
+}
+
+
+DUELSIM_TEST(ShieldSoaksAHeadshot)
+{
+	// Headshots of 80: the second one into 20 shield is absorbed whole, so it takes two for the shield and two for the health
+	FDuelSettings Settings;
+	Settings.Duelists[0].Accuracy = 1.f;
+	Settings.Duelists[0].HeadshotChance = 1.f;
+	Settings.Duelists[1].Accuracy = 0.f;
+
+	FRandom Random(1);
+	const FDuelResult Result = SimulateDuel(Settings, Random);
+	DUELSIM_CHECK(Result.Outcome == EDuelOutcome::FirstWins);
+	DUELSIM_CHECK(Result.Hits[0] == 4);
+}
+
+
+DUELSIM_TEST(ReloadDelaysTheKill)
+{
+	FDuelSettings Settings;
+	Settings.Duelists[0].Accuracy = 1.f;
+	Settings.Duelists[0].HeadshotChance = 0.f;
+	Settings.Duelists[0].ClipMaxSize = 4;
+	Settings.Duelists[1].Accuracy = 0.f;
+
+	// Ten hits out of clips of four is two reloads
+	FRandom Random(1);
+	const FDuelResult Result = SimulateDuel(Settings, Random);
+	DUELSIM_CHECK(Result.Outcome == EDuelOutcome::FirstWins);
+	DUELSIM_CHECK_NEAR(Result.Duration, Settings.Duelists[0].ReactionTime + 7 * 0.1 + 2 * Settings.Duelists[0].ReloadDuration, 1e-4);
+}
+
+
+DUELSIM_TEST(OutOfAmmoTimesOut)
+{
+	FDuelSettings Settings;
+	Settings.MaxDuration = 10.f;
+	for (FDuelistSettings& Duelist : Settings.Duelists)
+	{
+		Duelist.Accuracy = 1.f;
+		Duelist.HeadshotChance = 0.f;
+		Duelist.ClipMaxSize = 3;
+		Duelist.AmmoCount = 3;
+	}
+
+	// Six hits of 20 only get through the shield and 20 health, nobody has a round left after that
+	FRandom Random(1);
+	const FDuelResult Result = SimulateDuel(Settings, Random);
+	DUELSIM_CHECK(Result.Outcome == EDuelOutcome::Timeout);
+	DUELSIM_CHECK(Result.Shots[0] == 6);
+	DUELSIM_CHECK(Result.Shots[1] == 6);
+	DUELSIM_CHECK(Result.Duration == Settings.MaxDuration);
+}
+
+
+DUELSIM_TEST(FasterWeaponWinsMore)
+{
+	FDuelSettings Settings;
+	Settings.Duelists[0].RateOfFire = 800.f;
+
+	const FDuelStats Stats = RunDuels(Settings, 50000, 0, 3);
+	DUELSIM_CHECK(Stats.GetWinRate(0) > Stats.GetWinRate(1) + 0.1);
+}
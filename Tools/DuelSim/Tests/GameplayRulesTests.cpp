@@ -0,0 +1,198 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "DuelSimTest.h"
+#include "SGameplayRules.h"
+
+using namespace GameplayRules;
+
+
+DUELSIM_TEST(ResetHealthUsesDefaults)
+{
+	FHealthSettings Settings;
+	Settings.DefaultHealth = 150.f;
+	Settings.DefaultShield = 50.f;
+
+	FHealthState State;
+	State.Health = 3.f;
+	State.Shield = 0.f;
+	State.TimeWithoutTakingDamage = 12.f;
+	ResetHealth(State, Settings);
+
+	DUELSIM_CHECK(State.Health == 150.f);
+	DUELSIM_CHECK(State.Shield == 50.f);
+	DUELSIM_CHECK(State.TimeWithoutTakingDamage == 0.f);
+}
+
+
+DUELSIM_TEST(ShieldAbsorbsTheWholeHit)
+{
+	FHealthSettings Settings;
+	FHealthState State;
+	State.Shield = 10.f;
+
+	DUELSIM_CHECK(ApplyDamage(State, Settings, 80.f) == EDamageResult::Shield);
+	DUELSIM_CHECK(State.Shield == 0.f);
+	DUELSIM_CHECK(State.Health == 100.f);
+
+	DUELSIM_CHECK(ApplyDamage(State, Settings, 80.f) == EDamageResult::Health);
+	DUELSIM_CHECK(State.Health == 20.f);
+	DUELSIM_CHECK(!IsDead(State));
+
+	DUELSIM_CHECK(ApplyDamage(State, Settings, 80.f) == EDamageResult::Health);
+	DUELSIM_CHECK(State.Health == 0.f);
+	DUELSIM_CHECK(IsDead(State));
+}
+
+
+DUELSIM_TEST(NoDamageChangesNothing)
+{
+	FHealthSettings Settings;
+	FHealthState State;
+	State.TimeWithoutTakingDamage = 3.f;
+
+	DUELSIM_CHECK(ApplyDamage(State, Settings, 0.f) == EDamageResult::None);
+	DUELSIM_CHECK(ApplyDamage(State, Settings, -5.f) == EDamageResult::None);
+	DUELSIM_CHECK(State.Health == 100.f);
+	DUELSIM_CHECK(State.Shield == 100.f);
+	DUELSIM_CHECK(State.TimeWithoutTakingDamage == 3.f);
+}
+
+
+DUELSIM_TEST(DamageResetsShieldRegenTimer)
+{
+	FHealthSettings Settings;
+	FHealthState State;
+	State.TimeWithoutTakingDamage = 4.f;
+
+	ApplyDamage(State, Settings, 1.f);
+	DUELSIM_CHECK(State.TimeWithoutTakingDamage == 0.f);
+}
+
+
+DUELSIM_TEST(ShieldRegeneratesAfterDelay)
+{
+	FHealthSettings Settings;
+	FHealthState State;
+	State.Shield = 0.f;
+
+	// Nothing during the first five seconds
+	for (int Frame = 0; Frame < 299; Frame++)
+	{
+		DUELSIM_CHECK(!TickShield(State, Settings, 1.f / 60.f));
+	}
+	DUELSIM_CHECK(State.Shield == 0.f);
+
+	// Then one point every quarter of a second
+	float Time = 0.f;
+	int Steps = 0;
+	while (Time < 1.f)
+	{
+		Steps += TickShield(State, Settings, 1.f / 60.f) ? 1 : 0;
+		Time += 1.f / 60.f;
+	}
+	DUELSIM_CHECK(Steps == 4 || Steps == 5);
+	DUELSIM_CHECK(State.Shield == (float)Steps);
+}
+
+
+DUELSIM_TEST(ShieldRegenStopsAtDefault)
+{
+	FHealthSettings Settings;
+	Settings.ShieldRegenRate = 30.f;
+	FHealthState State;
+	State.Shield = 90.f;
+	State.TimeWithoutTakingDamage = Settings.TimeBeforeShieldRegen;
+
+	DUELSIM_CHECK(TickShield(State, Settings, 0.f));
+	DUELSIM_CHECK(State.Shield == 100.f);
+	DUELSIM_CHECK_NEAR(State.TimeWithoutTakingDamage, Settings.TimeBeforeShieldRegen - ShieldRegenInterval, 1e-6);
+
+	State.TimeWithoutTakingDamage = Settings.TimeBeforeShieldRegen;
+	DUELSIM_CHECK(!TickShield(State, Settings, 0.f));
+}
+
+
+DUELSIM_TEST(NoShieldRegenWithoutRate)
+{
+	FHealthSettings Settings;
+	Settings.ShieldRegenRate = 0.f;
+	FHealthState State;
+	State.Shield = 0.f;
+
+	DUELSIM_CHECK(!TickShield(State, Settings, 100.f));
+	DUELSIM_CHECK(State.Shield == 0.f);
+	DUELSIM_CHECK(State.TimeWithoutTakingDamage == 0.f);
+}
+
+
+DUELSIM_TEST(HeadshotMultipliesDamage)
+{
+	DUELSIM_CHECK(GetShotDamage(20.f, false) == 20.f);
+	DUELSIM_CHECK(GetShotDamage(20.f, true) == 20.f * VulnerableDamageMultiplier);
+}
+
+
+DUELSIM_TEST(FireModeOverridesRateOfFire)
+{
+	DUELSIM_CHECK(GetRateOfFire(600.f, 0.f) == 600.f);
+	DUELSIM_CHECK(GetRateOfFire(600.f, 900.f) == 900.f);
+
+	DUELSIM_CHECK_NEAR(GetTimeBetweenShots(600.f), 0.1, 1e-6);
+	DUELSIM_CHECK_NEAR(GetTimeBetweenShots(0.f), 60.0, 1e-6);
+	DUELSIM_CHECK_NEAR(GetTimeBetweenShots(-10.f), 60.0, 1e-6);
+}
+
+
+DUELSIM_TEST(ClipState)
+{
+	DUELSIM_CHECK(ClipIsFull(30, 30));
+	DUELSIM_CHECK(!ClipIsFull(29, 30));
+	DUELSIM_CHECK(ClipIsEmpty(0));
+	DUELSIM_CHECK(!ClipIsEmpty(1));
+}
+
+
+DUELSIM_TEST(ConsumeRoundStopsAtAnEmptyClip)
+{
+	int32_t Clip = 2;
+	DUELSIM_CHECK(ConsumeRound(Clip));
+	DUELSIM_CHECK(ConsumeRound(Clip));
+	DUELSIM_CHECK(Clip == 0);
+
+	DUELSIM_CHECK(!ConsumeRound(Clip));
+	DUELSIM_CHECK(Clip == 0);
+}
+
+
+DUELSIM_TEST(RequestAmmosTakesWhatIsLeft)
+{
+	int32_t AmmoCount = 25;
+	DUELSIM_CHECK(RequestAmmos(AmmoCount, 10) == 10);
+	DUELSIM_CHECK(AmmoCount == 15);
+	DUELSIM_CHECK(RequestAmmos(AmmoCount, 30) == 15);
+	DUELSIM_CHECK(AmmoCount == 0);
+	DUELSIM_CHECK(RequestAmmos(AmmoCount, 30) == 0);
+
+	AmmoCount = 10;
+	DUELSIM_CHECK(RequestAmmos(AmmoCount, -5) == 0);
+	DUELSIM_CHECK(AmmoCount == 10);
+}
+
+
+DUELSIM_TEST(ReloadFillsTheClip)
+{
+	int32_t Clip = 4;
+	int32_t AmmoCount = 100;
+	DUELSIM_CHECK(ReloadClip(Clip, 30, AmmoCount) == 26);
+	DUELSIM_CHECK(Clip == 30);
+	DUELSIM_CHECK(AmmoCount == 74);
+
+	Clip = 0;
+	AmmoCount = 12;
+	DUELSIM_CHECK(ReloadClip(Clip, 30, AmmoCount) == 12);
+	DUELSIM_CHECK(Clip == 12);
+	DUELSIM_CHECK(AmmoCount == 0);
+
+	DUELSIM_CHECK(ReloadClip(Clip, 30, AmmoCount) == 0);
+	DUELSIM_CHECK(Clip == 12);
+}
@@ -0,0 +1,46 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "DuelSimTest.h"
+#include <cstring>
+
+
+DuelSimTest::FTest*& DuelSimTest::GetTests()
+{
+	static FTest* Tests = nullptr;
+	return Tests;
+}
+
+
+int& DuelSimTest::GetFailures()
+{
+	static int Failures = 0;
+	return Failures;
+}
+
+
+/** Runs every test, or the ones whose name contains the first argument */
+int main(int Argc, char** Argv)
+{
+	const char* Filter = Argc > 1 ? Argv[1] : nullptr;
+
+	int NumTests = 0;
+	int NumFailedTests = 0;
+	for (DuelSimTest::FTest* Test = DuelSimTest::GetTests(); Test; Test = Test->Next)
+	{
+		if (Filter && !std::strstr(Test->Name, Filter))
+		{
+			continue;
+		}
+
+		const int FailuresBefore = DuelSimTest::GetFailures();
+		Test->Function();
+		const bool bPassed = DuelSimTest::GetFailures() == FailuresBefore;
+
+		std::printf("%s %s\n", bPassed ? "[ OK ]" : "[FAIL]", Test->Name);
+		NumTests++;
+		NumFailedTests += bPassed ? 0 : 1;
+	}
+
+	std::printf("%d tests, %d failed\n", NumTests, NumFailedTests);
+	return NumFailedTests == 0 && NumTests > 0 ? 0 : 1;
+}